@@ -0,0 +1,147 @@
+#!/usr/bin/env bash
+
+# Generates large mini-pl programs and benchmarks the compiler on them.
+# Usage: ./bench.sh [size in MB]
+
+MB=${1:-8}
+BIN=${BIN:-./build/mini-pl}
+DIR=$(mktemp -d)
+trap 'rm -r "$DIR"' EXIT
+
+if [ ! -x $BIN ]; then
+  echo "[ERROR] Build the project with ./build.sh first"
+  exit 1
+fi
+
+# one ~200 byte chunk of statements, repeated until the file is MB megabytes
+gen_program() {
+  awk -v bytes=$(($1 * 1000000)) 'BEGIN {
+    print "program bench;"
+    print "begin"
+    print "var x, y, counter : integer;"
+    n = 0
+    for (i = 0; n < bytes; i++) {
+      s = "x := " i " + (y * 2) - counter % 7;\n" \
+          "// comment line " i "\n" \
+          "while x < 100 do begin x := x + 1; end;\n" \
+          "{* block\n   comment *}\n" \
+          "writeln(\"value \", x, y);\n"
+      printf "%s", s
+      n += length(s)
+    }
+    print "end;"
+    print "."
+  }' >"$2"
+}
+
+# keywords mixed with identifiers that share their prefixes and lengths
+gen_identifiers() {
+  awk -v bytes=$(($1 * 1000000)) 'BEGIN {
+    split("begin beginning end ending endx var variable while whiles do " \
+          "done if iffy then thence else elsewhere array arrays procedure " \
+          "procedures function functional program programs assert " \
+          "asserted return returned not nothing and android or order of " \
+          "often counter_1 x y z", words, " ")
+    n = 0
+    for (i = 0; n < bytes; i++) {
+      w = words[i % length(words) + 1]
+      printf "%s ", w
+      n += length(w) + 1
+      if (i % 12 == 11) {
+        printf "\n"
+        n++
+      }
+    }
+  }' >"$2"
+}
+
+# deeply indented code with long comments and string literals
+gen_indented() {
+  awk -v bytes=$(($1 * 1000000)) 'BEGIN {
+    print "program bench;"
+    print "begin"
+    n = 0
+    for (i = 0; n < bytes; i++) {
+      pad = sprintf("%" (i % 40) + 8 "s", "")
+      s = pad "// generated from node " i " of the input specification file\n" \
+          pad "x := x + 1;    {* counter update for entry number " i " *}\n" \
+          pad "writeln(\"a longer string literal produced by the generator\");\n"
+      printf "%s", s
+      n += length(s)
+    }
+    print "end;"
+    print "."
+  }' >"$2"
+}
+
+gen_program $MB "$DIR/large.mpl"
+gen_identifiers $MB "$DIR/identifiers.mpl"
+gen_indented $MB "$DIR/indented.mpl"
+echo "== scanner: $MB MB program"
+$BIN -bs "$DIR/large.mpl"
+echo "== scanner: $MB MB of keywords and identifiers"
+$BIN -bs "$DIR/identifiers.mpl"
+echo "== scanner: $MB MB of indented code with comments"
+$BIN -bs "$DIR/indented.mpl"
+echo "== parser: $MB MB program"
+$BIN -bp "$DIR/large.mpl"
+
+# about 27k statements per MB, so these run from 100k to 850k statements;
+# ns/line should stay flat if compiling is linear in the program size
+for size in 4 8 16 32; do
+  gen_program $size "$DIR/scale.mpl"
+  echo "== compiler: $size MB program"
+  $BIN -bc "$DIR/scale.mpl"
+done
+
+# loop-heavy programs with and without the loop optimizations of -O2,
+# run with node when it is installed
+ROOT=$PWD
+for bench in "loops:3000 4000" "invariant:20000 0.75 2.5" "strings:100000"; do
+  name=${bench%%:*}
+  for level in -O1 -O2; do
+    echo "== optimizer: test/$name.mpl $level"
+    (cd "$DIR" && "$ROOT/$BIN" $level --stats "$ROOT/test/$name.mpl" &&
+      if command -v node >/dev/null; then
+        echo "${bench#*:}" | node "$ROOT/test/run.js" out.wasm >/dev/null
+      fi)
+  done
+done
+
+# small functions called in a loop, with and without inlining
+for flags in --inline-limit=0 -O1; do
+  echo "== optimizer: test/calls.mpl $flags"
+  (cd "$DIR" && "$ROOT/$BIN" $flags --stats "$ROOT/test/calls.mpl" &&
+    if command -v node >/dev/null; then
+      echo 20000 | node "$ROOT/test/run.js" out.wasm >/dev/null
+    fi)
+done
+
+# array-scanning loops, with and without the bounds checks proved redundant
+for flags in --keep-bounds-checks -O1; do
+  echo "== optimizer: test/arrays.mpl $flags"
+  (cd "$DIR" && "$ROOT/$BIN" $flags --stats "$ROOT/test/arrays.mpl" &&
+    if command -v node >/dev/null; then
+      echo 100000 300 | node "$ROOT/test/run.js" out.wasm >/dev/null
+    fi)
+done
+
+# element-wise loops over arrays, scalar and in SIMD lanes; inlining is off
+# so that the loops stay in functions the engine optimizes
+for bench in vectors saxpy; do
+  for flags in "" --simd; do
+    echo "== optimizer: test/$bench.mpl --inline-limit=0 $flags"
+    (cd "$DIR" &&
+      "$ROOT/$BIN" --inline-limit=0 $flags --stats "$ROOT/test/$bench.mpl" &&
+      if command -v node >/dev/null; then
+        echo 100000 1000 | node "$ROOT/test/run.js" out.wasm >/dev/null
+      fi)
+  done
+done
+
+# arrays of many sizes allocated and freed in a loop, from the free lists
+echo "== runtime: test/alloc.mpl -O1"
+(cd "$DIR" && "$ROOT/$BIN" -O1 --stats "$ROOT/test/alloc.mpl" &&
+  if command -v node >/dev/null; then
+    echo 20000 3000 | node "$ROOT/test/run.js" out.wasm >/dev/null
+  fi)
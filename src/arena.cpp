@@ -0,0 +1,58 @@
+#include "arena.h"
+#include <cstdint>
+#include <cstdlib>
+
+namespace Memory {
+
+static const size_t BLOCK_SIZE = 1 << 16;
+
+Arena::~Arena() {
+  release();
+  if (head)
+    std::free(head);
+}
+
+void *Arena::allocate(size_t size, size_t align) {
+  uintptr_t p = ((uintptr_t)cursor + align - 1) & ~(uintptr_t)(align - 1);
+  if (!cursor || p + size > (uintptr_t)limit)
+    return grow(size, align);
+  cursor = (char *)(p + size);
+  total += size;
+  return (void *)p;
+}
+
+void *Arena::grow(size_t size, size_t align) {
+  size_t need = sizeof(Block) + size + align;
+  size_t bytes = need > BLOCK_SIZE ? need : BLOCK_SIZE;
+  Block *b = (Block *)std::malloc(bytes);
+  if (!b)
+    throw std::bad_alloc();
+  b->next = head;
+  b->size = bytes;
+  head = b;
+  count++;
+  cursor = (char *)(b + 1);
+  limit = (char *)b + bytes;
+  return allocate(size, align);
+}
+
+void Arena::release() {
+  // keep the newest block if it has the default size, the next compile in
+  // the same session usually needs it again
+  Block *keep = head && head->size == BLOCK_SIZE ? head : nullptr;
+  Block *b = keep ? head->next : head;
+  while (b) {
+    Block *next = b->next;
+    std::free(b);
+    b = next;
+  }
+  head = keep;
+  count = keep ? 1 : 0;
+  cursor = keep ? (char *)(keep + 1) : nullptr;
+  limit = keep ? (char *)keep + keep->size : nullptr;
+  if (keep)
+    keep->next = nullptr;
+  total = 0;
+}
+
+} // namespace Memory
@@ -0,0 +1,106 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Memory {
+
+// Bump allocator for data that dies all at once, like the parse tree.
+// Objects are never destroyed one by one, release() frees everything.
+class Arena {
+public:
+  Arena() = default;
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+  ~Arena();
+
+  void *allocate(size_t size, size_t align);
+
+  // value-initialized T in the arena
+  template <class T, class... Args> T *make(Args &&...args) {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "arena objects are never destroyed");
+    return new (allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+  }
+
+  // frees every object, keeps one block for the next use
+  void release();
+  // bytes handed out since the last release
+  size_t used() const { return total; }
+  // blocks currently held
+  size_t blocks() const { return count; }
+
+private:
+  struct Block {
+    Block *next;
+    size_t size;
+  };
+  Block *head = nullptr;
+  char *cursor = nullptr;
+  char *limit = nullptr;
+  size_t total = 0;
+  size_t count = 0;
+
+  void *grow(size_t size, size_t align);
+};
+
+// Singly linked list whose cells live in an arena, replaces std::list in
+// arena allocated nodes
+template <class T> class List {
+  struct Cell {
+    T value;
+    Cell *next;
+  };
+
+public:
+  class iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = T *;
+    using reference = T &;
+
+    explicit iterator(Cell *c) : c(c) {}
+    T &operator*() const { return c->value; }
+    T *operator->() const { return &c->value; }
+    iterator &operator++() {
+      c = c->next;
+      return *this;
+    }
+    bool operator!=(const iterator &o) const { return c != o.c; }
+    bool operator==(const iterator &o) const { return c == o.c; }
+
+  private:
+    Cell *c;
+  };
+
+  void push_back(Arena &arena, const T &value) {
+    Cell *c = arena.make<Cell>(Cell{value, nullptr});
+    if (tail)
+      tail->next = c;
+    else
+      head = c;
+    tail = c;
+    count++;
+  }
+  iterator begin() const { return iterator(head); }
+  iterator end() const { return iterator(nullptr); }
+  T &front() const { return head->value; }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+private:
+  Cell *head = nullptr;
+  Cell *tail = nullptr;
+  size_t count = 0;
+};
+
+} // namespace Memory
+
+#endif // ARENA_H_
@@ -0,0 +1,187 @@
+#include "batch.h"
+#include "compiler.h"
+#include "sink.h"
+#include "source.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unistd.h>
+
+namespace Batch {
+
+struct WorkQueue {
+  std::mutex lock;
+  std::deque<int> jobs;
+};
+
+// owner takes from the back, thieves from the front
+static bool take(WorkQueue &q, bool steal, int *job) {
+  std::lock_guard<std::mutex> guard(q.lock);
+  if (q.jobs.empty())
+    return false;
+  if (steal) {
+    *job = q.jobs.front();
+    q.jobs.pop_front();
+  } else {
+    *job = q.jobs.back();
+    q.jobs.pop_back();
+  }
+  return true;
+}
+
+void runParallel(int count, int threads,
+                 const std::function<void(int job, int worker)> &job) {
+  if (threads < 1)
+    threads = 1;
+  if (threads > count)
+    threads = count > 0 ? count : 1;
+  std::vector<WorkQueue> queues(threads);
+  // contiguous slices keep neighbouring inputs (often similar size) together
+  for (int i = 0; i < count; i++)
+    queues[(long)i * threads / count].jobs.push_back(i);
+
+  auto worker = [&](int w) {
+    int j;
+    for (;;) {
+      if (take(queues[w], false, &j)) {
+        job(j, w);
+        continue;
+      }
+      bool stolen = false;
+      for (int k = 1; k < threads && !stolen; k++)
+        stolen = take(queues[(w + k) % threads], true, &j);
+      if (!stolen)
+        return; // all queues were empty and jobs never get added
+      job(j, w);
+    }
+  };
+  std::vector<std::thread> pool;
+  for (int w = 1; w < threads; w++)
+    pool.emplace_back(worker, w);
+  worker(0);
+  for (auto &t : pool)
+    t.join();
+}
+
+static std::string outputPath(const std::string &outDir,
+                              const std::string &path, const char *ext) {
+  std::filesystem::path p(path);
+  return (std::filesystem::path(outDir) / p.stem()).string() + ext;
+}
+
+Summary compileFiles(const std::vector<std::string> &paths,
+                     const std::string &outDir, int threads,
+                     const Compiler::Options &options) {
+  Summary summary;
+  summary.files = paths.size();
+  if (threads < 1)
+    threads = 1;
+  std::error_code ec;
+  std::filesystem::create_directories(outDir, ec);
+
+  // inputs with one stem would write one file from two workers, so none
+  // of them is compiled
+  const char *ext = options.emit == Compiler::Emit::WAT ? ".wat" : ".wasm";
+  std::vector<std::string> targets;
+  std::unordered_map<std::string, size_t> first; // input by target
+  std::vector<bool> collides(paths.size());
+  for (size_t i = 0; i < paths.size(); i++) {
+    targets.push_back(outputPath(outDir, paths[i], ext));
+    auto [at, fresh] = first.emplace(targets[i], i);
+    if (!fresh) {
+      std::cerr << paths[i] << ": output " << targets[i]
+                << " is also that of " << paths[at->second] << std::endl;
+      collides[i] = collides[at->second] = true;
+    }
+  }
+
+  auto begin = std::chrono::steady_clock::now();
+  std::vector<std::unique_ptr<Compiler::Session>> sessions(threads);
+  std::vector<size_t> bytes(threads);
+  std::vector<int> failed(threads);
+  std::mutex errLock;
+  runParallel(paths.size(), threads, [&](int job, int w) {
+    const std::string &path = paths[job];
+    if (collides[job]) {
+      failed[w]++;
+      return;
+    }
+    if (!sessions[w])
+      sessions[w] = std::make_unique<Compiler::Session>(options);
+    Compiler::Session &session = *sessions[w];
+    Source::Buffer source;
+    try {
+      source.open(path);
+    } catch (int e) {
+      std::lock_guard<std::mutex> guard(errLock);
+      std::cerr << path << ": failed to read file: " << std::strerror(e)
+                << std::endl;
+      failed[w]++;
+      return;
+    }
+    bytes[w] += source.size();
+    // modules stream into their files, removed again if compiling fails
+    const std::string &target = targets[job];
+    int fd = open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      std::lock_guard<std::mutex> guard(errLock);
+      std::cerr << target << ": failed to open: " << std::strerror(errno)
+                << std::endl;
+      failed[w]++;
+      return;
+    }
+    Sink::Buffer file(fd);
+    bool ok = session.compile(source, file);
+    bool written = file.flush();
+    close(fd);
+    if (!session.diagnostics().empty() || !written) {
+      std::lock_guard<std::mutex> guard(errLock);
+      std::cerr << path << ":\n" << session.diagnostics();
+      if (!written)
+        std::cerr << target << ": failed to write" << std::endl;
+    }
+    if (!ok || !written) {
+      unlink(target.c_str());
+      failed[w]++;
+    }
+  });
+  std::chrono::duration<double> secs =
+      std::chrono::steady_clock::now() - begin;
+
+  summary.seconds = secs.count();
+  for (int w = 0; w < threads; w++) {
+    summary.bytes += bytes[w];
+    summary.failed += failed[w];
+  }
+  return summary;
+}
+
+std::vector<std::string> readManifest(const std::string &path) {
+  std::ifstream in(path);
+  if (!in)
+    throw(errno);
+  std::vector<std::string> paths;
+  std::string line;
+  while (std::getline(in, line)) {
+    size_t comment = line.find('#');
+    if (comment != std::string::npos)
+      line.erase(comment);
+    size_t first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos)
+      continue;
+    size_t last = line.find_last_not_of(" \t\r");
+    paths.push_back(line.substr(first, last - first + 1));
+  }
+  return paths;
+}
+
+} // namespace Batch
@@ -0,0 +1,37 @@
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include "compiler.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Batch {
+
+// Runs job(0) .. job(count - 1) on the given number of threads. Every worker
+// owns a deque of job indices and steals from the others once it runs dry.
+// worker is in [0, threads) and lets jobs keep per-thread state.
+void runParallel(int count, int threads,
+                 const std::function<void(int job, int worker)> &job);
+
+struct Summary {
+  int files = 0;
+  int failed = 0;
+  size_t bytes = 0;
+  double seconds = 0;
+};
+
+// Compiles every path to <outDir>/<name>.wasm (or .wat) with one
+// Compiler::Session per thread. Diagnostics go to stderr prefixed with the
+// file name. Inputs whose outputs would have one name, such as a/x.mpl
+// and b/x.mpl, fail without being compiled.
+Summary compileFiles(const std::vector<std::string> &paths,
+                     const std::string &outDir, int threads,
+                     const Compiler::Options &options);
+
+// reads a manifest with one source path per line, '#' starts a comment
+std::vector<std::string> readManifest(const std::string &path);
+
+} // namespace Batch
+
+#endif // BATCH_H_
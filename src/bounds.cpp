@@ -0,0 +1,698 @@
+#include "optimizer.h"
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace Optimizer {
+
+using IR::Op;
+using IR::Ref;
+using IR::Type;
+
+const uint32_t NO_ARRAY = ~0u;
+
+// The values an integer may hold: an interval, and maybe that it is below,
+// or at most, the size of an array. The size is the one the array had in
+// some epoch; giving the array another size starts a new epoch.
+struct Range {
+  int64_t lo = INT32_MIN, hi = INT32_MAX;
+  uint32_t array = NO_ARRAY;
+  uint32_t epoch = 0;
+  bool strict = false; // below the size rather than at most
+
+  static Range constant(int64_t v) {
+    Range r;
+    r.lo = r.hi = v;
+    return r;
+  }
+  bool sizeBound() const { return array != NO_ARRAY; }
+  bool contains(const Range &o) const {
+    return lo <= o.lo && o.hi <= hi &&
+           (!sizeBound() || (o.array == array && o.epoch == epoch &&
+                             (o.strict || !strict)));
+  }
+};
+
+// integers wrap, so an interval past their range says nothing
+static Range wrapped(int64_t lo, int64_t hi) {
+  Range r;
+  if (lo >= INT32_MIN && hi <= INT32_MAX) {
+    r.lo = lo;
+    r.hi = hi;
+  }
+  return r;
+}
+
+static Range join(const Range &x, const Range &y) {
+  Range r;
+  r.lo = std::min(x.lo, y.lo);
+  r.hi = std::max(x.hi, y.hi);
+  if (x.sizeBound() && x.array == y.array && x.epoch == y.epoch) {
+    r.array = x.array;
+    r.epoch = x.epoch;
+    r.strict = x.strict && y.strict;
+  }
+  return r;
+}
+
+// Abstract interpretation of each body over ranges of its integer
+// variables, in the style of the folder: facts flow through straight-line
+// code, are refined by the conditions of ifs, whiles and asserts, and
+// merged where branches meet. A loop starts from a guess of the facts at
+// its head, made from how its body steps each variable, that is checked
+// against the facts at the end of the body and widened until it holds.
+// Accesses are proved in range only if every walk over them proves it.
+class BoundsChecker {
+public:
+  IR::Program &ir;
+
+  explicit BoundsChecker(IR::Program &ir)
+      : ir(ir), facts(ir.vars.size()), epoch(ir.vars.size()),
+        length(ir.vars.size(), -1) {}
+
+  size_t run() {
+    budget = 16 * ir.size() + 1024;
+    for (const IR::Function &f : ir.functions)
+      body(f.body);
+    body(ir.main);
+    if (!budget)
+      return 0; // gave up, some walk may not have been checked
+    size_t removed = 0;
+    for (auto &[n, ok] : proved)
+      if (ok) {
+        ir.inBounds.insert(n);
+        removed++;
+      }
+    return removed;
+  }
+
+private:
+  std::vector<Range> facts;     // by variable
+  std::vector<uint32_t> epoch;  // by array variable
+  std::vector<int64_t> length;  // by array, its size in the current epoch
+  std::vector<std::pair<uint32_t, Range>> log; // variable, previous facts
+  std::vector<uint32_t> resized; // arrays, in the order they got a size
+  uint32_t epochs = 0;
+  bool alive = true; // false after a return
+  size_t budget;     // nodes left to walk before giving up
+  std::unordered_map<Ref, bool> proved; // by access
+  std::vector<std::pair<Ref, int>> trail; // access, -1 or what it had
+
+  enum Step { UP, DOWN, ANY };
+
+  bool tracked(uint32_t var) const {
+    return ir.vars[var].type == Type::INTEGER;
+  }
+
+  void set(uint32_t var, const Range &r) {
+    log.push_back({var, facts[var]});
+    facts[var] = r;
+  }
+  void undo(size_t to) {
+    for (; log.size() > to; log.pop_back())
+      facts[log.back().first] = log.back().second;
+  }
+  // the variables set since to, with their facts now
+  std::unordered_map<uint32_t, Range> changes(size_t to) const {
+    std::unordered_map<uint32_t, Range> out;
+    for (size_t i = to; i < log.size(); i++)
+      out.emplace(log[i].first, facts[log[i].first]);
+    return out;
+  }
+
+  // the facts of var that still hold
+  Range get(uint32_t var) const {
+    Range r = facts[var];
+    if (r.sizeBound() && epoch[r.array] != r.epoch) {
+      r.array = NO_ARRAY;
+      r.strict = false;
+    }
+    return r;
+  }
+
+  // array gets a new size, known if it is a constant
+  void resize(uint32_t array, Ref size = IR::NONE) {
+    epoch[array] = ++epochs;
+    length[array] = size != IR::NONE && ir.op[size] == Op::INT
+                        ? (int32_t)ir.a[size]
+                        : -1;
+    resized.push_back(array);
+  }
+
+  // arrays resized since from, on some path only, get a size not known
+  void forget(size_t from) {
+    std::vector<uint32_t> arrays(resized.begin() + from, resized.end());
+    for (uint32_t array : arrays)
+      resize(array);
+  }
+
+  void body(Ref n) {
+    std::fill(facts.begin(), facts.end(), Range());
+    std::fill(length.begin(), length.end(), -1);
+    alive = true;
+    statement(n);
+    log.clear();
+    resized.clear();
+    trail.clear();
+  }
+
+  void access(Ref n, uint32_t array, const Range &index) {
+    bool ok = index.lo >= 0 &&
+              ((index.sizeBound() && index.strict && index.array == array &&
+                index.epoch == epoch[array]) ||
+               (length[array] >= 0 && index.hi < length[array]));
+    auto [it, added] = proved.try_emplace(n, ok);
+    trail.push_back({n, added ? -1 : it->second});
+    if (!added)
+      it->second = it->second && ok;
+  }
+
+  // forgets what the accesses walked since to proved
+  void retract(size_t to) {
+    for (; trail.size() > to; trail.pop_back()) {
+      auto [n, was] = trail.back();
+      if (was < 0)
+        proved.erase(n);
+      else
+        proved[n] = was;
+    }
+  }
+
+  // Evaluates n for its effects on the facts and the accesses in it.
+  Range expr(Ref n) {
+    if (budget)
+      budget--;
+    switch (ir.op[n]) {
+    case Op::INT:
+      return Range::constant((int32_t)ir.a[n]);
+    case Op::REAL:
+    case Op::STR:
+    case Op::BOOL:
+      return Range();
+    case Op::VAR:
+      if (ir.b[n] != IR::NONE) {
+        access(n, ir.a[n], expr(ir.b[n]));
+        return Range();
+      }
+      return tracked(ir.a[n]) ? get(ir.a[n]) : Range();
+    case Op::TEE: {
+      Range r = expr(ir.b[n]);
+      if (tracked(ir.a[n]))
+        set(ir.a[n], r);
+      return r;
+    }
+    case Op::SIZE:
+      expr(ir.a[n]);
+      return size(ir.a[n]);
+    case Op::CALL:
+      call(n);
+      return Range();
+    default:
+      break;
+    }
+    Range x = expr(ir.a[n]);
+    Range y = IR::isBinary(ir.op[n]) ? expr(ir.b[n]) : Range();
+    if (ir.type[n] != Type::INTEGER)
+      return Range();
+    return arithmetic(ir.op[n], x, y);
+  }
+
+  Range size(Ref array) const {
+    Range r;
+    r.lo = 0;
+    if (ir.op[array] != Op::VAR)
+      return r;
+    uint32_t a = ir.a[array];
+    if (length[a] >= 0)
+      r.lo = r.hi = length[a];
+    r.array = a;
+    r.epoch = epoch[a];
+    return r;
+  }
+
+  static Range arithmetic(Op o, const Range &x, const Range &y) {
+    Range r;
+    switch (o) {
+    case Op::NEG:
+      return wrapped(-x.hi, -x.lo);
+    case Op::ADD:
+      r = wrapped(x.lo + y.lo, x.hi + y.hi);
+      // adding at most 0 without wrapping keeps below a size
+      if (x.lo + y.lo < INT32_MIN)
+        return r;
+      if (y.hi <= 0)
+        bound(r, x, y.hi < 0);
+      else if (x.hi <= 0)
+        bound(r, y, x.hi < 0);
+      return r;
+    case Op::SUB:
+      r = wrapped(x.lo - y.hi, x.hi - y.lo);
+      if (y.lo >= 0 && x.lo - y.hi >= INT32_MIN)
+        bound(r, x, y.lo > 0);
+      return r;
+    case Op::MUL: {
+      int64_t p[] = {x.lo * y.lo, x.lo * y.hi, x.hi * y.lo, x.hi * y.hi};
+      return wrapped(*std::min_element(p, p + 4), *std::max_element(p, p + 4));
+    }
+    case Op::DIV:
+      // truncating by a positive divisor keeps the order
+      if (y.lo > 0 && x.lo >= 0) {
+        r = wrapped(x.lo / y.hi, x.hi / y.lo);
+        bound(r, x, false);
+      } else if (y.lo > 0) {
+        r = wrapped(std::min(x.lo / y.lo, x.lo / y.hi),
+                    std::max(x.hi / y.lo, x.hi / y.hi));
+      }
+      return r;
+    case Op::MOD:
+      // takes the sign of the dividend and is smaller than the divisor
+      if (y.lo > 0) {
+        int64_t m = y.hi - 1;
+        r = x.lo >= 0 ? wrapped(0, std::min(x.hi, m))
+                      : wrapped(std::max(x.lo, -m), x.hi >= 0 ? m : 0);
+        if (x.lo >= 0)
+          bound(r, x, false);
+      }
+      return r;
+    default:
+      return r;
+    }
+  }
+
+  // r is at most x, so it keeps the size bound of x, made strict if r is
+  // smaller
+  static void bound(Range &r, const Range &x, bool smaller) {
+    if (!x.sizeBound())
+      return;
+    r.array = x.array;
+    r.epoch = x.epoch;
+    r.strict = x.strict || smaller;
+  }
+
+  void call(Ref n) {
+    for (size_t i = 0; i < ir.c[n]; i++)
+      expr(ir.begin(n)[i]);
+    for (size_t i = 0; i < ir.c[n]; i++) {
+      if (!ir.byReference(n, i))
+        continue;
+      uint32_t var = ir.a[ir.begin(n)[i]];
+      if (IR::isArray(ir.vars[var].type))
+        resize(var);
+      else if (tracked(var))
+        set(var, Range());
+    }
+  }
+
+  // The range of n, evaluated again after n ran, without effects. A TEE
+  // yields what its variable now holds.
+  Range peek(Ref n) const {
+    switch (ir.op[n]) {
+    case Op::INT:
+      return Range::constant((int32_t)ir.a[n]);
+    case Op::VAR:
+    case Op::TEE:
+      return ir.b[n] == IR::NONE || ir.op[n] == Op::TEE
+                 ? (tracked(ir.a[n]) ? get(ir.a[n]) : Range())
+                 : Range();
+    case Op::SIZE:
+      return size(ir.a[n]);
+    case Op::NEG:
+      return arithmetic(Op::NEG, peek(ir.a[n]), Range());
+    case Op::ADD:
+    case Op::SUB:
+    case Op::MUL:
+    case Op::DIV:
+    case Op::MOD:
+      if (ir.type[n] != Type::INTEGER)
+        return Range();
+      return arithmetic(ir.op[n], peek(ir.a[n]), peek(ir.b[n]));
+    default:
+      return Range();
+    }
+  }
+
+  // the variable whose value n is, NONE if n is not one
+  uint32_t variable(Ref n) const {
+    Op o = ir.op[n];
+    if ((o == Op::VAR && ir.b[n] == IR::NONE) || o == Op::TEE)
+      return tracked(ir.a[n]) ? ir.a[n] : IR::NONE;
+    return IR::NONE;
+  }
+
+  // lists the variables condition n reads and those its TEEs set, false
+  // if it calls a function
+  bool pure(Ref n, std::vector<uint32_t> &reads,
+            std::vector<uint32_t> &sets) const {
+    switch (ir.op[n]) {
+    case Op::CALL:
+      return false;
+    case Op::INT:
+    case Op::REAL:
+    case Op::STR:
+    case Op::BOOL:
+    case Op::SIZE:
+      return true;
+    case Op::VAR:
+      reads.push_back(ir.a[n]);
+      return ir.b[n] == IR::NONE || pure(ir.b[n], reads, sets);
+    case Op::TEE:
+      sets.push_back(ir.a[n]);
+      return pure(ir.b[n], reads, sets);
+    default:
+      return pure(ir.a[n], reads, sets) &&
+             (!IR::isBinary(ir.op[n]) || pure(ir.b[n], reads, sets));
+    }
+  }
+
+  // Narrows the facts to those holding where condition n, which has run,
+  // came out as truth. Its operands are evaluated again over the facts
+  // after it, so a call in n, or a TEE of a variable it also reads, may
+  // have changed what they were.
+  void refine(Ref n, bool truth) {
+    std::vector<uint32_t> reads, sets;
+    if (!pure(n, reads, sets))
+      return;
+    for (uint32_t var : sets)
+      if (std::count(reads.begin(), reads.end(), var) ||
+          std::count(sets.begin(), sets.end(), var) > 1)
+        return;
+    narrow(n, truth);
+  }
+
+  void narrow(Ref n, bool truth) {
+    Op o = ir.op[n];
+    if (o == Op::NOT)
+      return narrow(ir.a[n], !truth);
+    if ((o == Op::AND && truth) || (o == Op::OR && !truth)) {
+      narrow(ir.a[n], truth);
+      narrow(ir.b[n], truth);
+      return;
+    }
+    if (!IR::isComparison(o) || ir.type[ir.a[n]] != Type::INTEGER)
+      return;
+    Ref x = ir.a[n], y = ir.b[n];
+    if (!truth)
+      o = negate(o);
+    // as x < y or x <= y
+    if (o == Op::GT || o == Op::GTE) {
+      std::swap(x, y);
+      o = o == Op::GT ? Op::LT : Op::LTE;
+    }
+    switch (o) {
+    case Op::LT:
+    case Op::LTE:
+      less(x, y, o == Op::LT);
+      break;
+    case Op::EQ:
+      less(x, y, false);
+      less(y, x, false);
+      break;
+    default:
+      break;
+    }
+  }
+
+  static Op negate(Op o) {
+    switch (o) {
+    case Op::EQ:
+      return Op::NEQ;
+    case Op::NEQ:
+      return Op::EQ;
+    case Op::LT:
+      return Op::GTE;
+    case Op::LTE:
+      return Op::GT;
+    case Op::GT:
+      return Op::LTE;
+    default:
+      return Op::LT;
+    }
+  }
+
+  // x < y, or x <= y if not strict
+  void less(Ref x, Ref y, bool strict) {
+    Range rx = peek(x), ry = peek(y);
+    int64_t gap = strict ? 1 : 0;
+    uint32_t vx = variable(x), vy = variable(y);
+    if (vx != IR::NONE) {
+      Range r = rx;
+      r.hi = std::min(r.hi, ry.hi - gap);
+      if (ry.sizeBound() && (!r.sizeBound() || strict || ry.strict)) {
+        r.array = ry.array;
+        r.epoch = ry.epoch;
+        r.strict = strict || ry.strict;
+      }
+      set(vx, r);
+    }
+    if (vy != IR::NONE) {
+      Range r = ry;
+      r.lo = std::max(r.lo, rx.lo + gap);
+      set(vy, r);
+    }
+  }
+
+  // how the code of n changes each variable, arrays changing size as ANY
+  void steps(Ref n, std::unordered_map<uint32_t, Step> &out) {
+    if (n == IR::NONE)
+      return;
+    if (budget)
+      budget--;
+    auto step = [&](uint32_t var, Step s) {
+      auto [it, added] = out.try_emplace(var, s);
+      if (!added && it->second != s)
+        it->second = ANY;
+    };
+    switch (ir.op[n]) {
+    case Op::INT:
+    case Op::REAL:
+    case Op::STR:
+    case Op::BOOL:
+      return;
+    case Op::CALL:
+      for (size_t i = 0; i < ir.c[n]; i++)
+        if (ir.byReference(n, i))
+          step(ir.a[ir.begin(n)[i]], ANY);
+      [[fallthrough]];
+    case Op::WRITE:
+    case Op::BLOCK:
+      for (const Ref *r = ir.begin(n); r != ir.end(n); r++)
+        steps(*r, out);
+      return;
+    case Op::READ:
+      for (const Ref *r = ir.begin(n); r != ir.end(n); r++) {
+        if (ir.b[*r] == IR::NONE)
+          step(ir.a[*r], ANY);
+        steps(ir.b[*r], out);
+      }
+      return;
+    case Op::VAR:
+      steps(ir.b[n], out);
+      return;
+    case Op::TEE:
+    case Op::DECLARE:
+      step(ir.a[n], ANY);
+      steps(ir.b[n], out);
+      return;
+    case Op::ASSIGN:
+      if (ir.c[n] == IR::NONE)
+        step(ir.a[n], stepOf(ir.a[n], ir.b[n]));
+      steps(ir.b[n], out);
+      steps(ir.c[n], out);
+      return;
+    default:
+      steps(ir.a[n], out);
+      if (IR::isBinary(ir.op[n]) || ir.op[n] == Op::IF ||
+          ir.op[n] == Op::WHILE)
+        steps(ir.b[n], out);
+      if (ir.op[n] == Op::IF)
+        steps(ir.c[n], out);
+    }
+  }
+
+  // UP for var := var + k with k > 0, DOWN for var := var - k
+  Step stepOf(uint32_t var, Ref value) const {
+    Op o = ir.op[value];
+    if (!tracked(var) || (o != Op::ADD && o != Op::SUB))
+      return ANY;
+    Ref x = ir.a[value], y = ir.b[value];
+    if (o == Op::ADD && ir.op[x] == Op::INT)
+      std::swap(x, y);
+    if (ir.op[x] != Op::VAR || ir.b[x] != IR::NONE || ir.a[x] != var ||
+        ir.op[y] != Op::INT)
+      return ANY;
+    int32_t k = (int32_t)ir.a[y];
+    if (k == 0 || k == INT32_MIN)
+      return ANY;
+    return (k > 0) == (o == Op::ADD) ? UP : DOWN;
+  }
+
+  // Sets the facts at the head of a loop, entered with the current ones,
+  // for a body that changes the variables as given
+  void guess(const std::unordered_map<uint32_t, Step> &changed) {
+    for (auto &[var, s] : changed) {
+      if (!tracked(var))
+        continue;
+      Range r = get(var), g;
+      if (s == UP) {
+        g.lo = r.lo;
+      } else if (s == DOWN) {
+        g.hi = r.hi;
+        g.array = r.array;
+        g.epoch = r.epoch;
+        g.strict = r.strict;
+      }
+      set(var, g);
+    }
+  }
+
+  void loop(Ref n) {
+    std::unordered_map<uint32_t, Step> changed;
+    steps(ir.a[n], changed);
+    steps(ir.b[n], changed);
+    // arrays the body resizes have a size not known at the head
+    std::vector<uint32_t> arrays;
+    for (auto &[var, s] : changed)
+      if (IR::isArray(ir.vars[var].type))
+        arrays.push_back(var);
+    for (uint32_t array : arrays)
+      resize(array);
+    size_t entry = log.size();
+    guess(changed);
+    // a walk that ends with facts the head does not admit is done again
+    // with those variables unknown, and the third time with all of them
+    for (int walk = 0;; walk++) {
+      if (walk)
+        for (uint32_t array : arrays)
+          resize(array);
+      auto head = changes(entry);
+      size_t start = log.size(), walked = trail.size();
+      expr(ir.a[n]);
+      refine(ir.a[n], true);
+      statement(ir.b[n]);
+      bool back = alive;
+      alive = true;
+      std::vector<uint32_t> widened;
+      if (back && budget)
+        for (auto &[var, h] : head)
+          if (!h.contains(get(var)))
+            widened.push_back(var);
+      undo(start);
+      if (widened.empty())
+        break;
+      retract(walked);
+      if (walk >= 1)
+        for (auto &[var, h] : head)
+          widened.push_back(var);
+      for (uint32_t var : widened)
+        set(var, Range());
+    }
+    for (uint32_t array : arrays)
+      resize(array);
+    expr(ir.a[n]);
+    refine(ir.a[n], false);
+  }
+
+  void branches(Ref n) {
+    expr(ir.a[n]);
+    size_t start = log.size(), arrays = resized.size();
+    refine(ir.a[n], true);
+    statement(ir.b[n]);
+    bool thenAlive = alive;
+    auto then = changes(start);
+    undo(start);
+    alive = true;
+    refine(ir.a[n], false);
+    if (ir.c[n] != IR::NONE)
+      statement(ir.c[n]);
+    bool elseAlive = alive;
+    auto otherwise = changes(start);
+    undo(start);
+    forget(arrays);
+    alive = thenAlive || elseAlive;
+    if (!thenAlive || !elseAlive) {
+      for (auto &[var, r] : thenAlive ? then : otherwise)
+        set(var, r);
+      return;
+    }
+    // variables changed on one side keep what they held before on the
+    // other
+    for (auto &[var, r] : then) {
+      auto it = otherwise.find(var);
+      set(var, join(r, it == otherwise.end() ? get(var) : it->second));
+    }
+    for (auto &[var, r] : otherwise)
+      if (!then.count(var))
+        set(var, join(r, get(var)));
+  }
+
+  void statement(Ref n) {
+    if (budget)
+      budget--;
+    switch (ir.op[n]) {
+    case Op::BLOCK:
+      for (const Ref *s = ir.begin(n); s != ir.end(n); s++)
+        statement(*s);
+      break;
+    case Op::DECLARE: {
+      uint32_t var = ir.a[n];
+      if (ir.b[n] != IR::NONE)
+        expr(ir.b[n]);
+      if (IR::isArray(ir.vars[var].type))
+        resize(var, ir.b[n]);
+      else if (tracked(var))
+        set(var, Range::constant(0));
+      break;
+    }
+    case Op::ASSIGN: {
+      uint32_t var = ir.a[n];
+      Range value = expr(ir.b[n]);
+      if (ir.c[n] != IR::NONE)
+        access(n, var, expr(ir.c[n]));
+      else if (IR::isArray(ir.vars[var].type))
+        resize(var);
+      else if (tracked(var))
+        set(var, value);
+      break;
+    }
+    case Op::READ:
+      for (const Ref *r = ir.begin(n); r != ir.end(n); r++)
+        if (ir.b[*r] != IR::NONE)
+          access(*r, ir.a[*r], expr(ir.b[*r]));
+        else if (tracked(ir.a[*r]))
+          set(ir.a[*r], Range());
+      break;
+    case Op::CALL:
+      call(n);
+      break;
+    case Op::WRITE:
+      for (const Ref *a = ir.begin(n); a != ir.end(n); a++)
+        expr(*a);
+      break;
+    case Op::ASSERT:
+      expr(ir.a[n]);
+      refine(ir.a[n], true);
+      break;
+    case Op::RETURN:
+      if (ir.a[n] != IR::NONE)
+        expr(ir.a[n]);
+      alive = false;
+      break;
+    case Op::IF:
+      branches(n);
+      break;
+    case Op::WHILE:
+      loop(n);
+      break;
+    default:
+      break;
+    }
+  }
+};
+
+size_t removeBoundsChecks(IR::Program &ir) {
+  BoundsChecker b(ir);
+  return b.run();
+}
+
+} // namespace Optimizer
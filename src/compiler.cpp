@@ -1,504 +1,1645 @@
 #include "compiler.h"
+#include "locals.h"
+#include "optimizer.h"
 #include "parser.h"
 #include "parser_utils.h"
+#include "peephole.h"
 #include "scanner.h"
-#include <cerrno>
-#include <fstream>
+#include "ssa.h"
+#include "vectorizer.h"
+#include "wasm.h"
+#include "wasmlib.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
 #include <string>
+#include <sys/resource.h>
+#include <unordered_map>
 
 namespace Compiler {
-Program *ir;
-std::string out;
 
-std::string toTypeStr(Parser::Type *t) {
-  return t->type + (t->isArray ? "_arr" : "");
+using IR::Op;
+using IR::Ref;
+using IR::Type;
+
+static Op binaryOp(std::string_view op) {
+  if (op == "+")
+    return Op::ADD;
+  if (op == "-")
+    return Op::SUB;
+  if (op == "*")
+    return Op::MUL;
+  if (op == "/")
+    return Op::DIV;
+  if (op == "%")
+    return Op::MOD;
+  if (op == "and")
+    return Op::AND;
+  if (op == "or")
+    return Op::OR;
+  if (op == "=")
+    return Op::EQ;
+  if (op == "<>")
+    return Op::NEQ;
+  if (op == "<")
+    return Op::LT;
+  if (op == "<=")
+    return Op::LTE;
+  if (op == ">")
+    return Op::GT;
+  return Op::GTE;
+}
+
+// source text of an operator, for messages
+static const char *opText(Op o) {
+  switch (o) {
+  case Op::NEG:
+    return "-";
+  case Op::NOT:
+    return "not";
+  case Op::ADD:
+    return "+";
+  case Op::SUB:
+    return "-";
+  case Op::MUL:
+    return "*";
+  case Op::DIV:
+    return "/";
+  case Op::MOD:
+    return "%";
+  case Op::AND:
+    return "and";
+  case Op::OR:
+    return "or";
+  case Op::EQ:
+    return "=";
+  case Op::NEQ:
+    return "<>";
+  case Op::LT:
+    return "<";
+  case Op::LTE:
+    return "<=";
+  case Op::GT:
+    return ">";
+  case Op::GTE:
+    return ">=";
+  default:
+    return IR::opName(o);
+  }
+}
+
+// contents of a string literal token, quotes removed and escapes decoded
+static std::string unescape(std::string_view lit) {
+  std::string s;
+  for (size_t i = 1; i + 1 < lit.size(); i++) {
+    char c = lit[i];
+    if (c == '\\' && i + 2 < lit.size()) {
+      c = lit[++i];
+      if (c == 'n')
+        c = '\n';
+      else if (c == 't')
+        c = '\t';
+      else if (c == 'r')
+        c = '\r';
+    }
+    s += c;
+  }
+  return s;
 }
-// visitor used for creating IR from parse tree
+
+// Lowers the parse tree into IR and resolves every name to a variable.
 class ParseTreeWalker : public Parser::TreeWalker {
 public:
-  IRNode *previous;
-  IRNode *next;
-  void visitProgram(const Parser::Program *i) override {
-    ir->name = i->id;
-    for (Parser::Function *f : i->functions) {
-      f->accept(this);
-      ir->functions.push_back((Function *)next);
-    }
-    i->block->accept(this);
-    ir->scope = (Scope *)next;
+  IR::Program &ir;
+  const Symbols::Interner &names;
+  Ref next = IR::NONE;
+  Symbols::Scopes &scopes; // variable by Symbol
+  std::vector<Ref> *statements = nullptr; // of the block being lowered
+
+  ParseTreeWalker(IR::Program &ir, const Symbols::Interner &names,
+                  Symbols::Scopes &scopes)
+      : ir(ir), names(names), scopes(scopes) {
+    scopes.reset(names.size());
   }
-  void visitFunction(const Parser::Function *i) override {
-    Function *f = new Function();
-    f->type = toTypeStr(i->returnType);
-    f->name = i->id;
-    for (Parser::Statement *s : i->block->statements) {
-      s->accept(this);
-      f->scope->statements.push_back((Statement *)next);
+
+  std::string name(Symbols::Symbol s) const {
+    return std::string(names.name(s));
+  }
+
+  Ref lower(Parser::TreeNode *n) {
+    next = IR::NONE;
+    n->accept(this);
+    return next;
+  }
+
+  // lowers statements [first, last) into a BLOCK with a scope of its own
+  template <class It> Ref block(It first, It last) {
+    std::vector<Ref> list;
+    std::vector<Ref> *enclosing = statements;
+    statements = &list;
+    scopes.enter();
+    for (; first != last; ++first) {
+      size_t k = list.size();
+      Ref s = lower(*first);
+      if (s != IR::NONE)
+        list.push_back(s);
+      // a declaration of several variables lowers to several statements
+      for (; k < list.size(); k++)
+        ir.line[list[k]] = (*first)->line;
     }
-    next = f;
+    scopes.leave();
+    statements = enclosing;
+    Ref b = ir.add(Op::BLOCK, Type::VOID);
+    ir.setList(b, list);
+    return b;
   }
-  void visitParameter(const Parser::Parameter *i) override {
-    std::cout << "PARAMETER";
+
+  Ref branch(Parser::Statement *s) { return block(&s, &s + 1); }
+
+  uint32_t declare(Symbols::Symbol id, Type t, Ref decl) {
+    if (scopes.isLocal(id))
+      ir.error(decl, name(id) + " is already declared in this block");
+    uint32_t v = ir.addVariable(id, t, decl);
+    scopes.bind(id, v);
+    return v;
   }
-  void visitType(const Parser::Type *i) override { std::cout << "TYPE"; }
-  void visitBlock(const Parser::Block *i) override {
-    Scope *scope = new Scope();
-    for (Parser::Statement *s : i->statements) {
-      s->accept(this);
-      scope->statements.push_back((Statement *)next);
+
+  uint32_t resolve(Symbols::Symbol id, Ref n) {
+    uint32_t v = scopes.lookup(id);
+    if (!v)
+      ir.error(n, "Variable " + name(id) + " not in scope");
+    return v;
+  }
+
+  Type type(const Parser::Type *t) {
+    Type s = Type::ERROR;
+    switch (t->type) {
+    case Symbols::INTEGER:
+      s = Type::INTEGER;
+      break;
+    case Symbols::REAL:
+      s = Type::REAL;
+      break;
+    case Symbols::STRING:
+      s = Type::STRING;
+      break;
+    case Symbols::BOOLEAN:
+      s = Type::BOOLEAN;
+      break;
+    case Symbols::VOID:
+      return Type::VOID;
+    default:
+      ir.error(IR::NONE, "Unknown type " + name(t->type));
+      return Type::ERROR;
     }
-    next = scope;
+    return t->isArray ? IR::arrayOf(s) : s;
   }
-  void visitStatement(const Parser::Statement *i) override {
-    std::cout << "STATEMENT";
+
+  void visitProgram(const Parser::Program *i) override {
+    ir.name = i->id;
+    for (Parser::Function *f : i->functions)
+      f->accept(this);
+    ir.main = lower(i->block);
   }
-  void visitSimpleStatement(const Parser::SimpleStatement *i) override {
-    std::cout << "SIMPLESTATEMENT";
+  void visitFunction(const Parser::Function *i) override {
+    IR::Function f{i->id, type(i->returnType), {}, IR::NONE, {}};
+    // the parameters are in a scope around the body
+    scopes.enter();
+    for (Parser::Parameter *p : i->parameters) {
+      f.params.push_back(declare(p->id, type(p->type), IR::NONE));
+      f.references.push_back(p->byReference);
+    }
+    f.body = lower(i->block);
+    scopes.leave();
+    ir.functions.push_back(f);
   }
-  void visitStructuredStatement(const Parser::StructuredStatement *i) override {
-    std::cout << "STRUCTUREDSTATEMENT";
+  void visitParameter(const Parser::Parameter *i) override {}
+  void visitType(const Parser::Type *i) override {}
+  void visitBlock(const Parser::Block *i) override {
+    next = block(i->statements.begin(), i->statements.end());
   }
+  void visitStatement(const Parser::Statement *i) override {}
+  void visitSimpleStatement(const Parser::SimpleStatement *i) override {}
+  void visitStructuredStatement(const Parser::StructuredStatement *i) override {}
   void visitVarDecl(const Parser::VarDecl *i) override {
-    Declare *d = new Declare();
-    d->names = i->ids;
-    d->type = toTypeStr(i->type);
-    next = d;
+    Type t = type(i->type);
+    for (auto id : i->ids) {
+      Ref size = i->type->isArray && i->type->size ? lower(i->type->size)
+                                                   : IR::NONE;
+      Ref d = ir.add(Op::DECLARE, Type::VOID, 0, size);
+      ir.a[d] = declare(id, t, d);
+      statements->push_back(d);
+    }
+    next = IR::NONE;
   }
 
   void visitAssign(const Parser::Assign *i) override {
-    Assign *a = new Assign();
-    a->name = i->id;
-    i->expression->accept(this);
-    a->expr = (Expr *)next;
-    next = a;
+    Ref value = lower(i->expression);
+    Ref index = i->index ? lower(i->index) : IR::NONE;
+    Ref n = ir.add(Op::ASSIGN, Type::VOID, 0, value, index);
+    ir.a[n] = resolve(i->id, n);
+    next = n;
   }
   void visitCall(const Parser::Call *i) override {
-    Call *c = new Call();
-    c->name = i->id;
-    for (auto a : i->arguments) {
-      a->accept(this);
-      c->args.push_back((Expr *)next);
-    }
-    next = c;
+    std::vector<Ref> args;
+    for (auto a : i->arguments)
+      args.push_back(lower(a));
+    Ref n = ir.add(Op::CALL, Type::VOID, i->id);
+    ir.setList(n, args);
+    next = n;
+  }
+  void visitReturn(const Parser::Return *i) override {
+    Ref value = i->expression ? lower(i->expression) : IR::NONE;
+    next = ir.add(Op::RETURN, Type::VOID, value);
+  }
+  void visitRead(const Parser::Read *i) override {
+    std::vector<Ref> targets;
+    for (auto v : i->variables)
+      targets.push_back(lower(v));
+    Ref n = ir.add(Op::READ, Type::VOID);
+    ir.setList(n, targets);
+    next = n;
   }
-  void visitReturn(const Parser::Return *i) override { std::cout << "RETURN"; }
-  void visitRead(const Parser::Read *i) override { std::cout << "READ"; }
   void visitWrite(const Parser::Write *i) override {
-    Call *c = new Call();
-    c->name = "writeln";
-    for (auto a : i->arguments) {
-      a->accept(this);
-      c->args.push_back((Expr *)next);
-    }
-    next = c;
+    std::vector<Ref> args;
+    for (auto a : i->arguments)
+      args.push_back(lower(a));
+    Ref n = ir.add(Op::WRITE, Type::VOID);
+    ir.setList(n, args);
+    next = n;
+  }
+  void visitAssert(const Parser::Assert *i) override {
+    next = ir.add(Op::ASSERT, Type::VOID, lower(i->expression));
+  }
+  void visitIf(const Parser::If *i) override {
+    Ref cond = lower(i->condition);
+    Ref then = branch(i->thenBranch);
+    Ref otherwise = i->elseBranch ? branch(i->elseBranch) : IR::NONE;
+    next = ir.add(Op::IF, Type::VOID, cond, then, otherwise);
+  }
+  void visitWhile(const Parser::While *i) override {
+    Ref cond = lower(i->condition);
+    Ref body = branch(i->statement);
+    next = ir.add(Op::WHILE, Type::VOID, cond, body);
   }
-  void visitAssert(const Parser::Assert *i) override { std::cout << "ASSERT"; }
-  void visitIf(const Parser::If *i) override { std::cout << "IF"; }
-  void visitWhile(const Parser::While *i) override { std::cout << "WHILE"; }
   void visitExpr(const Parser::Expr *i) override {
+    Ref left = lower(i->left);
     if (i->op) {
-      BinaryOp *b = new BinaryOp();
-      b->op = i->op->op;
-      i->left->accept(this);
-      b->left = (Expr *)next;
-      i->right->accept(this);
-      b->right = (Expr *)next;
-      next = b;
+      Ref right = lower(i->right);
+      next = ir.add(binaryOp(i->op->op), Type::VOID, left, right);
       return;
     }
-    i->left->accept(this);
+    next = left;
   }
   void visitSimpleExpr(const Parser::SimpleExpr *i) override {
-    if (i->terms.size() == 0) {
-      i->term->accept(this);
-      return;
-    }
-    i->term->accept(this);
-    Expr *prev = (Expr *)next;
+    Ref e = lower(i->term);
+    if (i->sign == "-")
+      e = ir.add(Op::NEG, Type::VOID, e);
     for (auto t : i->terms) {
-      BinaryOp *b = new BinaryOp();
-      b->left = prev;
-      b->op = t.first->op;
-      t.second->accept(this);
-      b->right = (Expr *)next;
-      prev = b;
+      Ref right = lower(t.second);
+      e = ir.add(binaryOp(t.first->op), Type::VOID, e, right);
     }
-    next = prev;
+    next = e;
   }
-  void visitRelationalOperator(const Parser::RelationalOperator *i) override {
-    std::cout << "RO" << i->op << " ";
+  void visitRelationalOperator(const Parser::RelationalOperator *i) override {}
+  void visitAddingOperator(const Parser::AddingOperator *i) override {}
+  void visitNot(const Parser::Not *i) override {
+    next = ir.add(Op::NOT, Type::VOID, lower(i->factor));
   }
-  void visitAddingOperator(const Parser::AddingOperator *i) override {
-    std::cout << "AO" << i->op << " ";
+  void visitSize(const Parser::Size *i) override {
+    next = ir.add(Op::SIZE, Type::VOID, lower(i->factor));
   }
-  void visitNot(const Parser::Not *i) override { std::cout << "NOT"; }
-  void visitSize(const Parser::Size *i) override { std::cout << "SIZE"; }
   void visitTerm(const Parser::Term *i) override {
-    if (i->factors.size() == 0) {
-      i->factor->accept(this);
-      return;
+    Ref e = lower(i->factor);
+    for (auto f : i->factors) {
+      Ref right = lower(f.second);
+      e = ir.add(binaryOp(f.first->op), Type::VOID, e, right);
     }
-    i->factor->accept(this);
-    Expr *prev = (Expr *)next;
-    for (auto t : i->factors) {
-      BinaryOp *b = new BinaryOp();
-      b->left = prev;
-      b->op = t.first->op;
-      t.second->accept(this);
-      b->right = (Expr *)next;
-      prev = b;
-    }
-    next = prev;
-  }
-  void visitFactor(const Parser::Factor *i) override { std::cout << "FACTOR"; }
-  void visitMultiplyingOperator(const Parser::MultiplyingOperator *i) override {
-    std::cout << "MO" << i->op << " ";
+    next = e;
   }
+  void visitFactor(const Parser::Factor *i) override {}
+  void visitMultiplyingOperator(const Parser::MultiplyingOperator *i) override {}
   void visitVariable(const Parser::Variable *i) override {
-    Variable *v = new Variable();
-    v->name = i->id;
-    if (i->index) {
-      i->index->accept(this);
-      v->index = (Expr *)next;
+    // true and false are predeclared, but can be shadowed
+    if (!scopes.lookup(i->id) &&
+        (i->id == Symbols::TRUE || i->id == Symbols::FALSE) && !i->index) {
+      next = ir.add(Op::BOOL, Type::BOOLEAN, i->id == Symbols::TRUE);
+      return;
     }
-    next = v;
+    Ref index = i->index ? lower(i->index) : IR::NONE;
+    Ref n = ir.add(Op::VAR, Type::VOID, 0, index);
+    ir.a[n] = resolve(i->id, n);
+    next = n;
   }
-  void visitLiteral(const Parser::Literal *i) override { std::cout << "LIT"; }
+  void visitLiteral(const Parser::Literal *i) override {}
   void visitIntegerLiteral(const Parser::IntegerLiteral *i) override {
-    Literal *l = new Literal();
-    l->value = i->value;
-    l->type = "integer";
-    next = l;
+    int32_t v = 0;
+    auto r = std::from_chars(i->value.data(), i->value.data() + i->value.size(),
+                             v);
+    next = ir.add(Op::INT, Type::INTEGER, (uint32_t)v);
+    if (r.ec != std::errc())
+      ir.error(next, "Integer literal " + std::string(i->value) +
+                         " is out of range");
   }
   void visitRealLiteral(const Parser::RealLiteral *i) override {
-    Literal *l = new Literal();
-    l->value = i->value;
-    l->type = "real";
-    next = l;
+    ir.reals.push_back(std::strtod(std::string(i->value).c_str(), nullptr));
+    next = ir.add(Op::REAL, Type::REAL, ir.reals.size() - 1);
   }
   void visitStringLiteral(const Parser::StringLiteral *i) override {
-    Literal *l = new Literal();
-    l->value = i->value;
-    l->type = "string";
-    next = l;
+    ir.strings.push_back(unescape(i->value));
+    next = ir.add(Op::STR, Type::STRING, ir.strings.size() - 1);
   }
 };
 
 // Runs only the scanner and prints to stdout
-void runScanner(const std::string source) {
-  Scanner::init(source);
+void runScanner(std::string_view source) {
+  Scanner::Scanner scanner;
+  scanner.init(source);
   int line = -1;
   for (;;) {
-    Scanner::Token *token = Scanner::scanToken();
-    if (token->line != line) {
-      printf("%4d ", token->line);
-      line = token->line;
+    Scanner::Token token = scanner.scanToken();
+    if (token.line != line) {
+      printf("%4d ", token.line);
+      line = token.line;
     } else {
       printf("   | ");
     }
-    printf("%-12s '%.*s' %s\n", Scanner::getName(token).c_str(), token->length,
-           token->start, token->message);
+    printf("%-12s '%.*s' %s\n", Scanner::getName(token).c_str(), token.length,
+           token.start, token.message);
 
-    if (token->type == Scanner::TokenType::SCAN_EOF)
+    if (token.type == Scanner::TokenType::SCAN_EOF)
       break;
   }
 }
 
-class Printer : public IRVisitor {
+// Scans the whole source without printing and reports throughput
+void benchScanner(std::string_view source) {
+  auto begin = std::chrono::steady_clock::now();
+  Scanner::Scanner scanner;
+  scanner.init(source);
+  long tokens = 0;
+  for (;;) {
+    Scanner::Token token = scanner.scanToken();
+    tokens++;
+    if (token.type == Scanner::TokenType::SCAN_EOF)
+      break;
+  }
+  std::chrono::duration<double> secs =
+      std::chrono::steady_clock::now() - begin;
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  printf("bytes:      %zu\n", source.size());
+  printf("tokens:     %ld\n", tokens);
+  printf("seconds:    %.4f\n", secs.count());
+  printf("tokens/sec: %.0f\n", tokens / secs.count());
+  printf("MB/sec:     %.1f\n", source.size() / secs.count() / 1e6);
+  printf("peak RSS:   %ld kB\n", usage.ru_maxrss);
+}
+
+// Parses the whole source into an arena and reports its size and throughput
+void benchParser(std::string_view source) {
+  auto begin = std::chrono::steady_clock::now();
+  Symbols::Interner interner;
+  Memory::Arena arena;
+  std::string diagnostics;
+  Parser::Program *p;
+  bool ok = Parser::parse(source, &p, interner, arena, diagnostics);
+  std::chrono::duration<double> secs =
+      std::chrono::steady_clock::now() - begin;
+  std::cerr << diagnostics;
+  long lines = std::count(source.begin(), source.end(), '\n');
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  printf("parsed:     %s\n", ok ? "ok" : "with errors");
+  printf("lines:      %ld\n", lines);
+  printf("seconds:    %.4f\n", secs.count());
+  printf("lines/sec:  %.0f\n", lines / secs.count());
+  printf("tree bytes: %zu in %zu blocks\n", arena.used(), arena.blocks());
+  printf("peak RSS:   %ld kB\n", usage.ru_maxrss);
+}
+
+
+static bool isSimple(Type t) {
+  return t == Type::INTEGER || t == Type::REAL || t == Type::STRING ||
+         t == Type::BOOLEAN;
+}
+
+// Type checks the IR in one pass over the node columns. Operands always
+// come before their users, so their types are known when a node is seen.
+class Decorator {
 public:
-  void visitProgram(const Program *i) override {
-    std::cout << "PROGRAM\n";
-    std::cout << "FUNCTIONS\n";
-    for (auto f : i->functions)
-      f->accept(this);
-    std::cout << "END_FUNCTIONS\n";
-    std::cout << "MAIN\n";
-    i->scope->accept(this);
-    std::cout << "END_MAIN\n";
-    std::cout << "END_PROGRAM:\n";
-  }
-  void visitFunction(const Function *i) override { std::cout << "FUNCTION\n"; }
-  void visitStatement(const Statement *i) override {
-    std::cout << "STATEMENT\n";
-  }
-  void visitScope(const Scope *i) override {
-    std::cout << "SCOPE\n";
-    for (auto f : i->statements) {
-      std::cout << "\t";
-      f->accept(this);
+  IR::Program &ir;
+  const Symbols::Interner &names;
+  std::vector<uint32_t> functionOf; // function index + 1 by Symbol
+  uint32_t current = 0;             // function the node is in, size for main
+
+  Decorator(IR::Program &ir, const Symbols::Interner &names)
+      : ir(ir), names(names), functionOf(names.size()) {}
+
+  std::string name(Symbols::Symbol s) const {
+    return std::string(names.name(s));
+  }
+
+  void run() {
+    for (uint32_t f = 0; f < ir.functions.size(); f++) {
+      const IR::Function &fn = ir.functions[f];
+      if (functionOf[fn.name])
+        ir.error(fn.body, name(fn.name) + " is already declared");
+      else
+        functionOf[fn.name] = f + 1;
     }
-    std::cout << "END_SCOPE\n";
-  }
-  void visitIf(const If *i) override { std::cout << "IF\n"; }
-  void visitWhile(const While *i) override { std::cout << "WHILE\n"; }
-  void visitExpr(const Expr *i) override { std::cout << "EXPR\n"; }
-  void visitDeclare(const Declare *i) override {
-    std::cout << "DECLARE:" << i->type << ":";
-    for (auto n : i->names) {
-      std::cout << n << ",";
-    }
-    std::cout << "\n";
-  }
-  void visitAssign(const Assign *i) override {
-    std::cout << "ASSIGN " << i->name << ":"
-              << " ";
-    i->expr->accept(this);
-    std::cout << "\n";
-  }
-  void visitCall(const Call *i) override { std::cout << "CALL\n"; }
-  void visitReturn(const Return *i) override { std::cout << "RETURN\n"; }
-  void visitRead(const Read *i) override { std::cout << "READ\n"; }
-  void visitAssert(const Assert *i) override { std::cout << "ASSERT\n"; }
-  void visitUnaryOp(const UnaryOp *i) override { std::cout << "UNARYOP\n"; }
-  void visitBinaryOp(const BinaryOp *i) override {
-    std::cout << "BINARYOP:" << i->type << ":";
-    i->left->accept(this);
-    std::cout << i->op;
-    i->right->accept(this);
-    //
-  }
-  void visitVariable(const Variable *i) override { std::cout << "VARIABLE"; }
-  void visitLiteral(const Literal *i) override { std::cout << "LITERAL"; }
-};
+    // bodies are lowered in order, each after its nodes
+    for (Ref n = 1; n < ir.size(); n++) {
+      while (current < ir.functions.size() && n > ir.functions[current].body)
+        current++;
+      check(n);
+    }
+  }
 
-std::string toArgType(std::list<Expr *> args) {
-  std::string s = args.front()->type;
-  int skip = 0;
-  for (auto a : args) {
-    if (skip < 1) {
-      skip++;
-      continue;
+  // true if argument i of call n, for a var parameter, is passed to an
+  // earlier one too
+  bool passedBefore(Ref n, const IR::Function &f, size_t i) const {
+    const Ref *args = ir.begin(n);
+    for (size_t j = 0; j < i; j++)
+      if (f.references[j] && ir.op[args[j]] == Op::VAR &&
+          ir.a[args[j]] == ir.a[args[i]])
+        return true;
+    return false;
+  }
+
+  void call(Ref n, const IR::Function &f) {
+    size_t count = ir.end(n) - ir.begin(n);
+    if (count != f.params.size()) {
+      ir.error(n, name(f.name) + " takes " + std::to_string(f.params.size()) +
+                      " arguments, not " + std::to_string(count));
+      return;
+    }
+    for (size_t i = 0; i < count; i++) {
+      Ref arg = ir.begin(n)[i];
+      Type t = ir.vars[f.params[i]].type, o = ir.type[arg];
+      std::string what = "Argument " + std::to_string(i + 1) + " of " +
+                         name(f.name);
+      if (f.references[i] && (ir.op[arg] != Op::VAR || ir.b[arg] != IR::NONE))
+        ir.error(n, what + " must be a variable");
+      else if (f.references[i] && passedBefore(n, f, i))
+        // a copy of the body would share one variable, a call would not
+        ir.error(n, what + ": " + name(ir.vars[ir.a[arg]].name) +
+                        " is already passed to a var parameter");
+      else if (o != t && o != Type::ERROR && t != Type::ERROR)
+        ir.error(n, what + " must be " + IR::typeName(t) + ", not " +
+                        IR::typeName(o));
     }
-    s = s + "_" + a->type;
   }
-  return s;
-}
 
-std::list<std::string> vars;
-class Decorator : public IRVisitor {
-public:
-  std::map<std::string, std::string> tab;
-  void visitProgram(const Program *i) override {
-    for (Function *f : i->functions) {
-      f->accept(this);
-      for (auto e : f->errors_out)
-        i->appendError(e);
-    }
-    i->scope->accept(this);
-    for (auto e : i->scope->errors_out)
-      i->appendError(e);
-    i->symtab = tab;
-  }
-  void visitFunction(const Function *i) override { std::cout << "FUNCTION\n"; }
-  void visitStatement(const Statement *i) override {
-    std::cout << "STATEMENT\n";
-  }
-  void visitScope(const Scope *i) override {
-    std::map<std::string, std::string> outer(i->symtab);
-    tab = i->symtab;
-    for (auto s : i->statements) {
-      s->accept(this);
-    }
-    tab = outer;
-  }
-  void visitIf(const If *i) override { std::cout << "IF\n"; }
-  void visitWhile(const While *i) override { std::cout << "WHILE\n"; }
-  void visitExpr(const Expr *i) override { std::cout << i->type << "EXPR\n"; }
-  void visitDeclare(const Declare *i) override {
-    for (auto n : i->names) {
-      if (tab.count(n)) {
-        i->appendError_out("At declare" + n + " already in scope.\n");
+  void return_(Ref n) {
+    Type result = current < ir.functions.size() ? ir.functions[current].result
+                                                : Type::VOID;
+    Ref value = ir.a[n];
+    if (result == Type::VOID) {
+      if (value != IR::NONE)
+        ir.error(n, "Only functions return a value");
+    } else if (value == IR::NONE)
+      ir.error(n, "Missing return value of type " + IR::typeName(result));
+    else
+      expect(n, value, result, "Return value");
+  }
+
+  void expect(Ref n, Ref operand, Type t, const char *what) {
+    Type o = ir.type[operand];
+    if (o != t && o != Type::ERROR)
+      ir.error(n, std::string(what) + " must be " + IR::typeName(t) +
+                      ", not " + IR::typeName(o));
+  }
+
+  Type variable(Ref n) {
+    const IR::Variable &v = ir.vars[ir.a[n]];
+    if (ir.b[n] == IR::NONE)
+      return v.type;
+    expect(n, ir.b[n], Type::INTEGER, "Array index");
+    if (v.type == Type::ERROR)
+      return Type::ERROR;
+    if (!IR::isArray(v.type)) {
+      ir.error(n, name(v.name) + " is not an array");
+      return Type::ERROR;
+    }
+    return IR::elementOf(v.type);
+  }
+
+  Type unary(Ref n) {
+    Type t = ir.type[ir.a[n]];
+    if (t == Type::ERROR)
+      return t;
+    bool ok = ir.op[n] == Op::NOT ? t == Type::BOOLEAN
+                                  : t == Type::INTEGER || t == Type::REAL;
+    if (!ok) {
+      ir.error(n, std::string("Operator ") + opText(ir.op[n]) +
+                      " is not defined for " + IR::typeName(t));
+      return Type::ERROR;
+    }
+    return t;
+  }
+
+  Type binary(Ref n) {
+    Type l = ir.type[ir.a[n]], r = ir.type[ir.b[n]];
+    if (l == Type::ERROR || r == Type::ERROR)
+      return Type::ERROR;
+    if (l != r) {
+      ir.error(n, std::string("Operands of ") + opText(ir.op[n]) +
+                      " have different types, " + IR::typeName(l) + " and " +
+                      IR::typeName(r));
+      return Type::ERROR;
+    }
+    bool ok;
+    switch (ir.op[n]) {
+    case Op::ADD:
+      ok = l == Type::INTEGER || l == Type::REAL || l == Type::STRING;
+      break;
+    case Op::SUB:
+    case Op::MUL:
+    case Op::DIV:
+      ok = l == Type::INTEGER || l == Type::REAL;
+      break;
+    case Op::MOD:
+      ok = l == Type::INTEGER;
+      break;
+    case Op::AND:
+    case Op::OR:
+      ok = l == Type::BOOLEAN;
+      break;
+    default:
+      ok = isSimple(l);
+    }
+    if (!ok) {
+      ir.error(n, std::string("Operator ") + opText(ir.op[n]) +
+                      " is not defined for " + IR::typeName(l));
+      return Type::ERROR;
+    }
+    return IR::isComparison(ir.op[n]) ? Type::BOOLEAN : l;
+  }
+
+  void check(Ref n) {
+    switch (ir.op[n]) {
+    case Op::VAR:
+      ir.type[n] = variable(n);
+      break;
+    case Op::SIZE:
+      if (!IR::isArray(ir.type[ir.a[n]])) {
+        if (ir.type[ir.a[n]] != Type::ERROR)
+          ir.error(n, ".size needs an array, not " +
+                          IR::typeName(ir.type[ir.a[n]]));
+        ir.type[n] = Type::ERROR;
+      } else
+        ir.type[n] = Type::INTEGER;
+      break;
+    case Op::NEG:
+    case Op::NOT:
+      ir.type[n] = unary(n);
+      break;
+    case Op::CALL: {
+      uint32_t f = functionOf[ir.a[n]];
+      if (!f) {
+        ir.error(n, "Unknown function " + name(ir.a[n]));
+        ir.type[n] = Type::ERROR;
+      } else {
+        call(n, ir.functions[f - 1]);
+        ir.type[n] = ir.functions[f - 1].result;
+      }
+      break;
+    }
+    case Op::RETURN:
+      return_(n);
+      break;
+    case Op::DECLARE:
+      if (ir.b[n] != IR::NONE)
+        expect(n, ir.b[n], Type::INTEGER, "Array size");
+      else if (IR::isArray(ir.vars[ir.a[n]].type))
+        ir.error(n, "Array " + name(ir.vars[ir.a[n]].name) + " needs a size");
+      break;
+    case Op::ASSIGN: {
+      const IR::Variable &v = ir.vars[ir.a[n]];
+      Type target = v.type;
+      if (ir.c[n] != IR::NONE) {
+        expect(n, ir.c[n], Type::INTEGER, "Array index");
+        if (!IR::isArray(target) && target != Type::ERROR)
+          ir.error(n, name(v.name) + " is not an array");
+        target = IR::isArray(target) ? IR::elementOf(target) : Type::ERROR;
       }
-      tab[n] = i->type;
-      vars.push_back(n);
-    }
-  }
-  void visitAssign(const Assign *i) override {
-    if (!tab.count(i->name)) {
-      i->appendError_out("At assign" + i->name + " not in scope.\n");
-    }
-    i->expr->accept(this);
-    for (auto e : i->expr->errors_out)
-      i->appendError_out(e);
-    if (i->expr->type.compare(tab[i->name]) != 0) {
-      i->appendError_out("At assign" + i->name + " is of type" + i->type +
-                         " not " + i->expr->type + ".\n");
-    }
-  }
-  void visitCall(const Call *i) override {
-    for (auto a : i->args) {
-      a->accept(this);
-      for (auto e : a->errors_out)
-        i->appendError_out(e);
-    }
-    i->type = toArgType(i->args);
-  }
-  void visitReturn(const Return *i) override { std::cout << "RETURN\n"; }
-  void visitRead(const Read *i) override { std::cout << "READ\n"; }
-  void visitAssert(const Assert *i) override { std::cout << "ASSERT\n"; }
-  void visitUnaryOp(const UnaryOp *i) override { std::cout << "UNARYOP\n"; }
-  void visitBinaryOp(const BinaryOp *i) override {
-    i->left->accept(this);
-    i->right->accept(this);
-    if (i->left->type.compare(i->right->type) != 0) {
-      i->appendError_out("At binaryOP" + i->right->name + " is of type" +
-                         i->right->type + " not " + i->left->type + ".\n");
-    }
-    i->type = i->left->type;
-    for (auto e : i->left->errors_out)
-      i->appendError_out(e);
-    for (auto e : i->right->errors_out)
-      i->appendError_out(e);
-  }
-  void visitVariable(const Variable *i) override {
-    if (!tab.count(i->name))
-      i->appendError_out("Variable " + i->name + " not in scope");
-  }
-  void visitLiteral(const Literal *i) override {}
+      Type value = ir.type[ir.b[n]];
+      if (target != Type::ERROR && value != Type::ERROR && target != value)
+        ir.error(n, "Cannot assign " + IR::typeName(value) + " to " +
+                        name(v.name) + " of type " + IR::typeName(target));
+      break;
+    }
+    case Op::READ:
+      for (const Ref *r = ir.begin(n); r != ir.end(n); r++) {
+        Type t = ir.type[*r];
+        if (t != Type::ERROR && !isSimple(t))
+          ir.error(n, "Cannot read a value of type " + IR::typeName(t));
+      }
+      break;
+    case Op::WRITE:
+      for (const Ref *r = ir.begin(n); r != ir.end(n); r++) {
+        Type t = ir.type[*r];
+        if (t != Type::ERROR && !isSimple(t))
+          ir.error(n, "Cannot write a value of type " + IR::typeName(t));
+      }
+      break;
+    case Op::ASSERT:
+    case Op::IF:
+    case Op::WHILE:
+      expect(n, ir.a[n], Type::BOOLEAN, "Condition");
+      break;
+    default:
+      if (IR::isBinary(ir.op[n]))
+        ir.type[n] = binary(n);
+    }
+  }
 };
 
-void emitLine(std::string l) { out = out + l + "\n"; }
+// linear memory below this address is left to the runtime library, which
+// keeps the heads of its free lists there
+static const uint32_t DATA_START = 48;
+// offset of the first element of an array from its address
+static const uint32_t ELEMENTS = 8;
 
-class Generator : public IRVisitor {
+using Wasm::Instr;
+namespace W = Wasm;
+
+// Lowers the IR into functions of a module that already holds the runtime
+// library, main first and then the functions it calls, in the order the
+// calls are met. Variables live in wasm locals, see Locals::allocate, with
+// strings and arrays held as addresses in the format of the runtime
+// library. Array elements are bounds checked where the IR does not say
+// their index is in range. String literals are packed into one data
+// segment, each distinct one once. Var parameters are passed in and come
+// back as extra results, which the caller stores into the variables. Arrays
+// a block owns, see IR::Program::ownedArray, and copies of array
+// parameters are freed when they go out of scope, and their old value when
+// a whole array is assigned to them. With Options::simd, loops the
+// vectorizer matches get a v128 loop in front. With Options::debugLines,
+// the code of each statement is marked with its source line.
+class Generator {
 public:
-  int free = 0;
-  std::map<std::string, int> addr;
-
-  void claimAddr(std::string name, std::string type) {
-    if (type.compare("integer") == 0) {
-      int a = free;
-      free++;
-      emitLine("(data (i32.const " + std::to_string(a) + "))");
-      addr[name] = a;
-    } else if (type.compare("string") == 0) {
-      int a = free;
-      free += 20;
-      emitLine("(data (i32.const " + std::to_string(a) +
-               ") \"                    \")");
-      addr[name] = a;
-    } else
-      std::cout << "Unknown type:" << type << std::endl;
-  }
-
-  void visitProgram(const Program *i) override {
-    for (auto f : i->functions)
-      f->accept(this);
-    emitLine("(func (export \"main\") ");
-    // emitLine(" i32.const 10");
-    // int in = 0;
-    for (auto n : vars) {
-      // claimAddr(s.first, s.second);
-      std::cout << n << i->symtab[n] << std::endl;
-      if (i->symtab[n].compare("integer") == 0)
-        emitLine("(local $" + n + " i32)");
-      // in++;
-    }
-    emitLine(" i32.const 10");
-    emitLine(" call $writeln_string");
-    i->scope->accept(this);
-    emitLine(")");
-  }
-  void visitFunction(const Function *i) override { std::cout << "FUNCTION\n"; }
-  void visitStatement(const Statement *i) override {
-    std::cout << "STATEMENT\n";
-  }
-  void visitScope(const Scope *i) override {
-    std::cout << "SCOPE\n";
-    for (auto f : i->statements) {
-      std::cout << "\t";
-      f->accept(this);
+  IR::Program &ir;
+  Wasm::Module &m;
+  const Options &options;
+  const Symbols::Interner &names;
+  std::vector<Instr> *code = nullptr;
+  Locals::Allocation slots;
+  std::string literals; // the data segment, laid out from DATA_START
+  std::unordered_map<std::string, uint32_t> literalAt; // address by literal
+  bool ok = true;
+  const IR::Function *function = nullptr; // being generated, null for main
+  uint32_t firstLocal = 0; // of the function, after its parameters
+  // scratch locals, added once used: an index, and a value by i32 or f64
+  uint32_t indexLocal = W::NOT_FOUND;
+  uint32_t valueLocal[2] = {W::NOT_FOUND, W::NOT_FOUND};
+  std::vector<uint32_t> index; // wasm function by IR function, once called
+  // arrays to free: copied parameters, then those of the enclosing blocks
+  std::vector<uint32_t> owned;
+  std::vector<uint32_t> queue; // IR functions in the order of their index
+  uint32_t firstQueued = 0;    // wasm index of queue[0]
+
+  Generator(IR::Program &ir, Wasm::Module &m, const Options &options,
+            const Symbols::Interner &names)
+      : ir(ir), m(m), options(options), names(names),
+        index(ir.functions.size(), W::NOT_FOUND) {}
+
+  void emit(W::Op op, uint32_t a = 0) { code->push_back(Instr{op, a}); }
+  void emit(const Instr &i) { code->push_back(i); }
+  void i32(int32_t v) {
+    Instr i{W::Op::I32_CONST};
+    i.i = v;
+    code->push_back(i);
+  }
+  void f64(double v) {
+    Instr i{W::Op::F64_CONST};
+    i.f = v;
+    code->push_back(i);
+  }
+  // calls a function of the runtime library
+  void call(const char *name) {
+    uint32_t f = m.function(name);
+    if (f == W::NOT_FOUND) {
+      ir.error(IR::NONE, std::string("Runtime library has no $") + name);
+      ok = false;
     }
-    std::cout << "END_SCOPE\n";
-  }
-  void visitIf(const If *i) override { std::cout << "IF\n"; }
-  void visitWhile(const While *i) override { std::cout << "WHILE\n"; }
-  void visitExpr(const Expr *i) override { std::cout << "EXPR\n"; }
-  void visitDeclare(const Declare *i) override {
-    std::cout << "DECLARE:" << i->type << ":";
-    for (auto n : i->names) {
-      std::cout << n << ",";
-    }
-    std::cout << "\n";
-  }
-  void visitAssign(const Assign *i) override {
-    std::cout << "ASSIGN " << i->name << ":"
-              << " ";
-    i->expr->accept(this);
-    std::cout << "\n";
-  }
-  void visitCall(const Call *i) override { std::cout << "CALL\n"; }
-  void visitReturn(const Return *i) override { std::cout << "RETURN\n"; }
-  void visitRead(const Read *i) override { std::cout << "READ\n"; }
-  void visitAssert(const Assert *i) override { std::cout << "ASSERT\n"; }
-  void visitUnaryOp(const UnaryOp *i) override { std::cout << "UNARYOP\n"; }
-  void visitBinaryOp(const BinaryOp *i) override {
-    std::cout << "BINARYOP:" << i->type << ":";
-    i->left->accept(this);
-    std::cout << i->op;
-    i->right->accept(this);
-    //
-  }
-  void visitVariable(const Variable *i) override { std::cout << "VARIABLE"; }
-  void visitLiteral(const Literal *i) override { std::cout << "LITERAL"; }
+    emit(W::Op::CALL, f);
+  }
+
+  bool owns(uint32_t var) const {
+    return std::find(owned.begin(), owned.end(), var) != owned.end();
+  }
+
+  // frees the owned arrays from position mark on, all but keep
+  void release(size_t mark, uint32_t keep = 0) {
+    for (size_t i = mark; i < owned.size(); i++)
+      if (owned[i] != keep) {
+        load(owned[i]);
+        call("free");
+      }
+  }
+
+  // the code from here on is of the line of statement n, if it has one
+  void mark(Ref n) {
+    uint32_t line = ir.line[n];
+    if (!options.debugLines || !line)
+      return;
+    auto &lines = m.functions.back().lines;
+    uint32_t at = code->size();
+    // a statement before this one may have had no code
+    if (!lines.empty() && lines.back().first == at)
+      lines.pop_back();
+    if (lines.empty() || lines.back().second != line)
+      lines.push_back({at, line});
+  }
+
+  // the address of a string literal, its length aligned to 4 bytes
+  uint32_t stringLiteral(const std::string &s) {
+    if (s.empty())
+      return 0;
+    auto [it, added] = literalAt.try_emplace(s, 0);
+    if (added) {
+      literals.resize((literals.size() + 3) & ~size_t(3));
+      it->second = DATA_START + literals.size();
+      for (int i = 0; i < 4; i++)
+        literals += (char)(s.size() >> 8 * i);
+      literals += s;
+    }
+    return it->second;
+  }
+
+  void load(uint32_t var) { emit(W::Op::LOCAL_GET, slots.slot[var]); }
+
+  // a new local of type t
+  uint32_t addLocal(W::ValType t) {
+    std::vector<W::ValType> &locals = m.functions.back().locals;
+    locals.push_back(t);
+    return firstLocal + locals.size() - 1;
+  }
+
+  // a scratch local of type t, added to the function on its first use
+  uint32_t scratch(uint32_t &local, W::ValType t) {
+    if (local == W::NOT_FOUND)
+      local = addLocal(t);
+    return local;
+  }
+
+  // log2 of the bytes an element of array type t takes
+  static int32_t shift(Type t) {
+    return IR::elementOf(t) == Type::REAL ? 3 : 2;
+  }
+  static W::Op loadOp(Type t) {
+    return t == Type::REAL ? W::Op::F64_LOAD : W::Op::I32_LOAD;
+  }
+  static W::Op storeOp(Type t) {
+    return t == Type::REAL ? W::Op::F64_STORE : W::Op::I32_STORE;
+  }
+
+  // Leaves the address of element index of array var, less ELEMENTS, on
+  // the stack. An index out of range traps, unless the bounds analysis has
+  // proved that it never is at access n.
+  void element(Ref n, uint32_t var, Ref index) {
+    if (ir.inBounds.count(n)) {
+      load(var);
+      expr(index);
+    } else {
+      uint32_t i = scratch(indexLocal, W::ValType::I32);
+      expr(index);
+      emit(W::Op::LOCAL_TEE, i);
+      load(var);
+      emit(W::memory(W::Op::I32_LOAD));
+      emit(W::Op::I32_GE_U); // negative indices compare as big ones
+      emit(W::Op::IF, W::VOID_BLOCK);
+      emit(W::Op::UNREACHABLE);
+      emit(W::Op::END);
+      load(var);
+      emit(W::Op::LOCAL_GET, i);
+    }
+    i32(shift(ir.vars[var].type));
+    emit(W::Op::I32_SHL);
+    emit(W::Op::I32_ADD);
+  }
+
+  // true if evaluating n calls a function or stores to a variable
+  bool hasEffects(Ref n) const {
+    switch (ir.op[n]) {
+    case Op::CALL:
+    case Op::TEE:
+      return true;
+    case Op::INT:
+    case Op::REAL:
+    case Op::STR:
+    case Op::BOOL:
+      return false;
+    case Op::VAR:
+      return ir.b[n] != IR::NONE && hasEffects(ir.b[n]);
+    default:
+      return hasEffects(ir.a[n]) ||
+             (IR::isBinary(ir.op[n]) && hasEffects(ir.b[n]));
+    }
+  }
+
+  // The IR evaluates the value of an element assignment before the index,
+  // the store wants the address first. Where the order shows, the value
+  // waits in a scratch local.
+  void assignElement(Ref n) {
+    uint32_t var = ir.a[n];
+    Ref value = ir.b[n];
+    Type t = IR::elementOf(ir.vars[var].type);
+    W::ValType vt = valType(t);
+    Op o = ir.op[value];
+    bool literal =
+        o == Op::INT || o == Op::REAL || o == Op::STR || o == Op::BOOL;
+    bool spill = hasEffects(value) || (hasEffects(ir.c[n]) && !literal);
+    uint32_t v = 0;
+    if (spill) {
+      v = scratch(valueLocal[vt == W::ValType::F64], vt);
+      expr(value);
+      emit(W::Op::LOCAL_SET, v);
+    }
+    element(n, var, ir.c[n]);
+    if (spill)
+      emit(W::Op::LOCAL_GET, v);
+    else
+      expr(value);
+    emit(W::memory(storeOp(t), ELEMENTS));
+  }
+
+  // true if a var parameter of f may be passed the array of parameter p
+  bool aliased(const IR::Function &f, uint32_t p) const {
+    for (size_t i = 0; i < f.params.size(); i++)
+      if (f.references[i] && ir.vars[f.params[i]].type == ir.vars[p].type)
+        return true;
+    return false;
+  }
+
+  // true if the code of n assigns var or an element of it
+  bool changes(Ref n, uint32_t var) const {
+    if (n == IR::NONE)
+      return false;
+    switch (ir.op[n]) {
+    case Op::INT:
+    case Op::REAL:
+    case Op::STR:
+    case Op::BOOL:
+      return false;
+    case Op::CALL:
+      for (size_t i = 0; i < ir.c[n]; i++)
+        if (ir.byReference(n, i) && ir.a[ir.begin(n)[i]] == var)
+          return true;
+      [[fallthrough]];
+    case Op::READ:
+    case Op::WRITE:
+    case Op::BLOCK:
+      for (const Ref *r = ir.begin(n); r != ir.end(n); r++)
+        if ((ir.op[n] == Op::READ && ir.a[*r] == var) || changes(*r, var))
+          return true;
+      return false;
+    case Op::VAR:
+    case Op::TEE:
+    case Op::DECLARE:
+      return changes(ir.b[n], var);
+    case Op::ASSIGN:
+      return ir.a[n] == var || changes(ir.b[n], var) || changes(ir.c[n], var);
+    default:
+      return changes(ir.a[n], var) ||
+             ((IR::isBinary(ir.op[n]) || ir.op[n] == Op::IF ||
+               ir.op[n] == Op::WHILE) &&
+              changes(ir.b[n], var)) ||
+             (ir.op[n] == Op::IF && changes(ir.c[n], var));
+    }
+  }
+
+  // Leaves the lanes of vector expression n of a loop matched by the
+  // vectorizer on the stack, with scalars splatted into the given locals
+  void vector(Ref n, const Vectorizer::Loop &v,
+              const std::unordered_map<uint32_t, uint32_t> &splats) {
+    bool real = v.element == Type::REAL;
+    switch (ir.op[n]) {
+    case Op::INT:
+      i32(ir.a[n]);
+      emit(W::Op::I32X4_SPLAT);
+      return;
+    case Op::REAL:
+      f64(ir.reals[ir.a[n]]);
+      emit(W::Op::F64X2_SPLAT);
+      return;
+    case Op::VAR:
+      if (ir.b[n] == IR::NONE) {
+        emit(W::Op::LOCAL_GET, splats.at(ir.a[n]));
+      } else {
+        lanes(ir.a[n], v.counter);
+        Instr load = W::memory(W::Op::V128_LOAD, ELEMENTS);
+        load.a = shift(ir.vars[ir.a[n]].type); // elements are not 16 aligned
+        emit(load);
+      }
+      return;
+    case Op::NEG:
+      vector(ir.a[n], v, splats);
+      emit(real ? W::Op::F64X2_NEG : W::Op::I32X4_NEG);
+      return;
+    default:
+      break;
+    }
+    vector(ir.a[n], v, splats);
+    vector(ir.b[n], v, splats);
+    switch (ir.op[n]) {
+    case Op::ADD:
+      return emit(real ? W::Op::F64X2_ADD : W::Op::I32X4_ADD);
+    case Op::SUB:
+      return emit(real ? W::Op::F64X2_SUB : W::Op::I32X4_SUB);
+    case Op::MUL:
+      return emit(real ? W::Op::F64X2_MUL : W::Op::I32X4_MUL);
+    default:
+      return emit(W::Op::F64X2_DIV);
+    }
+  }
+
+  // the address of element i of array var, less ELEMENTS
+  void lanes(uint32_t var, uint32_t i) {
+    load(var);
+    load(i);
+    i32(shift(ir.vars[var].type));
+    emit(W::Op::I32_SHL);
+    emit(W::Op::I32_ADD);
+  }
+
+  // Runs the iterations of a loop matched by the vectorizer a v128 at a
+  // time, as long as all of their accesses are in range and their counter
+  // below the limit. The scalar loop generated after it does the rest and
+  // traps where an access is out of range.
+  void vectorLoop(const Vectorizer::Loop &v) {
+    int32_t width = Vectorizer::lanes(v.element);
+    W::ValType vt = W::ValType::V128;
+    uint32_t i = v.counter, limit = addLocal(W::ValType::I32);
+    // limit := the least of the limit and the sizes of the arrays
+    expr(v.limit);
+    emit(W::Op::LOCAL_SET, limit);
+    uint32_t size = scratch(indexLocal, W::ValType::I32);
+    for (uint32_t a : v.arrays) {
+      load(a);
+      emit(W::memory(W::Op::I32_LOAD));
+      emit(W::Op::LOCAL_TEE, size);
+      emit(W::Op::LOCAL_GET, limit);
+      emit(W::Op::LOCAL_GET, size);
+      emit(W::Op::LOCAL_GET, limit);
+      emit(W::Op::I32_LT_S);
+      emit(W::Op::SELECT);
+      emit(W::Op::LOCAL_SET, limit);
+    }
+    emit(W::Op::BLOCK, W::VOID_BLOCK);
+    load(i);
+    i32(0);
+    emit(W::Op::I32_LT_S);
+    emit(W::Op::BR_IF, 0);
+    emit(W::Op::LOCAL_GET, limit);
+    i32(width);
+    emit(W::Op::I32_LT_S);
+    emit(W::Op::BR_IF, 0);
+    // from here on limit is the last counter a vector iteration starts at
+    emit(W::Op::LOCAL_GET, limit);
+    i32(width);
+    emit(W::Op::I32_SUB);
+    emit(W::Op::LOCAL_SET, limit);
+    std::unordered_map<uint32_t, uint32_t> splats; // local by variable
+    for (uint32_t s : v.scalars) {
+      load(s);
+      emit(v.element == Type::REAL ? W::Op::F64X2_SPLAT : W::Op::I32X4_SPLAT);
+      emit(W::Op::LOCAL_SET, splats[s] = addLocal(vt));
+    }
+    std::vector<uint32_t> sums(v.statements.size()); // local by statement
+    for (size_t k = 0; k < sums.size(); k++)
+      if (ir.c[v.statements[k]] == IR::NONE) {
+        i32(0);
+        emit(W::Op::I32X4_SPLAT);
+        emit(W::Op::LOCAL_SET, sums[k] = addLocal(vt));
+      }
+    emit(W::Op::BLOCK, W::VOID_BLOCK);
+    emit(W::Op::LOOP, W::VOID_BLOCK);
+    load(i);
+    emit(W::Op::LOCAL_GET, limit);
+    emit(W::Op::I32_GT_S);
+    emit(W::Op::BR_IF, 1);
+    for (size_t k = 0; k < sums.size(); k++) {
+      Ref s = v.statements[k];
+      if (ir.c[s] != IR::NONE) {
+        lanes(ir.a[s], i);
+        vector(ir.b[s], v, splats);
+        Instr store = W::memory(W::Op::V128_STORE, ELEMENTS);
+        store.a = shift(ir.vars[ir.a[s]].type);
+        emit(store);
+        continue;
+      }
+      // the operand of s + e that is not s
+      Ref e = ir.a[ir.b[s]];
+      if (ir.op[e] == Op::VAR && ir.b[e] == IR::NONE && ir.a[e] == ir.a[s])
+        e = ir.b[ir.b[s]];
+      emit(W::Op::LOCAL_GET, sums[k]);
+      vector(e, v, splats);
+      emit(W::Op::I32X4_ADD);
+      emit(W::Op::LOCAL_SET, sums[k]);
+    }
+    load(i);
+    i32(width);
+    emit(W::Op::I32_ADD);
+    store(i);
+    emit(W::Op::BR, 0);
+    emit(W::Op::END);
+    emit(W::Op::END);
+    // integers wrap, so the lanes add up to the sum in any order
+    for (size_t k = 0; k < sums.size(); k++) {
+      if (ir.c[v.statements[k]] != IR::NONE)
+        continue;
+      uint32_t var = ir.a[v.statements[k]];
+      load(var);
+      for (int32_t lane = 0; lane < width; lane++) {
+        emit(W::Op::LOCAL_GET, sums[k]);
+        emit(W::Op::I32X4_EXTRACT_LANE, lane);
+        emit(W::Op::I32_ADD);
+      }
+      store(var);
+    }
+    emit(W::Op::END);
+  }
+
+  void store(uint32_t var) { emit(W::Op::LOCAL_SET, slots.slot[var]); }
+
+  static W::ValType valType(Type t) {
+    return t == Type::REAL ? W::ValType::F64 : W::ValType::I32;
+  }
+
+  // the wasm index of function f, which is queued on its first call; the
+  // queue follows main, and the functions pushed so far are still in it
+  uint32_t callee(const IR::Function *f) {
+    uint32_t i = f - ir.functions.data();
+    if (index[i] == W::NOT_FOUND) {
+      index[i] = firstQueued + queue.size();
+      queue.push_back(i);
+    }
+    return index[i];
+  }
+
+  // leaves the result, if any, on the stack
+  void call(Ref n) {
+    const IR::Function *f = ir.callee(n);
+    const Ref *args = ir.begin(n);
+    for (size_t i = 0; i < f->params.size(); i++)
+      expr(args[i]);
+    emit(W::Op::CALL, callee(f));
+    for (size_t i = f->params.size(); i-- > 0;)
+      if (f->references[i])
+        store(ir.a[args[i]]);
+  }
+
+  // the values of the var parameters, the last results of a function
+  void outputs() {
+    if (!function)
+      return;
+    for (size_t i = 0; i < function->params.size(); i++)
+      if (function->references[i])
+        emit(W::Op::LOCAL_GET, slots.slot[function->params[i]]);
+  }
+
+  void expr(Ref n) {
+    Type t = ir.type[n];
+    switch (ir.op[n]) {
+    case Op::INT:
+      i32((int32_t)ir.a[n]);
+      return;
+    case Op::BOOL:
+      i32(ir.a[n]);
+      return;
+    case Op::REAL:
+      f64(ir.reals[ir.a[n]]);
+      return;
+    case Op::STR:
+      i32(stringLiteral(ir.strings[ir.a[n]]));
+      return;
+    case Op::VAR:
+      if (ir.b[n] != IR::NONE) {
+        element(n, ir.a[n], ir.b[n]);
+        emit(W::memory(loadOp(t), ELEMENTS));
+        return;
+      }
+      load(ir.a[n]);
+      return;
+    case Op::TEE:
+      expr(ir.b[n]);
+      emit(W::Op::LOCAL_TEE, slots.slot[ir.a[n]]);
+      return;
+    case Op::SIZE:
+      expr(ir.a[n]);
+      emit(W::memory(W::Op::I32_LOAD));
+      return;
+    case Op::CALL:
+      return call(n);
+    case Op::NEG:
+      if (t == Type::REAL) {
+        expr(ir.a[n]);
+        emit(W::Op::F64_NEG);
+        return;
+      }
+      i32(0);
+      expr(ir.a[n]);
+      intOp(Op::SUB);
+      return;
+    case Op::NOT:
+      expr(ir.a[n]);
+      intOp(Op::NOT);
+      return;
+    default:
+      break;
+    }
+    Type operands = ir.type[ir.a[n]];
+    expr(ir.a[n]);
+    expr(ir.b[n]);
+    if (operands == Type::STRING)
+      return stringOp(ir.op[n]);
+    if (operands == Type::REAL) {
+      emit(realOp(ir.op[n]));
+      return;
+    }
+    intOp(ir.op[n]);
+  }
+
+  // + joins strings and comparisons order them bytewise
+  void stringOp(Op o) {
+    switch (o) {
+    case Op::ADD:
+      return call("string_concat");
+    case Op::EQ:
+      return call("string_equal");
+    case Op::NEQ:
+      call("string_equal");
+      return intOp(Op::NOT);
+    default:
+      call("string_compare");
+      i32(0);
+      intOp(o);
+    }
+  }
+
+  // integer and Boolean operators, in the host only when debugging them
+  void intOp(Op o) {
+    if (options.hostMath)
+      call(IR::opName(o));
+    else
+      emit(nativeOp(o));
+  }
+
+  // division truncates and % takes the sign of the dividend, as in the
+  // host; dividing by zero traps where the host would return 0
+  static W::Op nativeOp(Op o) {
+    switch (o) {
+    case Op::NOT:
+      return W::Op::I32_EQZ;
+    case Op::ADD:
+      return W::Op::I32_ADD;
+    case Op::SUB:
+      return W::Op::I32_SUB;
+    case Op::MUL:
+      return W::Op::I32_MUL;
+    case Op::DIV:
+      return W::Op::I32_DIV_S;
+    case Op::MOD:
+      return W::Op::I32_REM_S;
+    case Op::AND:
+      return W::Op::I32_AND;
+    case Op::OR:
+      return W::Op::I32_OR;
+    case Op::EQ:
+      return W::Op::I32_EQ;
+    case Op::NEQ:
+      return W::Op::I32_NE;
+    case Op::LT:
+      return W::Op::I32_LT_S;
+    case Op::LTE:
+      return W::Op::I32_LE_S;
+    case Op::GT:
+      return W::Op::I32_GT_S;
+    default:
+      return W::Op::I32_GE_S;
+    }
+  }
+
+  static W::Op realOp(Op o) {
+    switch (o) {
+    case Op::ADD:
+      return W::Op::F64_ADD;
+    case Op::SUB:
+      return W::Op::F64_SUB;
+    case Op::MUL:
+      return W::Op::F64_MUL;
+    case Op::DIV:
+      return W::Op::F64_DIV;
+    case Op::EQ:
+      return W::Op::F64_EQ;
+    case Op::NEQ:
+      return W::Op::F64_NE;
+    case Op::LT:
+      return W::Op::F64_LT;
+    case Op::LTE:
+      return W::Op::F64_LE;
+    case Op::GT:
+      return W::Op::F64_GT;
+    default:
+      return W::Op::F64_GE;
+    }
+  }
+
+  void write(Ref n) {
+    switch (ir.type[n]) {
+    case Type::INTEGER:
+      expr(n);
+      call("write_int");
+      break;
+    case Type::REAL:
+      expr(n);
+      call("write_real");
+      break;
+    case Type::BOOLEAN:
+      expr(n);
+      call("write_bool");
+      break;
+    default:
+      expr(n);
+      call("write_string");
+    }
+  }
+
+  void read(Ref n) {
+    uint32_t var = ir.a[n];
+    Type t = ir.vars[var].type;
+    bool indexed = ir.b[n] != IR::NONE;
+    if (indexed) {
+      t = IR::elementOf(t);
+      element(n, var, ir.b[n]);
+    }
+    switch (t) {
+    case Type::INTEGER:
+      call("read_int");
+      break;
+    case Type::BOOLEAN: // any integer, nonzero is true
+      call("read_int");
+      i32(0);
+      emit(W::Op::I32_NE);
+      break;
+    case Type::REAL:
+      call("read_real");
+      break;
+    default:
+      call("read_string");
+    }
+    if (indexed)
+      emit(W::memory(storeOp(t), ELEMENTS));
+    else
+      store(var);
+  }
+
+  void statement(Ref n) {
+    mark(n);
+    switch (ir.op[n]) {
+    case Op::BLOCK: {
+      size_t mark = owned.size();
+      for (const Ref *s = ir.begin(n); s != ir.end(n); s++) {
+        statement(*s);
+        if (uint32_t v = ir.ownedArray(*s))
+          owned.push_back(v);
+      }
+      // the end of a block left by a return is never reached
+      if (!ir.c[n] || ir.op[*(ir.end(n) - 1)] != Op::RETURN)
+        release(mark);
+      owned.resize(mark);
+      break;
+    }
+    case Op::DECLARE: {
+      // variables start out zeroed, the empty string for strings, also
+      // when a loop declares them again
+      // slots are shared, so this also clears what an earlier variable left
+      uint32_t var = ir.a[n];
+      Type t = ir.vars[var].type;
+      if (IR::isArray(t)) {
+        expr(ir.b[n]);
+        i32(shift(t));
+        call("array_new");
+        store(var);
+      } else {
+        if (t == Type::REAL)
+          f64(0);
+        else
+          i32(0);
+        store(var);
+      }
+      break;
+    }
+    case Op::ASSIGN: {
+      if (ir.c[n] != IR::NONE)
+        return assignElement(n);
+      uint32_t var = ir.a[n];
+      expr(ir.b[n]);
+      // arrays are values, assigning one copies it unless a call returned
+      // a new one; the old value is freed if owned
+      if (IR::isArray(ir.vars[var].type)) {
+        if (ir.op[ir.b[n]] != Op::CALL) {
+          i32(shift(ir.vars[var].type));
+          call("array_copy");
+        }
+        if (owns(var)) {
+          load(var);
+          call("free");
+        }
+      }
+      store(var);
+      break;
+    }
+    case Op::CALL:
+      call(n);
+      if (ir.type[n] != Type::VOID)
+        emit(W::Op::DROP);
+      break;
+    case Op::READ:
+      for (const Ref *r = ir.begin(n); r != ir.end(n); r++)
+        read(*r);
+      break;
+    case Op::WRITE:
+      for (const Ref *a = ir.begin(n); a != ir.end(n); a++)
+        write(*a);
+      call("writeln");
+      break;
+    case Op::ASSERT:
+      expr(ir.a[n]);
+      emit(W::Op::I32_EQZ);
+      emit(W::Op::IF, W::VOID_BLOCK);
+      call("assert_failed");
+      emit(W::Op::END);
+      break;
+    case Op::RETURN: {
+      // a returned array is new to the caller: an owned one is handed
+      // over, any other is copied unless a call returned it
+      Ref value = ir.a[n];
+      uint32_t keep = 0;
+      if (value != IR::NONE) {
+        expr(value);
+        if (IR::isArray(ir.type[value])) {
+          if (ir.op[value] == Op::VAR && owns(ir.a[value]))
+            keep = ir.a[value];
+          else if (ir.op[value] != Op::CALL) {
+            i32(shift(ir.type[value]));
+            call("array_copy");
+          }
+        }
+      }
+      release(0, keep);
+      outputs();
+      emit(W::Op::RETURN);
+      break;
+    }
+    case Op::IF:
+      expr(ir.a[n]);
+      emit(W::Op::IF, W::VOID_BLOCK);
+      statement(ir.b[n]);
+      if (ir.c[n] != IR::NONE) {
+        emit(W::Op::ELSE);
+        statement(ir.c[n]);
+      }
+      emit(W::Op::END);
+      break;
+    case Op::WHILE: {
+      Vectorizer::Loop v;
+      if (options.simd && options.optimize >= 1 && Vectorizer::match(ir, n, v))
+        vectorLoop(v);
+      emit(W::Op::BLOCK, W::VOID_BLOCK);
+      emit(W::Op::LOOP, W::VOID_BLOCK);
+      expr(ir.a[n]);
+      emit(W::Op::I32_EQZ);
+      emit(W::Op::BR_IF, 1);
+      statement(ir.b[n]);
+      emit(W::Op::BR, 0);
+      emit(W::Op::END);
+      emit(W::Op::END);
+      break;
+    }
+    default:
+      break;
+    }
+  }
+
+  void run() {
+    firstQueued = m.functionCount() + 1; // after main
+    generate(nullptr);
+    // generating a function may queue more
+    for (size_t i = 0; i < queue.size(); i++)
+      generate(&ir.functions[queue[i]]);
+    if (!literals.empty())
+      m.data.push_back({DATA_START, literals});
+    // the heap starts after the literals
+    uint32_t heap = m.global("heap");
+    if (heap != W::NOT_FOUND)
+      m.globals[heap].init.i = (DATA_START + literals.size() + 7) & ~7u;
+    m.dropUnused();
+  }
+
+  // generates f, or main if f is null
+  void generate(const IR::Function *f) {
+    function = f;
+    Ref body = f ? f->body : ir.main;
+    W::Function w;
+    W::FuncType t;
+    if (f) {
+      w.name = "fn." + std::string(names.name(f->name));
+      for (uint32_t p : f->params) {
+        t.params.push_back(valType(ir.vars[p].type));
+        w.localNames.push_back(std::string(names.name(ir.vars[p].name)));
+      }
+      if (f->result != Type::VOID)
+        t.results.push_back(valType(f->result));
+      for (size_t i = 0; i < f->params.size(); i++)
+        if (f->references[i])
+          t.results.push_back(t.params[i]);
+    } else {
+      w.name = "main";
+      w.exportName = "main";
+    }
+    slots = Locals::allocate(ir, body, f ? f->params : std::vector<uint32_t>{});
+    w.type = m.type(t);
+    w.locals = slots.locals;
+    m.functions.push_back(std::move(w));
+    code = &m.functions.back().body;
+    firstLocal = t.params.size();
+    indexLocal = valueLocal[0] = valueLocal[1] = W::NOT_FOUND;
+    owned.clear();
+    // an array parameter is a value, so a body changing it gets a copy;
+    // so does one a var parameter may share an array with, as in p(x, x)
+    for (size_t i = 0; f && i < f->params.size(); i++) {
+      uint32_t p = f->params[i];
+      if (IR::isArray(ir.vars[p].type) && !f->references[i] &&
+          (changes(body, p) || aliased(*f, p))) {
+        load(p);
+        i32(shift(ir.vars[p].type));
+        call("array_copy");
+        store(p);
+        owned.push_back(p);
+      }
+    }
+    statement(body);
+    // a return at the end leaves the results where the end expects them
+    if (!code->empty() && code->back().op == W::Op::RETURN)
+      code->pop_back();
+    else if (f && f->result != Type::VOID)
+      emit(W::Op::UNREACHABLE); // a function must return its value
+    else {
+      release(0);
+      outputs();
+    }
+  }
 };
 
-// uses visitor to traverse IR and do semantic checks
-void decorateIR() {
-  Decorator *d = new Decorator();
-  ir->accept(d);
-  Printer *p = new Printer();
-  // ir->accept(p);
+// The runtime library, parsed once and copied into every module
+static const Wasm::Module &runtime() {
+  static const Wasm::Module lib = [] {
+    Wasm::Module m;
+    std::string error;
+    if (!Wasm::parse(WASMLIB, m, error)) {
+      fprintf(stderr, "wasmlib.wat: %s\n", error.c_str());
+      std::abort();
+    }
+    return m;
+  }();
+  return lib;
 }
 
-// converts parse tree into AST/IR
-void createIR(Parser::Program *p) {
-  ir = new Program();
-  ParseTreeWalker *ptw = new ParseTreeWalker();
-  p->accept(ptw);
+bool Session::report() {
+  for (auto &e : ir.errors)
+    diag += e.message + "\n";
+  return ir.errors.empty();
 }
 
-std::string read_lib() {
-  std::string path = "src/wasmlib/wasmlib.wat";
-  std::ifstream in(path, std::ios::in | std::ios::binary);
-  if (in) {
-    std::string contents;
-    in.seekg(0, std::ios::end);
-    contents.resize(in.tellg());
-    in.seekg(0, std::ios::beg);
-    in.read(&contents[0], contents.size());
-    in.close();
-    return (contents);
-  }
-  throw(errno);
+// converts parse tree into IR
+void Session::createIR(Parser::Program *p) {
+  ir.clear();
+  ParseTreeWalker ptw(ir, interner, scopes);
+  p->accept(&ptw);
 }
-void write_out(std::string s) {
-  std::ofstream myfile;
-  myfile.open("out.wat");
-  myfile << s;
-  myfile.close();
+
+// type checks the IR
+bool Session::decorateIR() {
+  Decorator d(ir, interner);
+  d.run();
+  return report();
 }
-void generate() {
-  std::string lib = read_lib();
-  Generator *g = new Generator();
-  ir->accept(g);
-  std::string fin = "(module \n" + lib + "\n" + out + ")";
-  write_out(fin);
+
+// runs the IR passes of the optimization level
+void Session::optimize() {
+  if (options.optimize < 1)
+    return;
+  std::vector<Optimizer::Inlined> decisions;
+  size_t inlined = Optimizer::inlineCalls(
+      ir, options.inlineLimit, options.inlineReport ? &decisions : nullptr);
+  for (const Optimizer::Inlined &d : decisions) {
+    std::string name(interner.name(ir.functions[d.function].name));
+    stats += "inline: " + name + ", " + std::to_string(d.size) + " nodes: " +
+             std::to_string(d.inlined) + " of " + std::to_string(d.calls) +
+             " calls inlined";
+    stats += d.kept.empty() ? "\n" : ", " + d.kept + "\n";
+  }
+  size_t nodes = ir.size();
+  size_t folded = Optimizer::fold(ir);
+  size_t removed = Optimizer::eliminateDeadCode(ir);
+  if (options.stats) {
+    stats += "inl:  " + std::to_string(inlined) + " calls inlined\n";
+    stats += "fold: " + std::to_string(folded) + " of " +
+             std::to_string(nodes) + " nodes rewritten\n";
+    stats += "dce:  " + std::to_string(removed) + " nodes removed\n";
+  }
+  if (options.optimize >= 2) {
+    size_t hoisted = Optimizer::hoistInvariants(ir);
+    size_t reduced = Optimizer::reduceStrength(ir);
+    size_t replaced = SSA::numberValues(ir);
+    if (options.stats) {
+      stats += "licm: " + std::to_string(hoisted) + " expressions hoisted\n";
+      stats += "sr:   " + std::to_string(reduced) + " products reduced\n";
+      stats += "gvn:  " + std::to_string(replaced) + " expressions replaced\n";
+    }
+  }
+  if (options.keepBoundsChecks)
+    return;
+  size_t proved = Optimizer::removeBoundsChecks(ir);
+  if (options.stats)
+    stats += "bce:  " + std::to_string(proved) + " bounds checks removed\n";
+}
+
+bool Session::generate(Sink::Buffer &to) {
+  Wasm::Module m = runtime();
+  Generator g(ir, m, options, interner);
+  g.run();
+  if (!report())
+    return false;
+  if (options.optimize >= 1) {
+    size_t removed = Peephole::rewrite(m);
+    if (options.stats)
+      stats += "peep: " + std::to_string(removed) + " instructions removed\n";
+  }
+  if (options.emit == Emit::WAT)
+    Wasm::print(m, to);
+  else
+    Wasm::encode(m, to);
+  return true;
+}
+
+void runParser(std::string_view source) { Parser::parse(source); }
+
+// Compiles the whole source to a module in memory and reports throughput
+void benchCompiler(const Source::Buffer &source, const Options &options) {
+  auto begin = std::chrono::steady_clock::now();
+  Session session(options);
+  bool ok = session.compile(source);
+  std::chrono::duration<double> secs =
+      std::chrono::steady_clock::now() - begin;
+  std::cerr << session.diagnostics() << session.statistics();
+  std::string_view text = source.view();
+  long lines = std::count(text.begin(), text.end(), '\n');
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  printf("compiled:   %s\n", ok ? "ok" : "with errors");
+  printf("lines:      %ld\n", lines);
+  printf("seconds:    %.4f\n", secs.count());
+  printf("ns/line:    %.0f\n", secs.count() * 1e9 / lines);
+  printf("output:     %zu bytes\n", session.output().size());
+  printf("peak RSS:   %ld kB\n", usage.ru_maxrss);
+}
+
+bool Session::compile(const Source::Buffer &source) {
+  out.clear();
+  return compile(source, out);
 }
 
-void runParser(const std::string source) { Parser::parse(source); }
-void compile(const std::string source) {
-  //
+bool Session::compile(const Source::Buffer &source, Sink::Buffer &to) {
+  diag.clear();
+  stats.clear();
+  interner.clear();
   Parser::Program *p;
-  if (Parser::parse(source, &p)) {
-    // ParserUtils::pprint(p);
+  bool parsed = Parser::parse(source.view(), &p, interner, tree, diag);
+  if (parsed)
     createIR(p);
-    decorateIR();
-    if (ir->errors.size() == 0)
-      generate();
-  } else {
-    std::cout << "PARSE ERROR, NO OUTPUT\n";
+  // the parse tree is not needed after lowering
+  tree.release();
+  if (!parsed) {
+    diag += "PARSE ERROR, NO OUTPUT\n";
+    return false;
   }
+  if (!decorateIR())
+    return false;
+  optimize();
+  size_t start = to.size();
+  if (!generate(to))
+    return false;
+  if (options.stats)
+    stats += "output: " + std::to_string(to.size() - start) + " bytes\n";
+  return true;
 }
 
 } // namespace Compiler
@@ -1,177 +1,88 @@
 #ifndef COMPILER_H_
 #define COMPILER_H_
 
+#include "arena.h"
+#include "ir.h"
 #include "parser.h"
-#include <list>
-#include <map>
+#include "sink.h"
+#include "source.h"
+#include "symbols.h"
+#include <cstddef>
 #include <string>
-#include <vector>
+#include <string_view>
 
 namespace Compiler {
 
-class Program;
-class Function;
-class Statement;
-class Scope;
-class If;
-class While;
-class Expr;
-class Declare;
-class Assign;
-class Call;
-class Return;
-class Read;
-class Assert;
-class UnaryOp;
-class BinaryOp;
-class Variable;
-class Literal;
-
-class IRVisitor {
-public:
-  virtual void visitProgram(const Program *i) = 0;
-  virtual void visitFunction(const Function *i) = 0;
-  virtual void visitStatement(const Statement *i) = 0;
-  virtual void visitScope(const Scope *i) = 0;
-  virtual void visitIf(const If *i) = 0;
-  virtual void visitWhile(const While *i) = 0;
-  virtual void visitExpr(const Expr *i) = 0;
-  virtual void visitDeclare(const Declare *i) = 0;
-  virtual void visitAssign(const Assign *i) = 0;
-  virtual void visitCall(const Call *i) = 0;
-  virtual void visitReturn(const Return *i) = 0;
-  virtual void visitRead(const Read *i) = 0;
-  virtual void visitAssert(const Assert *i) = 0;
-  virtual void visitUnaryOp(const UnaryOp *i) = 0;
-  virtual void visitBinaryOp(const BinaryOp *i) = 0;
-  virtual void visitVariable(const Variable *i) = 0;
-  virtual void visitLiteral(const Literal *i) = 0;
-};
-
-class IRNode {
-public:
-  mutable std::string type = "void";
-  mutable std::string name;
-  mutable std::list<std::string> errors;
-  mutable std::list<std::string> errors_in;
-  mutable std::list<std::string> errors_out;
-  mutable std::map<std::string, std::string> symtab; // name,type
-  virtual void accept(IRVisitor *v) = 0;
-  void appendError(const std::string s) const { errors.emplace_back(s); }
-  void appendError_in(const std::string s) const { errors_in.emplace_back(s); }
-  void appendError_out(const std::string s) const {
-    errors_out.emplace_back(s);
-  }
-};
-
-class Program : public IRNode {
-public:
-  std::list<Function *> functions;
-  Scope *scope;
-  void accept(IRVisitor *v) override { v->visitProgram(this); }
-};
-
-class Function : public IRNode {
-public:
-  Scope *scope;
-  void accept(IRVisitor *v) override { v->visitFunction(this); }
-};
-
-class Statement : public IRNode {
-public:
-  void accept(IRVisitor *v) override { v->visitStatement(this); }
-};
-
-class Scope : public IRNode {
-public:
-  std::list<Statement *> statements;
-  void accept(IRVisitor *v) override { v->visitScope(this); }
-};
-
-class If : public Statement {
-public:
-  Scope *scope1;
-  Scope *scope2;
-  void accept(IRVisitor *v) override { v->visitIf(this); }
-};
-
-class While : public Statement {
-public:
-  Scope *scope;
-  void accept(IRVisitor *v) override { v->visitWhile(this); }
-};
-
-class Declare : public Statement {
-public:
-  std::list<std::string> names;
-  void accept(IRVisitor *v) override { v->visitDeclare(this); }
-};
-
-class Assign : public Statement {
-public:
-  Expr *expr;
-  void accept(IRVisitor *v) override { v->visitAssign(this); }
-};
-
-class Call : public Statement {
-public:
-  std::list<Expr *> args;
-  void accept(IRVisitor *v) override { v->visitCall(this); }
-};
-
-class Return : public Statement {
-public:
-  Expr *expr;
-  void accept(IRVisitor *v) override { v->visitReturn(this); }
-};
-
-class Read : public Statement {
-public:
-  std::list<std::string> names;
-  void accept(IRVisitor *v) override { v->visitRead(this); }
-};
-
-class Assert : public Statement {
-public:
-  Expr *expr;
-  void accept(IRVisitor *v) override { v->visitAssert(this); }
-};
-
-class Expr : public IRNode {
-public:
-  void accept(IRVisitor *v) override { v->visitExpr(this); }
-};
-
-class Literal : public Expr {
-public:
-  std::string value;
-  void accept(IRVisitor *v) override { v->visitLiteral(this); }
-};
-
-class BinaryOp : public Expr {
-public:
-  std::string op;
-  Expr *left;
-  Expr *right;
-  void accept(IRVisitor *v) override { v->visitBinaryOp(this); }
-};
-
-class UnaryOp : public Expr {
-public:
-  std::string op;
-  Expr *left;
-  void accept(IRVisitor *v) override { v->visitUnaryOp(this); }
-};
-
-class Variable : public Expr {
-public:
-  Expr *index;
-  void accept(IRVisitor *v) override { v->visitVariable(this); }
-};
-
-void runScanner(const std::string source);
-void runParser(const std::string source);
-void compile(const std::string source);
+// output format of a compile
+enum class Emit { WASM, WAT };
+
+struct Options {
+  Emit emit = Emit::WASM;
+  // integer operators call the math imports of wasmlib.js, for debugging
+  bool hostMath = false;
+  // 0 generates code for the IR as written, 1 inlines calls, folds
+  // constants, removes dead code and the bounds checks of array accesses
+  // proved in range first and rewrites the code with peephole rules after,
+  // 2 also reuses values computed before, see SSA
+  int optimize = 1;
+  // collect what the passes did, see Session::statistics
+  bool stats = false;
+  // functions of more nodes are never inlined, from -O1 on
+  size_t inlineLimit = 40;
+  // add a line for each function called to the statistics, telling how
+  // many of its calls were inlined and why the others were not
+  bool inlineReport = false;
+  // check the index of every array access, even where it is proved in range
+  bool keepBoundsChecks = false;
+  // target engines with SIMD128: from -O1 on, loops over the elements of
+  // arrays run several iterations at once in v128 lanes, see Vectorizer
+  bool simd = false;
+  // map the code of each statement to its source line, in a custom section
+  // of the binary format or comments in the text format
+  bool debugLines = false;
+};
+
+// State of one compilation. Sessions share nothing, so they can run on
+// several threads at once, and one session can compile many programs.
+class Session {
+public:
+  explicit Session(Options options = {}) : options(options) {}
+  // compiles source to a module, returns false on errors. The scanner reads
+  // past the text, which a Source::Buffer pads; Source::Buffer(text) copies
+  // a string or a slice of one
+  bool compile(const Source::Buffer &source);
+  // compiles source to a module written to to, which may be bound to a file
+  bool compile(const Source::Buffer &source, Sink::Buffer &to);
+  // module of the last successful compile(source), binary unless options
+  // say WAT
+  const Sink::Buffer &output() const { return out; }
+  // errors of the last compile
+  const std::string &diagnostics() const { return diag; }
+  // what the passes of the last compile did, a line each, if options.stats
+  // or options.inlineReport
+  const std::string &statistics() const { return stats; }
+
+private:
+  Options options;
+  IR::Program ir;
+  Sink::Buffer out;
+  std::string diag;
+  std::string stats;
+  Symbols::Interner interner;
+  Memory::Arena tree; // parse tree, released once the IR is built
+  Symbols::Scopes scopes;
+  void createIR(Parser::Program *p);
+  bool decorateIR();
+  void optimize();
+  bool generate(Sink::Buffer &to);
+  bool report();
+};
+
+void runScanner(std::string_view source);
+void benchScanner(std::string_view source);
+void benchParser(std::string_view source);
+void benchCompiler(const Source::Buffer &source, const Options &options);
+void runParser(std::string_view source);
 
 } // namespace Compiler
 
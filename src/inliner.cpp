@@ -0,0 +1,471 @@
+#include "optimizer.h"
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Optimizer {
+
+using IR::Op;
+using IR::Ref;
+using IR::Type;
+
+// nodes of code a call costs besides its arguments, and the iterations a
+// loop is assumed to run when weighing the calls inside it
+static const size_t CALL_COST = 8;
+static const size_t LOOP_WEIGHT = 8;
+
+const uint32_t UNSEEN = ~0u;
+
+// Calls f on each operand and statement of n, in evaluation order. Lists
+// are walked by index, since f may append to them.
+template <class F> static void eachChild(const IR::Program &ir, Ref n, F f) {
+  switch (ir.op[n]) {
+  case Op::INT:
+  case Op::REAL:
+  case Op::STR:
+  case Op::BOOL:
+    return;
+  case Op::CALL:
+  case Op::READ:
+  case Op::WRITE:
+  case Op::BLOCK:
+    for (uint32_t i = 0; i < ir.c[n]; i++)
+      f(ir.lists[ir.b[n] + i]);
+    return;
+  case Op::VAR:
+  case Op::TEE:
+  case Op::DECLARE:
+    if (ir.b[n] != IR::NONE)
+      f(ir.b[n]);
+    return;
+  case Op::ASSIGN:
+    f(ir.b[n]);
+    if (ir.c[n] != IR::NONE)
+      f(ir.c[n]);
+    return;
+  default:
+    if (ir.a[n] != IR::NONE)
+      f(ir.a[n]);
+    if (IR::isBinary(ir.op[n]) || ir.op[n] == Op::IF || ir.op[n] == Op::WHILE)
+      f(ir.b[n]);
+    if (ir.op[n] == Op::IF && ir.c[n] != IR::NONE)
+      f(ir.c[n]);
+  }
+}
+
+class Inliner {
+public:
+  IR::Program &ir;
+  size_t limit;
+  size_t inlined = 0;
+  std::vector<Inlined> report; // by function
+
+  Inliner(IR::Program &ir, size_t limit)
+      : ir(ir), limit(limit), callees(ir.functions.size()),
+        recursive(ir.functions.size()), straight(ir.functions.size()),
+        single(ir.functions.size()) {}
+
+  void run() {
+    for (uint32_t f = 0; f < ir.functions.size(); f++)
+      report.push_back({f, 0, 0, 0, {}});
+    std::vector<uint32_t> fromMain;
+    for (uint32_t f = 0; f < ir.functions.size(); f++)
+      collect(ir.functions[f].body, callees[f]);
+    collect(ir.main, fromMain);
+    for (uint32_t f : order()) {
+      body(ir.functions[f].body);
+      shape(f);
+    }
+    body(ir.main);
+  }
+
+private:
+  std::vector<std::vector<uint32_t>> callees; // by function, once a call
+  std::vector<bool> recursive;
+  std::vector<bool> straight; // bodies returning only at their end
+  std::vector<Ref> single;    // the return a body is made of, or NONE
+  uint32_t depth = 0;         // loops around the call walked
+
+  // what the copy of a body reads for a variable of the callee
+  std::unordered_map<uint32_t, uint32_t> rename;
+  // the argument for each value parameter of a single return
+  struct Argument {
+    Ref node;
+    uint32_t reads;    // of the parameter
+    uint32_t temp = 0; // holding the argument once a read has stored it
+  };
+  std::unordered_map<uint32_t, Argument> bound;
+
+  uint32_t index(Ref call) const { return ir.callee(call) - &ir.functions[0]; }
+
+  void collect(Ref n, std::vector<uint32_t> &out) {
+    if (ir.op[n] == Op::CALL) {
+      out.push_back(index(n));
+      report[out.back()].calls++;
+    }
+    eachChild(ir, n, [&](Ref c) { collect(c, out); });
+  }
+
+  // Tarjan's strongly connected components of the call graph, which come
+  // out callees first. A function in a component with others, or calling
+  // itself, is recursive.
+  std::vector<uint32_t> order() {
+    size_t count = callees.size();
+    std::vector<uint32_t> number(count, UNSEEN), low(count), stack, out;
+    std::vector<bool> onStack(count);
+    std::vector<std::pair<uint32_t, size_t>> work; // function, next callee
+    uint32_t next = 0;
+    auto visit = [&](uint32_t f) {
+      number[f] = low[f] = next++;
+      stack.push_back(f);
+      onStack[f] = true;
+      work.push_back({f, 0});
+    };
+    for (uint32_t root = 0; root < count; root++) {
+      if (number[root] != UNSEEN)
+        continue;
+      visit(root);
+      while (!work.empty()) {
+        uint32_t f = work.back().first;
+        if (work.back().second < callees[f].size()) {
+          uint32_t g = callees[f][work.back().second++];
+          if (g == f)
+            recursive[f] = true;
+          if (number[g] == UNSEEN)
+            visit(g);
+          else if (onStack[g])
+            low[f] = std::min(low[f], number[g]);
+          continue;
+        }
+        work.pop_back();
+        if (!work.empty()) {
+          uint32_t caller = work.back().first;
+          low[caller] = std::min(low[caller], low[f]);
+        }
+        if (low[f] != number[f])
+          continue;
+        size_t first = out.size();
+        uint32_t g;
+        do {
+          g = stack.back();
+          stack.pop_back();
+          onStack[g] = false;
+          out.push_back(g);
+        } while (g != f);
+        if (out.size() - first > 1)
+          for (size_t i = first; i < out.size(); i++)
+            recursive[out[i]] = true;
+      }
+    }
+    return out;
+  }
+
+  bool hasReturn(Ref n) const {
+    if (ir.op[n] == Op::RETURN)
+      return true;
+    bool found = false;
+    eachChild(ir, n, [&](Ref c) { found = found || hasReturn(c); });
+    return found;
+  }
+
+  bool passesReference(Ref n) const {
+    bool found = false;
+    if (ir.op[n] == Op::CALL)
+      for (size_t i = 0; i < ir.c[n]; i++)
+        found = found || ir.byReference(n, i);
+    eachChild(ir, n, [&](Ref c) { found = found || passesReference(c); });
+    return found;
+  }
+
+  // true if evaluating n has no effect and cannot trap, so it may be
+  // moved or left out
+  bool pure(Ref n) const {
+    Op o = ir.op[n];
+    if (o == Op::CALL || o == Op::SIZE ||
+        (o == Op::VAR && ir.b[n] != IR::NONE) ||
+        ((o == Op::DIV || o == Op::MOD) && ir.type[n] == Type::INTEGER))
+      return false;
+    bool ok = true;
+    eachChild(ir, n, [&](Ref c) { ok = ok && pure(c); });
+    return ok;
+  }
+
+  // true if n reads an element of variable var
+  bool indexes(Ref n, uint32_t var) const {
+    if (ir.op[n] == Op::VAR && ir.b[n] != IR::NONE && ir.a[n] == var)
+      return true;
+    bool found = false;
+    eachChild(ir, n, [&](Ref c) { found = found || indexes(c, var); });
+    return found;
+  }
+
+  // an argument read again for each use rather than stored
+  bool direct(Ref n) const {
+    Op o = ir.op[n];
+    return o == Op::INT || o == Op::REAL || o == Op::STR || o == Op::BOOL ||
+           (o == Op::VAR && ir.b[n] == IR::NONE);
+  }
+
+  // records the forms a copy of function f may take
+  void shape(uint32_t f) {
+    Ref b = ir.functions[f].body;
+    report[f].size = ir.count(b);
+    uint32_t k = ir.c[b];
+    Ref last = k ? ir.lists[ir.b[b] + k - 1] : IR::NONE;
+    if (last != IR::NONE && ir.op[last] == Op::RETURN)
+      k--;
+    bool early = false;
+    for (uint32_t i = 0; i < k; i++)
+      early = early || hasReturn(ir.lists[ir.b[b] + i]);
+    straight[f] = !early;
+    single[f] = ir.c[b] == 1 && ir.op[last] == Op::RETURN &&
+                        ir.a[last] != IR::NONE && !passesReference(ir.a[last])
+                    ? last
+                    : IR::NONE;
+  }
+
+  void body(Ref n) {
+    depth = 0;
+    statement(n);
+  }
+
+  void statement(Ref n) {
+    switch (ir.op[n]) {
+    case Op::BLOCK:
+      for (uint32_t i = 0; i < ir.c[n]; i++)
+        statement(ir.lists[ir.b[n] + i]);
+      break;
+    case Op::IF:
+      expr(ir.a[n]);
+      statement(ir.b[n]);
+      if (ir.c[n] != IR::NONE)
+        statement(ir.c[n]);
+      break;
+    case Op::WHILE:
+      depth++;
+      expr(ir.a[n]);
+      statement(ir.b[n]);
+      depth--;
+      break;
+    case Op::CALL:
+      call(n, true);
+      break;
+    default:
+      eachChild(ir, n, [&](Ref c) { expr(c); });
+    }
+  }
+
+  void expr(Ref n) {
+    if (ir.op[n] == Op::CALL)
+      return call(n, false);
+    eachChild(ir, n, [&](Ref c) { expr(c); });
+  }
+
+  void call(Ref n, bool statement) {
+    eachChild(ir, n, [&](Ref a) { expr(a); });
+    uint32_t f = index(n);
+    std::string why = decide(n, f, statement);
+    if (!why.empty()) {
+      report[f].kept = why;
+      return;
+    }
+    report[f].inlined++;
+    inlined++;
+    if (statement)
+      procedure(n, ir.functions[f]);
+    else
+      function(n, f);
+  }
+
+  // why the call n of function f is kept, empty if it is to be copied
+  std::string decide(Ref n, uint32_t f, bool statement) const {
+    const IR::Function &fn = ir.functions[f];
+    if (recursive[f])
+      return "recursive";
+    if (report[f].size > limit)
+      return "over the limit of " + std::to_string(limit);
+    if (statement && fn.result != Type::VOID)
+      return "result unused";
+    if (statement && !straight[f])
+      return "returns early";
+    if (!statement && single[f] == IR::NONE)
+      return "more than a return";
+    if (!statement)
+      for (size_t i = 0; i < fn.params.size(); i++) {
+        Ref arg = ir.begin(n)[i];
+        if (!fn.references[i] && !direct(arg) && !pure(arg))
+          return "arguments have effects";
+        // an element is read from the variable passed, see duplicate
+        if (!fn.references[i] && !(ir.op[arg] == Op::VAR &&
+                                   ir.b[arg] == IR::NONE) &&
+            indexes(ir.a[single[f]], fn.params[i]))
+          return "indexes an array argument";
+      }
+    size_t weight = 1;
+    for (uint32_t d = 0; d < std::min(depth, 3u); d++)
+      weight *= LOOP_WEIGHT;
+    if (report[f].calls > 1 && report[f].size > CALL_COST * weight)
+      return "too big to copy outside loops";
+    return "";
+  }
+
+  uint32_t renamed(uint32_t var) const {
+    auto r = rename.find(var);
+    return r != rename.end() ? r->second : var;
+  }
+
+  void countReads(Ref n) {
+    if (ir.op[n] == Op::VAR && ir.b[n] == IR::NONE && bound.count(ir.a[n]))
+      bound[ir.a[n]].reads++;
+    eachChild(ir, n, [&](Ref c) { countReads(c); });
+  }
+
+  // a parameter of a single return, read from its argument
+  Ref argument(uint32_t var) {
+    Argument &arg = bound.at(var);
+    Ref n = arg.node;
+    if (arg.reads == 1)
+      return n;
+    if (direct(n))
+      return ir.add(ir.op[n], ir.type[n], ir.a[n], ir.b[n], ir.c[n]);
+    if (arg.temp)
+      return ir.add(Op::VAR, ir.type[n], arg.temp, IR::NONE);
+    arg.temp = ir.addVariable(ir.vars[var].name, ir.type[n], IR::NONE);
+    return ir.add(Op::TEE, ir.type[n], arg.temp, n);
+  }
+
+  // copies the tree below n with the variables of the callee renamed;
+  // operands are copied in evaluation order, so a parameter is stored by
+  // its first use. Copied statements keep their source lines.
+  Ref copy(Ref n) {
+    if (n == IR::NONE)
+      return IR::NONE;
+    Ref c = duplicate(n);
+    if (ir.line[n])
+      ir.line[c] = ir.line[n];
+    return c;
+  }
+
+  // n itself, see copy
+  Ref duplicate(Ref n) {
+    Op o = ir.op[n];
+    Type t = ir.type[n];
+    switch (o) {
+    case Op::INT:
+    case Op::REAL:
+    case Op::STR:
+    case Op::BOOL:
+      return ir.add(o, t, ir.a[n]);
+    case Op::VAR:
+    case Op::TEE:
+    case Op::ASSIGN: {
+      if (o == Op::VAR && ir.b[n] == IR::NONE && bound.count(ir.a[n]))
+        return argument(ir.a[n]);
+      Ref b = copy(ir.b[n]);
+      Ref c = copy(ir.c[n]);
+      // an element of an array parameter is one of the variable passed
+      if (o == Op::VAR && bound.count(ir.a[n]))
+        return ir.add(o, t, ir.a[bound.at(ir.a[n]).node], b, c);
+      return ir.add(o, t, renamed(ir.a[n]), b, c);
+    }
+    case Op::DECLARE: {
+      Ref size = copy(ir.b[n]);
+      Ref d = ir.add(o, t, 0, size);
+      const IR::Variable &v = ir.vars[ir.a[n]];
+      uint32_t var = ir.addVariable(v.name, v.type, d);
+      rename[ir.a[n]] = var;
+      ir.a[d] = var;
+      return d;
+    }
+    case Op::CALL:
+    case Op::READ:
+    case Op::WRITE:
+    case Op::BLOCK: {
+      std::vector<Ref> list;
+      for (uint32_t i = 0; i < ir.c[n]; i++)
+        list.push_back(copy(ir.lists[ir.b[n] + i]));
+      Ref c = ir.add(o, t, ir.a[n]);
+      ir.setList(c, list);
+      return c;
+    }
+    default: {
+      Ref a = copy(ir.a[n]);
+      Ref b = IR::isBinary(o) || o == Op::IF || o == Op::WHILE
+                  ? copy(ir.b[n])
+                  : IR::NONE;
+      Ref c = o == Op::IF ? copy(ir.c[n]) : IR::NONE;
+      return ir.add(o, t, a, b, c);
+    }
+    }
+  }
+
+  // Rewrites call n into a block storing the arguments for value
+  // parameters and running a copy of the body. Var parameters become the
+  // variables passed for them.
+  void procedure(Ref n, const IR::Function &fn) {
+    rename.clear();
+    bound.clear();
+    std::vector<Ref> args(ir.begin(n), ir.end(n)), list;
+    for (size_t i = 0; i < fn.params.size(); i++) {
+      uint32_t p = fn.params[i];
+      if (fn.references[i]) {
+        rename[p] = ir.a[args[i]];
+        continue;
+      }
+      // the assignment declares the temporary, see Program::ownedArray
+      uint32_t temp = ir.addVariable(ir.vars[p].name, ir.vars[p].type,
+                                     IR::NONE);
+      rename[p] = temp;
+      list.push_back(ir.add(Op::ASSIGN, Type::VOID, temp, args[i], IR::NONE));
+      ir.vars[temp].decl = list.back();
+      ir.line[list.back()] = ir.line[n];
+    }
+    Ref b = fn.body;
+    uint32_t k = ir.c[b];
+    if (k && ir.op[ir.lists[ir.b[b] + k - 1]] == Op::RETURN)
+      k--;
+    for (uint32_t i = 0; i < k; i++)
+      list.push_back(copy(ir.lists[ir.b[b] + i]));
+    ir.op[n] = Op::BLOCK;
+    ir.type[n] = Type::VOID;
+    ir.a[n] = 0;
+    ir.setList(n, list);
+  }
+
+  // Rewrites call n into a copy of the returned expression. Each argument
+  // is evaluated where the parameter is first read, or not at all if it
+  // never is, which only pure arguments allow. An argument read more than
+  // once is stored by the first read, unless it is a literal or variable.
+  void function(Ref n, uint32_t f) {
+    const IR::Function &fn = ir.functions[f];
+    rename.clear();
+    bound.clear();
+    std::vector<Ref> args(ir.begin(n), ir.end(n));
+    for (size_t i = 0; i < fn.params.size(); i++)
+      if (fn.references[i])
+        rename[fn.params[i]] = ir.a[args[i]];
+      else
+        bound[fn.params[i]] = {args[i], 0};
+    countReads(ir.a[single[f]]);
+    Ref e = copy(ir.a[single[f]]);
+    ir.op[n] = ir.op[e];
+    ir.type[n] = ir.type[e];
+    ir.a[n] = ir.a[e];
+    ir.b[n] = ir.b[e];
+    ir.c[n] = ir.c[e];
+  }
+};
+
+size_t inlineCalls(IR::Program &ir, size_t limit,
+                   std::vector<Inlined> *report) {
+  Inliner i(ir, limit);
+  i.run();
+  if (report)
+    for (const Inlined &r : i.report)
+      if (r.calls)
+        report->push_back(r);
+  return i.inlined;
+}
+
+} // namespace Optimizer
@@ -0,0 +1,219 @@
+#include "ir.h"
+
+namespace IR {
+
+#define F(name, text) text,
+static const char *TypeNames[]{IR_TYPES(F)};
+static const char *OpNames[]{IR_OPS(F)};
+#undef F
+
+std::string typeName(Type t) {
+  if (isArray(t))
+    return std::string("array of ") + TypeNames[(int)elementOf(t)];
+  return TypeNames[(int)t];
+}
+
+const char *opName(Op o) { return OpNames[(int)o]; }
+
+void Program::clear() {
+  op.clear();
+  type.clear();
+  a.clear();
+  b.clear();
+  c.clear();
+  line.clear();
+  lists.clear();
+  vars.clear();
+  functions.clear();
+  reals.clear();
+  strings.clear();
+  errors.clear();
+  inBounds.clear();
+  name = Symbols::NONE;
+  main = NONE;
+  // node 0 is NONE and variable 0 stands in for names that did not resolve
+  add(Op::BLOCK, Type::VOID);
+  vars.push_back({Symbols::NONE, Type::ERROR, NONE});
+}
+
+Ref Program::add(Op o, Type t, uint32_t a, uint32_t b, uint32_t c) {
+  op.push_back(o);
+  type.push_back(t);
+  this->a.push_back(a);
+  this->b.push_back(b);
+  this->c.push_back(c);
+  line.push_back(0);
+  return op.size() - 1;
+}
+
+void Program::setList(Ref n, const std::vector<Ref> &refs) {
+  b[n] = lists.size();
+  c[n] = refs.size();
+  lists.insert(lists.end(), refs.begin(), refs.end());
+}
+
+uint32_t Program::addVariable(Symbols::Symbol name, Type t, Ref decl) {
+  vars.push_back({name, t, decl});
+  return vars.size() - 1;
+}
+
+uint32_t Program::ownedArray(Ref n) const {
+  if (op[n] != Op::DECLARE && op[n] != Op::ASSIGN)
+    return 0;
+  const Variable &v = vars[a[n]];
+  return v.decl == n && isArray(v.type) ? a[n] : 0;
+}
+
+size_t Program::count(Ref n) const {
+  if (n == NONE)
+    return 0;
+  size_t k = 1;
+  switch (op[n]) {
+  case Op::INT:
+  case Op::REAL:
+  case Op::STR:
+  case Op::BOOL:
+    return k;
+  case Op::VAR:
+  case Op::TEE:
+  case Op::DECLARE:
+    return k + count(b[n]);
+  case Op::ASSIGN:
+    return k + count(b[n]) + count(c[n]);
+  case Op::CALL:
+  case Op::READ:
+  case Op::WRITE:
+  case Op::BLOCK:
+    for (const Ref *r = begin(n); r != end(n); r++)
+      k += count(*r);
+    return k;
+  default:
+    k += count(a[n]);
+    if (isBinary(op[n]) || op[n] == Op::IF || op[n] == Op::WHILE)
+      k += count(b[n]) + count(c[n]);
+    return k;
+  }
+}
+
+const Function *Program::callee(Ref call) const {
+  for (const Function &f : functions)
+    if (f.name == a[call])
+      return &f;
+  return nullptr;
+}
+
+bool Program::byReference(Ref call, size_t i) const {
+  const Function *f = callee(call);
+  return f && i < f->references.size() && f->references[i];
+}
+
+bool Program::canTrap(Ref n) const {
+  if ((op[n] != Op::DIV && op[n] != Op::MOD) || type[n] != Type::INTEGER)
+    return false;
+  // INT_MIN is the one dividend a divisor of -1 traps on
+  Ref d = b[n];
+  return op[d] != Op::INT || traps(op[n], INT32_MIN, (int32_t)a[d]);
+}
+
+void Program::error(Ref n, std::string message) {
+  errors.push_back({n, std::move(message)});
+}
+
+LoopVars::LoopVars(const Program &ir, Kind kind)
+    : ir(ir), kind(kind), stamp(ir.vars.size()) {
+  for (auto &f : ir.functions)
+    statement(f.body);
+  statement(ir.main);
+}
+
+void LoopVars::expr(Ref n) {
+  if (n == NONE)
+    return;
+  switch (ir.op[n]) {
+  case Op::INT:
+  case Op::REAL:
+  case Op::STR:
+  case Op::BOOL:
+    return;
+  case Op::VAR:
+    if (kind == READ)
+      pending.push_back(ir.a[n]);
+    return expr(ir.b[n]);
+  case Op::TEE:
+    if (kind == ASSIGNED)
+      pending.push_back(ir.a[n]);
+    return expr(ir.b[n]);
+  case Op::CALL:
+    for (size_t i = 0; i < ir.c[n]; i++) {
+      Ref arg = ir.begin(n)[i];
+      if (kind == ASSIGNED && ir.byReference(n, i))
+        pending.push_back(ir.a[arg]);
+      expr(arg);
+    }
+    return;
+  default:
+    expr(ir.a[n]);
+    if (isBinary(ir.op[n]))
+      expr(ir.b[n]);
+  }
+}
+
+void LoopVars::statement(Ref n) {
+  switch (ir.op[n]) {
+  case Op::BLOCK:
+    for (const Ref *s = ir.begin(n); s != ir.end(n); s++)
+      statement(*s);
+    break;
+  case Op::DECLARE:
+    if (kind == DECLARED)
+      pending.push_back(ir.a[n]);
+    expr(ir.b[n]);
+    break;
+  case Op::ASSIGN:
+    if (kind == ASSIGNED)
+      pending.push_back(ir.a[n]);
+    expr(ir.b[n]);
+    expr(ir.c[n]);
+    break;
+  case Op::READ:
+    for (const Ref *r = ir.begin(n); r != ir.end(n); r++) {
+      if (kind == ASSIGNED)
+        pending.push_back(ir.a[*r]);
+      expr(ir.b[*r]);
+    }
+    break;
+  case Op::CALL:
+    expr(n);
+    break;
+  case Op::WRITE:
+    for (const Ref *a = ir.begin(n); a != ir.end(n); a++)
+      expr(*a);
+    break;
+  case Op::IF:
+    expr(ir.a[n]);
+    statement(ir.b[n]);
+    if (ir.c[n] != NONE)
+      statement(ir.c[n]);
+    break;
+  case Op::WHILE: {
+    size_t mark = pending.size();
+    expr(ir.a[n]);
+    statement(ir.b[n]);
+    // keep each variable once, and pass the list on to enclosing loops
+    uint32_t first = vars.size();
+    for (size_t i = mark; i < pending.size(); i++)
+      if (stamp[pending[i]] != n) {
+        stamp[pending[i]] = n;
+        vars.push_back(pending[i]);
+      }
+    spans[n] = {first, (uint32_t)(vars.size() - first)};
+    pending.resize(mark);
+    pending.insert(pending.end(), vars.begin() + first, vars.end());
+    break;
+  }
+  default: // ASSERT and RETURN
+    expr(ir.a[n]);
+  }
+}
+
+} // namespace IR
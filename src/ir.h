@@ -0,0 +1,194 @@
+#ifndef IR_H_
+#define IR_H_
+
+#include "symbols.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace IR {
+
+// Index of a node in a Program, 0 is never a node
+using Ref = uint32_t;
+const Ref NONE = 0;
+
+#define IR_TYPES(F)                                                            \
+  F(VOID, "void")                                                              \
+  F(INTEGER, "integer")                                                        \
+  F(REAL, "real")                                                              \
+  F(STRING, "string")                                                          \
+  F(BOOLEAN, "Boolean")                                                        \
+  F(ERROR, "<error>")
+
+#define F(name, text) name,
+enum class Type : uint8_t { IR_TYPES(F) };
+#undef F
+
+// arrays are their element type with this bit set
+const uint8_t ARRAY_BIT = 0x80;
+inline Type arrayOf(Type t) { return Type((uint8_t)t | ARRAY_BIT); }
+inline bool isArray(Type t) { return (uint8_t)t & ARRAY_BIT; }
+inline Type elementOf(Type t) { return Type((uint8_t)t & ~ARRAY_BIT); }
+std::string typeName(Type t);
+
+// Node kinds. Every node has a type and three 32 bit operands a, b and c,
+// "list" means b is the first entry in Program::lists and c the count.
+#define IR_OPS(F)                                                              \
+  F(INT, "int")            /* a: value */                                      \
+  F(REAL, "real")          /* a: index in reals */                             \
+  F(STR, "str")            /* a: index in strings */                           \
+  F(BOOL, "bool")          /* a: 0 or 1 */                                     \
+  F(VAR, "var")            /* a: variable, b: index or NONE */                 \
+  F(TEE, "tee")            /* a: variable, b: value, stored and yielded */     \
+  F(SIZE, "size")          /* a: array */                                      \
+  F(NEG, "neg")            /* a: operand */                                    \
+  F(NOT, "not")            /* a: operand */                                    \
+  F(ADD, "add")            /* a, b: operands */                                \
+  F(SUB, "sub")                                                                \
+  F(MUL, "mul")                                                                \
+  F(DIV, "div")                                                                \
+  F(MOD, "mod")                                                                \
+  F(AND, "and")                                                                \
+  F(OR, "or")                                                                  \
+  F(EQ, "eq")                                                                  \
+  F(NEQ, "neq")                                                                \
+  F(LT, "lt")                                                                  \
+  F(LTE, "lte")                                                                \
+  F(GT, "gt")                                                                  \
+  F(GTE, "gte")                                                                \
+  F(CALL, "call")          /* a: function name, list: arguments */             \
+  F(DECLARE, "declare")    /* a: variable, b: array size or NONE */            \
+  F(ASSIGN, "assign")      /* a: variable, b: value, c: index or NONE */       \
+  F(READ, "read")          /* list: VAR nodes */                               \
+  F(WRITE, "write")        /* list: arguments */                               \
+  F(ASSERT, "assert")      /* a: condition */                                  \
+  F(RETURN, "return")      /* a: value or NONE */                              \
+  F(IF, "if")              /* a: condition, b: then, c: else or NONE */        \
+  F(WHILE, "while")        /* a: condition, b: body */                         \
+  F(BLOCK, "block")        /* list: statements */
+
+#define F(name, text) name,
+enum class Op : uint8_t { IR_OPS(F) };
+#undef F
+
+const char *opName(Op o);
+inline bool isBinary(Op o) { return o >= Op::ADD && o <= Op::GTE; }
+inline bool isComparison(Op o) { return o >= Op::EQ && o <= Op::GTE; }
+// true if integer DIV or MOD o of l by r traps: wasm traps on a zero
+// divisor, and i32.div_s on INT_MIN / -1
+inline bool traps(Op o, int32_t l, int32_t r) {
+  return r == 0 || (o == Op::DIV && l == INT32_MIN && r == -1);
+}
+
+struct Variable {
+  Symbols::Symbol name;
+  Type type;
+  // DECLARE node, the ASSIGN storing the first value of an inliner
+  // temporary, or NONE for parameters and other temporaries
+  Ref decl;
+};
+
+struct Function {
+  Symbols::Symbol name;
+  Type result;
+  std::vector<uint32_t> params; // variables
+  Ref body;
+  std::vector<bool> references; // by parameter, true for var parameters
+};
+
+struct Diagnostic {
+  Ref node;
+  std::string message;
+};
+
+// A lowered program. Nodes are stored column-wise. Lowering adds operands
+// before the node using them, so passes that only need operand results can
+// run over the columns from front to back until an optimization rewrites
+// nodes in place.
+class Program {
+public:
+  std::vector<Op> op;
+  std::vector<Type> type;
+  std::vector<uint32_t> a;
+  std::vector<uint32_t> b;
+  std::vector<uint32_t> c;
+  // source line of each statement, 0 for expressions and the statements
+  // optimizations add
+  std::vector<uint32_t> line;
+  std::vector<Ref> lists; // child sequences of BLOCK, CALL, READ and WRITE
+
+  // side tables for everything that is not a plain operand
+  std::vector<Variable> vars; // vars[0] stands for unresolved names
+  std::vector<Function> functions;
+  std::vector<double> reals;
+  std::vector<std::string> strings;
+  std::vector<Diagnostic> errors;
+  // array accesses, indexed VAR and ASSIGN nodes, whose index is known
+  // to be in range, so code for them needs no bounds check
+  std::unordered_set<Ref> inBounds;
+
+  Symbols::Symbol name = Symbols::NONE;
+  Ref main = NONE; // BLOCK of the main program
+
+  Program() { clear(); }
+  void clear();
+  size_t size() const { return op.size(); }
+
+  Ref add(Op o, Type t, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0);
+  // appends refs to lists and stores its position in n
+  void setList(Ref n, const std::vector<Ref> &refs);
+  const Ref *begin(Ref n) const { return lists.data() + b[n]; }
+  const Ref *end(Ref n) const { return lists.data() + b[n] + c[n]; }
+  uint32_t addVariable(Symbols::Symbol name, Type t, Ref decl);
+  // the array statement n of a block allocates, which the block owns and
+  // frees when it ends: one n declares, or a temporary n first copies an
+  // array into; 0 if there is none
+  uint32_t ownedArray(Ref n) const;
+  // nodes in the tree below n, n included
+  size_t count(Ref n) const;
+  // the function a CALL node calls, nullptr if there is none; programs have
+  // few functions, so this searches them
+  const Function *callee(Ref call) const;
+  // true if argument i of a CALL node is passed to a var parameter, which
+  // makes the call assign the variable passed
+  bool byReference(Ref call, size_t i) const;
+  // true if n may trap on some dividend: an integer DIV or MOD, see traps,
+  // unless its divisor is a literal it cannot trap on
+  bool canTrap(Ref n) const;
+  void error(Ref n, std::string message);
+};
+
+// The variables each while loop assigns, reads or declares anywhere inside
+// it. One walk over all bodies lists them for every loop, so nested loops
+// are not walked again for each loop around them.
+class LoopVars {
+public:
+  enum Kind { ASSIGNED, READ, DECLARED };
+
+  LoopVars(const Program &ir, Kind kind);
+  const uint32_t *begin(Ref loop) const {
+    return vars.data() + spans.at(loop).first;
+  }
+  const uint32_t *end(Ref loop) const {
+    auto &s = spans.at(loop);
+    return vars.data() + s.first + s.second;
+  }
+
+private:
+  const Program &ir;
+  Kind kind;
+  std::unordered_map<Ref, std::pair<uint32_t, uint32_t>> spans; // by loop
+  std::vector<uint32_t> vars;    // lists of all loops
+  std::vector<uint32_t> pending; // of the loops being walked
+  std::vector<Ref> stamp;        // by variable, last loop listing it
+
+  void expr(Ref n);
+  void statement(Ref n);
+};
+
+} // namespace IR
+
+#endif // IR_H_
@@ -0,0 +1,176 @@
+#include "locals.h"
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+namespace Locals {
+
+using IR::Op;
+using IR::Ref;
+using IR::Type;
+
+// Numbers the nodes of a body in evaluation order and records the first
+// and last position at which each variable is referenced.
+class Liveness {
+public:
+  const IR::Program &ir;
+  uint32_t pos = 0;
+  std::vector<uint32_t> start, end; // by variable, start 0 if never seen
+
+  explicit Liveness(const IR::Program &ir)
+      : ir(ir), start(ir.vars.size()), end(ir.vars.size()) {}
+
+  void node(Ref n) {
+    if (n == IR::NONE)
+      return;
+    switch (ir.op[n]) {
+    case Op::INT:
+    case Op::REAL:
+    case Op::STR:
+    case Op::BOOL:
+      break;
+    case Op::VAR:
+    case Op::TEE:
+      node(ir.b[n]);
+      use(ir.a[n]);
+      break;
+    case Op::DECLARE:
+      node(ir.b[n]);
+      start[ir.a[n]] = end[ir.a[n]] = ++pos;
+      break;
+    case Op::ASSIGN:
+      node(ir.b[n]);
+      node(ir.c[n]);
+      use(ir.a[n]);
+      break;
+    case Op::CALL:
+    case Op::READ:
+    case Op::WRITE:
+      for (const Ref *r = ir.begin(n); r != ir.end(n); r++)
+        node(*r);
+      break;
+    case Op::BLOCK: {
+      size_t mark = owned.size();
+      for (const Ref *r = ir.begin(n); r != ir.end(n); r++) {
+        node(*r);
+        if (uint32_t v = ir.ownedArray(*r))
+          owned.push_back(v);
+      }
+      // the generator frees the arrays a block owns as it ends
+      for (size_t i = mark; i < owned.size(); i++)
+        use(owned[i]);
+      owned.resize(mark);
+      break;
+    }
+    case Op::RETURN:
+      node(ir.a[n]);
+      // a return frees those of all blocks it leaves
+      for (uint32_t v : owned)
+        use(v);
+      break;
+    case Op::WHILE:
+      loops.push_back({pos + 1, {}});
+      node(ir.a[n]);
+      node(ir.b[n]);
+      pos++;
+      // live around the back edge, so until the loop is left
+      for (uint32_t v : loops.back().vars)
+        end[v] = pos;
+      loops.pop_back();
+      break;
+    default: // operators, SIZE, ASSERT and IF
+      node(ir.a[n]);
+      if (IR::isBinary(ir.op[n]) || ir.op[n] == Op::IF) {
+        node(ir.b[n]);
+        node(ir.c[n]);
+      }
+    }
+    pos++;
+  }
+
+private:
+  struct Loop {
+    uint32_t start;
+    std::vector<uint32_t> vars; // declared before the loop, used in it
+  };
+  std::vector<Loop> loops; // enclosing the current node, outermost first
+  std::vector<uint32_t> owned; // arrays of the enclosing blocks, see BLOCK
+
+  void use(uint32_t v) {
+    end[v] = ++pos;
+    // the declaration may have been removed as dead
+    if (!start[v])
+      start[v] = pos;
+    for (Loop &l : loops)
+      if (l.start > start[v]) {
+        l.vars.push_back(v);
+        break;
+      }
+  }
+};
+
+// slot classes
+enum { I32, F64, CLASSES };
+
+static int classOf(Type t) {
+  if (IR::isArray(t))
+    return I32;
+  switch (t) {
+  case Type::INTEGER:
+  case Type::BOOLEAN:
+  case Type::STRING:
+    return I32;
+  case Type::REAL:
+    return F64;
+  default:
+    return CLASSES;
+  }
+}
+
+Allocation allocate(const IR::Program &ir, Ref body,
+                    const std::vector<uint32_t> &params) {
+  Liveness live(ir);
+  live.node(body);
+
+  Allocation a;
+  a.slot.assign(ir.vars.size(), NO_SLOT);
+  for (uint32_t i = 0; i < params.size(); i++)
+    a.slot[params[i]] = i;
+
+  std::vector<uint32_t> order;
+  std::vector<uint8_t> cls(ir.vars.size());
+  for (uint32_t v = 1; v < ir.vars.size(); v++) {
+    cls[v] = classOf(ir.vars[v].type);
+    if (live.start[v] && cls[v] != CLASSES && a.slot[v] == NO_SLOT)
+      order.push_back(v);
+  }
+  std::sort(order.begin(), order.end(), [&](uint32_t x, uint32_t y) {
+    return live.start[x] < live.start[y];
+  });
+
+  // linear scan: a slot is free again once the range holding it has ended
+  std::vector<uint32_t> free[CLASSES];
+  using Active = std::pair<uint32_t, uint32_t>; // end, variable
+  std::priority_queue<Active, std::vector<Active>, std::greater<Active>>
+      active;
+  for (uint32_t v : order) {
+    while (!active.empty() && active.top().first < live.start[v]) {
+      uint32_t done = active.top().second;
+      free[cls[done]].push_back(a.slot[done]);
+      active.pop();
+    }
+    auto &slots = free[cls[v]];
+    if (!slots.empty()) {
+      a.slot[v] = slots.back();
+      slots.pop_back();
+    } else {
+      a.slot[v] = params.size() + a.locals.size();
+      a.locals.push_back(cls[v] == I32 ? Wasm::ValType::I32
+                                       : Wasm::ValType::F64);
+    }
+    active.push({live.end[v], v});
+  }
+  return a;
+}
+
+} // namespace Locals
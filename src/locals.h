@@ -0,0 +1,31 @@
+#ifndef LOCALS_H_
+#define LOCALS_H_
+
+#include "ir.h"
+#include "wasm.h"
+#include <cstdint>
+#include <vector>
+
+namespace Locals {
+
+const uint32_t NO_SLOT = ~0u;
+
+// Where the variables of one body live. Integers, Booleans, reals and the
+// addresses of strings and arrays get wasm locals, and variables whose
+// live ranges do not overlap share one.
+struct Allocation {
+  std::vector<uint32_t> slot;        // by variable, NO_SLOT if unallocated
+  std::vector<Wasm::ValType> locals; // type of each local slot
+};
+
+// Allocates the variables declared in body. A live range runs from the
+// declaration to the last use, widened to the whole loop when a variable
+// declared outside a loop is used inside it, and to the end of the block
+// for an array the block frees. Parameters keep the first
+// slots, in order, and are never shared.
+Allocation allocate(const IR::Program &ir, IR::Ref body,
+                    const std::vector<uint32_t> &params = {});
+
+} // namespace Locals
+
+#endif // LOCALS_H_
@@ -0,0 +1,417 @@
+#include "optimizer.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace Optimizer {
+
+using IR::Op;
+using IR::Ref;
+using IR::Type;
+
+// Rewrites while loop n in place into a block running before ahead of a
+// copy of the loop, which keeps the condition and body of n.
+static void prepend(IR::Program &ir, Ref n, std::vector<Ref> before) {
+  before.push_back(ir.add(Op::WHILE, ir.type[n], ir.a[n], ir.b[n], ir.c[n]));
+  ir.op[n] = Op::BLOCK;
+  ir.a[n] = 0;
+  ir.setList(n, before);
+}
+
+static Ref assign(IR::Program &ir, uint32_t var, Ref value) {
+  return ir.add(Op::ASSIGN, Type::VOID, var, value, IR::NONE);
+}
+
+static Ref variable(IR::Program &ir, uint32_t var) {
+  return ir.add(Op::VAR, ir.vars[var].type, var, IR::NONE);
+}
+
+// Statements are walked by index, since rewriting a loop into a block
+// appends to the lists and may move them.
+template <class F> static void eachStatement(IR::Program &ir, Ref n, F f) {
+  for (uint32_t i = 0; i < ir.c[n]; i++)
+    f(ir.lists[ir.b[n] + i]);
+}
+
+// Moves expressions no iteration of a loop changes in front of the
+// outermost loop they are invariant in. Only operators that cannot trap
+// move, since the loop may not run at all.
+class Hoister {
+public:
+  IR::Program &ir;
+  size_t hoisted = 0;
+
+  explicit Hoister(IR::Program &ir)
+      : ir(ir), assigned(ir, IR::LoopVars::ASSIGNED),
+        declared(ir, IR::LoopVars::DECLARED), level(ir.vars.size()) {}
+
+  void run() {
+    for (auto &f : ir.functions)
+      statement(f.body);
+    statement(ir.main);
+  }
+
+private:
+  IR::LoopVars assigned, declared;
+  // Depth of the innermost loop changing each variable, 0 outside loops.
+  // Changes are logged and undone when the loop is left.
+  std::vector<uint32_t> level;
+  std::vector<std::pair<uint32_t, uint32_t>> log; // variable, previous level
+  // statements to run ahead of each enclosing loop, outermost first
+  std::vector<std::vector<Ref>> loops;
+
+  uint32_t depth() const { return loops.size(); }
+
+  bool speculable(Ref n) const {
+    if (ir.type[ir.a[n]] == Type::STRING)
+      return false;
+    return !ir.canTrap(n);
+  }
+
+  // moves n in front of the loop at depth to + 1
+  void hoist(Ref n, uint32_t to) {
+    Op o = ir.op[n];
+    if (to >= depth() || (o != Op::NEG && o != Op::NOT && !IR::isBinary(o)))
+      return;
+    uint32_t temp = ir.addVariable(Symbols::NONE, ir.type[n], IR::NONE);
+    level.push_back(to);
+    Ref copy = ir.add(o, ir.type[n], ir.a[n], ir.b[n], ir.c[n]);
+    loops[to].push_back(assign(ir, temp, copy));
+    ir.op[n] = Op::VAR;
+    ir.a[n] = temp;
+    ir.b[n] = IR::NONE;
+    ir.c[n] = 0;
+    hoisted++;
+  }
+
+  // The depth of the innermost loop whose iterations may change the value
+  // of n. Operands invariant in more loops than n are hoisted.
+  uint32_t expr(Ref n) {
+    switch (ir.op[n]) {
+    case Op::INT:
+    case Op::REAL:
+    case Op::STR:
+    case Op::BOOL:
+      return 0;
+    case Op::VAR:
+      if (ir.b[n] == IR::NONE)
+        return level[ir.a[n]];
+      root(ir.b[n]);
+      return depth(); // array elements live in memory
+    case Op::TEE: // stores, so stays where it is
+      root(ir.b[n]);
+      return depth();
+    case Op::CALL:
+      for (uint32_t i = 0; i < ir.c[n]; i++)
+        root(ir.lists[ir.b[n] + i]);
+      return depth();
+    case Op::SIZE:
+      return depth();
+    default:
+      break;
+    }
+    Ref x = ir.a[n], y = IR::isBinary(ir.op[n]) ? ir.b[n] : IR::NONE;
+    uint32_t lx = expr(x), ly = y != IR::NONE ? expr(y) : 0;
+    uint32_t l = speculable(n) ? std::max(lx, ly) : depth();
+    if (lx < l)
+      hoist(x, lx);
+    if (y != IR::NONE && ly < l)
+      hoist(y, ly);
+    return l;
+  }
+
+  void root(Ref n) {
+    if (n == IR::NONE)
+      return;
+    uint32_t l = expr(n);
+    if (l < depth())
+      hoist(n, l);
+  }
+
+  void statement(Ref n) {
+    switch (ir.op[n]) {
+    case Op::BLOCK:
+      eachStatement(ir, n, [&](Ref s) { statement(s); });
+      break;
+    case Op::DECLARE:
+    case Op::ASSIGN:
+      root(ir.b[n]);
+      root(ir.c[n]);
+      break;
+    case Op::READ:
+      eachStatement(ir, n, [&](Ref r) { root(ir.b[r]); });
+      break;
+    case Op::CALL:
+    case Op::WRITE:
+      eachStatement(ir, n, [&](Ref a) { root(a); });
+      break;
+    case Op::IF:
+      root(ir.a[n]);
+      statement(ir.b[n]);
+      if (ir.c[n] != IR::NONE)
+        statement(ir.c[n]);
+      break;
+    case Op::WHILE:
+      loop(n);
+      break;
+    default: // ASSERT and RETURN
+      root(ir.a[n]);
+    }
+  }
+
+  void loop(Ref n) {
+    size_t mark = log.size();
+    uint32_t d = depth() + 1;
+    for (const IR::LoopVars *vars : {&assigned, &declared})
+      for (const uint32_t *v = vars->begin(n); v != vars->end(n); v++) {
+        log.push_back({*v, level[*v]});
+        level[*v] = d;
+      }
+    loops.emplace_back();
+    root(ir.a[n]);
+    statement(ir.b[n]);
+    std::vector<Ref> before = std::move(loops.back());
+    loops.pop_back();
+    for (; log.size() > mark; log.pop_back())
+      level[log.back().first] = log.back().second;
+    if (!before.empty())
+      prepend(ir, n, std::move(before));
+  }
+};
+
+size_t hoistInvariants(IR::Program &ir) {
+  Hoister h(ir);
+  h.run();
+  return h.hoisted;
+}
+
+// Replaces products of an induction variable and a constant in a loop by
+// a variable stepped along with it. An induction variable is assigned once
+// in the loop, by a statement of its body adding a constant to it.
+class StrengthReducer {
+public:
+  IR::Program &ir;
+  size_t reduced = 0;
+
+  explicit StrengthReducer(IR::Program &ir)
+      : ir(ir), writes(ir.vars.size()), stepped(ir.vars.size()) {}
+
+  void run() {
+    for (auto &f : ir.functions)
+      statement(f.body);
+    statement(ir.main);
+  }
+
+private:
+  struct Induction {
+    uint32_t var;
+    uint32_t step;
+    Ref update;
+    uint32_t writes;  // to var before the loop
+    uint32_t stepped; // previous loop stepping var
+  };
+  struct Product {
+    Ref node;
+    uint32_t var;
+    uint32_t factor;
+  };
+  struct Loop {
+    std::vector<Induction> inductions;
+    std::vector<Product> products;
+  };
+  std::vector<uint32_t> writes; // by variable, assignments walked
+  // by variable, depth of the innermost loop whose body steps it, 0 if none
+  std::vector<uint32_t> stepped;
+  std::vector<Loop> loops;
+
+  bool isVar(Ref n, uint32_t var) const {
+    return ir.op[n] == Op::VAR && ir.a[n] == var && ir.b[n] == IR::NONE;
+  }
+
+  // true if s is var := var + k, var := k + var or var := var - k
+  bool isStep(Ref s, uint32_t &step) const {
+    if (ir.op[s] != Op::ASSIGN || ir.c[s] != IR::NONE)
+      return false;
+    uint32_t var = ir.a[s];
+    Ref v = ir.b[s];
+    if (ir.vars[var].type != Type::INTEGER ||
+        (ir.op[v] != Op::ADD && ir.op[v] != Op::SUB))
+      return false;
+    Ref x = ir.a[v], y = ir.b[v];
+    if (isVar(x, var) && ir.op[y] == Op::INT) {
+      step = ir.op[v] == Op::ADD ? ir.a[y] : 0u - ir.a[y];
+      return true;
+    }
+    if (ir.op[v] == Op::ADD && ir.op[x] == Op::INT && isVar(y, var)) {
+      step = ir.a[x];
+      return true;
+    }
+    return false;
+  }
+
+  // records n if it multiplies a variable the innermost loop steps
+  bool product(Ref n) {
+    if (loops.empty() || ir.type[n] != Type::INTEGER)
+      return false;
+    Ref x = ir.a[n], y = ir.b[n];
+    if (ir.op[x] == Op::INT)
+      std::swap(x, y);
+    if (ir.op[x] != Op::VAR || ir.b[x] != IR::NONE || ir.op[y] != Op::INT ||
+        stepped[ir.a[x]] != depth())
+      return false;
+    loops.back().products.push_back({n, ir.a[x], ir.a[y]});
+    return true;
+  }
+
+  uint32_t depth() const { return loops.size(); }
+
+  void expr(Ref n) {
+    if (n == IR::NONE)
+      return;
+    switch (ir.op[n]) {
+    case Op::INT:
+    case Op::REAL:
+    case Op::STR:
+    case Op::BOOL:
+      return;
+    case Op::VAR:
+      return expr(ir.b[n]);
+    case Op::TEE:
+      writes[ir.a[n]]++;
+      return expr(ir.b[n]);
+    case Op::CALL:
+      for (uint32_t i = 0; i < ir.c[n]; i++) {
+        Ref a = ir.lists[ir.b[n] + i];
+        expr(a);
+        if (ir.byReference(n, i))
+          writes[ir.a[a]]++;
+      }
+      return;
+    case Op::MUL:
+      if (product(n))
+        return;
+      break;
+    default:
+      break;
+    }
+    expr(ir.a[n]);
+    if (IR::isBinary(ir.op[n]))
+      expr(ir.b[n]);
+  }
+
+  void statement(Ref n) {
+    switch (ir.op[n]) {
+    case Op::BLOCK:
+      eachStatement(ir, n, [&](Ref s) { statement(s); });
+      break;
+    case Op::DECLARE:
+      expr(ir.b[n]);
+      writes[ir.a[n]]++;
+      break;
+    case Op::ASSIGN:
+      expr(ir.b[n]);
+      expr(ir.c[n]);
+      if (ir.c[n] == IR::NONE)
+        writes[ir.a[n]]++;
+      break;
+    case Op::READ:
+      eachStatement(ir, n, [&](Ref r) {
+        expr(ir.b[r]);
+        if (ir.b[r] == IR::NONE)
+          writes[ir.a[r]]++;
+      });
+      break;
+    case Op::CALL:
+      expr(n);
+      break;
+    case Op::WRITE:
+      eachStatement(ir, n, [&](Ref a) { expr(a); });
+      break;
+    case Op::IF:
+      expr(ir.a[n]);
+      statement(ir.b[n]);
+      if (ir.c[n] != IR::NONE)
+        statement(ir.c[n]);
+      break;
+    case Op::WHILE:
+      loop(n);
+      break;
+    default: // ASSERT and RETURN
+      expr(ir.a[n]);
+    }
+  }
+
+  // the steps among the statements every iteration runs once
+  void candidates(Ref s) {
+    uint32_t step;
+    if (ir.op[s] == Op::BLOCK) {
+      eachStatement(ir, s, [&](Ref s) { candidates(s); });
+    } else if (isStep(s, step) && stepped[ir.a[s]] != depth()) {
+      uint32_t var = ir.a[s];
+      loops.back().inductions.push_back(
+          {var, step, s, writes[var], stepped[var]});
+      stepped[var] = depth();
+    }
+  }
+
+  void loop(Ref n) {
+    loops.emplace_back();
+    Ref body = ir.b[n];
+    candidates(body);
+    expr(ir.a[n]);
+    statement(body);
+    Loop l = std::move(loops.back());
+    loops.pop_back();
+    for (auto i = l.inductions.rbegin(); i != l.inductions.rend(); i++)
+      stepped[i->var] = i->stepped;
+    reduce(n, l);
+  }
+
+  // Each product of an induction variable and a factor gets a variable set
+  // ahead of the loop and stepped right after the induction variable.
+  void reduce(Ref n, const Loop &l) {
+    std::vector<Ref> before;
+    for (const Induction &i : l.inductions) {
+      if (writes[i.var] - i.writes != 1)
+        continue;
+      std::vector<Ref> update; // after the statement stepping i
+      std::vector<std::pair<uint32_t, uint32_t>> temps; // factor, variable
+      for (const Product &p : l.products) {
+        if (p.var != i.var)
+          continue;
+        auto t = std::find_if(temps.begin(), temps.end(),
+                              [&](auto &t) { return t.first == p.factor; });
+        if (t == temps.end()) {
+          uint32_t var = ir.addVariable(Symbols::NONE, Type::INTEGER, IR::NONE);
+          Ref init = ir.add(Op::MUL, Type::INTEGER, variable(ir, i.var),
+                            ir.add(Op::INT, Type::INTEGER, p.factor));
+          before.push_back(assign(ir, var, init));
+          Ref step = ir.add(Op::ADD, Type::INTEGER, variable(ir, var),
+                            ir.add(Op::INT, Type::INTEGER, i.step * p.factor));
+          update.push_back(assign(ir, var, step));
+          t = temps.insert(temps.end(), {p.factor, var});
+        }
+        ir.op[p.node] = Op::VAR;
+        ir.a[p.node] = t->second;
+        ir.b[p.node] = IR::NONE;
+        reduced++;
+      }
+      if (!update.empty()) {
+        update.insert(update.begin(), assign(ir, i.var, ir.b[i.update]));
+        ir.op[i.update] = Op::BLOCK;
+        ir.a[i.update] = 0;
+        ir.setList(i.update, update);
+      }
+    }
+    if (!before.empty())
+      prepend(ir, n, std::move(before));
+  }
+};
+
+size_t reduceStrength(IR::Program &ir) {
+  StrengthReducer r(ir);
+  r.run();
+  return r.reduced;
+}
+
+} // namespace Optimizer
@@ -1,60 +1,189 @@
+#include "batch.h"
 #include "compiler.h"
+#include "source.h"
 //#include "interpreter.h"
-#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 using namespace std;
 
-std::string read_file(string path) {
-  std::ifstream in(path, std::ios::in | std::ios::binary);
-  if (in) {
-    std::string contents;
-    in.seekg(0, std::ios::end);
-    contents.resize(in.tellg());
-    in.seekg(0, std::ios::beg);
-    in.read(&contents[0], contents.size());
-    in.close();
-    return (contents);
+static Compiler::Options options;
+
+// takes the compiler options out of argv, false if one is malformed
+static bool parseOptions(int &argc, char *argv[]) {
+  int kept = 1;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "--emit=wasm") {
+      options.emit = Compiler::Emit::WASM;
+    } else if (arg == "--emit=wat") {
+      options.emit = Compiler::Emit::WAT;
+    } else if (arg == "--host-math") {
+      options.hostMath = true;
+    } else if (arg == "--stats") {
+      options.stats = true;
+    } else if (arg == "--simd") {
+      options.simd = true;
+    } else if (arg == "--keep-bounds-checks") {
+      options.keepBoundsChecks = true;
+    } else if (arg == "-g") {
+      options.debugLines = true;
+    } else if (arg == "--inline-report") {
+      options.inlineReport = true;
+    } else if (arg.compare(0, 15, "--inline-limit=") == 0) {
+      char *end;
+      long limit = strtol(arg.c_str() + 15, &end, 10);
+      if (end == arg.c_str() + 15 || *end || limit < 0) {
+        cerr << "Bad inline limit: " << arg.substr(15) << endl;
+        return false;
+      }
+      options.inlineLimit = limit;
+    } else if (arg == "-O0" || arg == "-O1" || arg == "-O2") {
+      options.optimize = arg[2] - '0';
+    } else if (arg.compare(0, 7, "--emit=") == 0) {
+      cerr << "Unknown output format: " << arg.substr(7) << endl;
+      return false;
+    } else {
+      argv[kept++] = argv[i];
+    }
   }
-  throw(errno);
+  argc = kept;
+  return true;
 }
 
 static int compileFile(string path) {
-  string source;
+  Source::Buffer source;
   try {
-    source = read_file(path);
+    source.open(path);
   } catch (int e) {
     cerr << "Failed to read file: " << path << endl;
-    return errno;
+    return e;
+  }
+  Compiler::Session session(options);
+  bool ok = session.compile(source);
+  cerr << session.diagnostics() << session.statistics();
+  if (!ok)
+    return 1;
+  bool wat = options.emit == Compiler::Emit::WAT;
+  const char *outPath = wat ? "out.wat" : "out.wasm";
+  int fd = open(outPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  bool written = fd >= 0 && session.output().writeTo(fd);
+  if (fd >= 0)
+    close(fd);
+  if (!written) {
+    cerr << "Failed to write file: " << outPath << endl;
+    return 1;
   }
-  Compiler::compile(source);
-  return errno;
+  return 0;
 }
 
 static int runScanner(string path) {
-  string source;
+  Source::Buffer source;
+  try {
+    source.open(path);
+  } catch (int e) {
+    cerr << "Failed to read file: " << path << endl;
+    return e;
+  }
+  Compiler::runScanner(source.view());
+  return 0;
+}
+
+static int benchScanner(string path) {
+  Source::Buffer source;
+  try {
+    source.open(path);
+  } catch (int e) {
+    cerr << "Failed to read file: " << path << endl;
+    return e;
+  }
+  Compiler::benchScanner(source.view());
+  return 0;
+}
+
+static int benchParser(string path) {
+  Source::Buffer source;
+  try {
+    source.open(path);
+  } catch (int e) {
+    cerr << "Failed to read file: " << path << endl;
+    return e;
+  }
+  Compiler::benchParser(source.view());
+  return 0;
+}
+
+static int benchCompiler(string path) {
+  Source::Buffer source;
   try {
-    source = read_file(path);
+    source.open(path);
   } catch (int e) {
     cerr << "Failed to read file: " << path << endl;
-    return errno;
+    return e;
   }
-  Compiler::runScanner(source);
-  return errno;
+  Compiler::benchCompiler(source, options);
+  return 0;
 }
 
 static int runParser(string path) {
-  string source;
+  Source::Buffer source;
   try {
-    source = read_file(path);
+    source.open(path);
   } catch (int e) {
     cerr << "Failed to read file: " << path << endl;
-    return errno;
+    return e;
+  }
+  Compiler::runParser(source.view());
+  return 0;
+}
+
+// mini-pl [-j threads] [-o dir] (path | @manifest)...
+static int compileBatch(int argc, char *argv[]) {
+  int threads = thread::hardware_concurrency();
+  string outDir = ".";
+  vector<string> paths;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if ((arg == "-j" || arg == "-o") && i + 1 >= argc) {
+      cerr << "Missing value after " << arg << endl;
+      return 1;
+    }
+    if (arg == "-j") {
+      char *end;
+      long n = strtol(argv[++i], &end, 10);
+      if (end == argv[i] || *end || n < 1 || n > INT_MAX) {
+        cerr << "Bad thread count: " << argv[i] << endl;
+        return 1;
+      }
+      threads = n;
+    } else if (arg == "-o") {
+      outDir = argv[++i];
+    } else if (arg[0] == '@') {
+      try {
+        for (auto &p : Batch::readManifest(arg.substr(1)))
+          paths.push_back(p);
+      } catch (int e) {
+        cerr << "Failed to read manifest: " << arg.substr(1) << endl;
+        return e;
+      }
+    } else {
+      paths.push_back(arg);
+    }
   }
-  Compiler::runParser(source);
-  return errno;
+  Batch::Summary s = Batch::compileFiles(paths, outDir, threads, options);
+  printf("compiled %d files (%d failed) in %.3f s on %d threads\n", s.files,
+         s.failed, s.seconds, threads < 1 ? 1 : threads);
+  printf("%.0f files/sec, %.1f MB/sec\n", s.files / s.seconds,
+         s.bytes / s.seconds / 1e6);
+  return s.failed ? 1 : 0;
 }
 
 static void repl() {
@@ -74,10 +203,21 @@ static void printHelp() {
   cout << "\tmini-pl \n";
   cout << "\tmini-pl -h\n";
   cout << "\tmini-pl --help\n";
-  cout << "\tmini-pl [path]\n";
+  cout << "\tmini-pl [-O0|-O1|-O2] [-g] [--emit=wasm|wat] [--host-math] "
+          "[--stats] [--inline-limit=nodes] [--inline-report] "
+          "[--keep-bounds-checks] [--simd] [path]\n";
+  cout << "\tmini-pl [--emit=wasm|wat] [-j threads] [-o dir] "
+          "(path | @manifest)...\n";
+  cout << "\tmini-pl -s [path]\n";
+  cout << "\tmini-pl -p [path]\n";
+  cout << "\tmini-pl -bs [path]\n";
+  cout << "\tmini-pl -bp [path]\n";
+  cout << "\tmini-pl [--emit=wasm|wat] -bc [path]\n";
 }
 
 int main(int argc, char *argv[]) {
+  if (!parseOptions(argc, argv))
+    return 1;
   if (argc == 1)
     repl();
   else if (argc >= 2) {
@@ -89,10 +229,22 @@ int main(int argc, char *argv[]) {
     if (arg1.compare("-s") == 0) {
       string arg2 = argv[2];
       runScanner(arg2);
+    } else if (arg1.compare("-bs") == 0) {
+      string arg2 = argv[2];
+      benchScanner(arg2);
+    } else if (arg1.compare("-bp") == 0) {
+      string arg2 = argv[2];
+      benchParser(arg2);
+    } else if (arg1.compare("-bc") == 0) {
+      string arg2 = argv[2];
+      benchCompiler(arg2);
     } else if (arg1.compare("-p") == 0) {
       string arg2 = argv[2];
       runParser(arg2);
-    } else
+    } else if (arg1.compare("-j") == 0 || arg1.compare("-o") == 0 ||
+               arg1[0] == '@' || argc > 2)
+      return compileBatch(argc, argv);
+    else
       return compileFile(arg1);
   } else
   end:
@@ -0,0 +1,632 @@
+#include "optimizer.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace Optimizer {
+
+using IR::Op;
+using IR::Ref;
+using IR::Type;
+
+// longest string + may build, repeated doubling would exhaust memory
+static const size_t MAX_FOLDED_STRING = 1 << 12;
+
+static bool isConstant(Op o) {
+  return o == Op::INT || o == Op::REAL || o == Op::STR || o == Op::BOOL;
+}
+
+class Folder {
+public:
+  IR::Program &ir;
+  size_t folded = 0;
+
+  explicit Folder(IR::Program &ir)
+      : ir(ir), assigned(ir, IR::LoopVars::ASSIGNED), known(ir.vars.size()),
+        zeros() {}
+
+  void run() {
+    for (auto &f : ir.functions) {
+      statement(f.body);
+      undo(0);
+    }
+    statement(ir.main);
+  }
+
+private:
+  IR::LoopVars assigned;
+  // Literal node holding the value of each variable, NONE if unknown.
+  // Changes are logged so a branch can be undone, as in Symbols::Scopes.
+  std::vector<Ref> known;
+  std::vector<std::pair<uint32_t, Ref>> log; // variable, previous value
+  Ref zeros[(int)Type::ERROR + 1]; // literal a declaration stores, by type
+
+  void set(uint32_t var, Ref value) {
+    if (known[var] == value)
+      return;
+    log.push_back({var, known[var]});
+    known[var] = value;
+  }
+
+  void undo(size_t mark) {
+    for (; log.size() > mark; log.pop_back())
+      known[log.back().first] = log.back().second;
+  }
+
+  // variables changed since mark with their current values
+  std::vector<std::pair<uint32_t, Ref>> changes(size_t mark) const {
+    std::vector<std::pair<uint32_t, Ref>> c;
+    for (size_t i = mark; i < log.size(); i++)
+      c.push_back({log[i].first, known[log[i].first]});
+    return c;
+  }
+
+  bool isConstant(Ref n) const {
+    return n != IR::NONE && Optimizer::isConstant(ir.op[n]);
+  }
+
+  bool same(Ref x, Ref y) const {
+    if (x == y)
+      return true;
+    if (x == IR::NONE || y == IR::NONE || ir.op[x] != ir.op[y])
+      return false;
+    switch (ir.op[x]) {
+    case Op::REAL: // bitwise, so 0.0 and -0.0 differ and NaN is itself
+      return std::memcmp(&ir.reals[ir.a[x]], &ir.reals[ir.a[y]],
+                         sizeof(double)) == 0;
+    case Op::STR:
+      return ir.strings[ir.a[x]] == ir.strings[ir.a[y]];
+    default:
+      return ir.a[x] == ir.a[y];
+    }
+  }
+
+  // rewrites n into a literal
+  void replace(Ref n, Op o, uint32_t a) {
+    ir.op[n] = o;
+    ir.a[n] = a;
+    ir.b[n] = ir.c[n] = 0;
+    folded++;
+  }
+  void integer(Ref n, uint32_t v) { replace(n, Op::INT, v); }
+  void boolean(Ref n, bool v) { replace(n, Op::BOOL, v); }
+  void real(Ref n, double v) {
+    ir.reals.push_back(v);
+    replace(n, Op::REAL, ir.reals.size() - 1);
+  }
+  void string(Ref n, std::string s) {
+    ir.strings.push_back(std::move(s));
+    replace(n, Op::STR, ir.strings.size() - 1);
+  }
+
+  template <class T> bool compare(Op o, const T &l, const T &r) {
+    switch (o) {
+    case Op::EQ:
+      return l == r;
+    case Op::NEQ:
+      return l != r;
+    case Op::LT:
+      return l < r;
+    case Op::LTE:
+      return l <= r;
+    case Op::GT:
+      return l > r;
+    default:
+      return l >= r;
+    }
+  }
+
+  // Integers wrap around as i32 does. Division and % are left to run
+  // time where wasm traps, see IR::traps.
+  void integers(Ref n, int32_t l, int32_t r) {
+    Op o = ir.op[n];
+    uint32_t ul = l, ur = r;
+    switch (o) {
+    case Op::ADD:
+      return integer(n, ul + ur);
+    case Op::SUB:
+      return integer(n, ul - ur);
+    case Op::MUL:
+      return integer(n, ul * ur);
+    case Op::DIV:
+      if (IR::traps(o, l, r))
+        return;
+      return integer(n, l / r);
+    case Op::MOD:
+      if (IR::traps(o, l, r))
+        return;
+      return integer(n, r == -1 ? 0 : l % r);
+    default:
+      return boolean(n, compare(o, l, r));
+    }
+  }
+
+  void reals(Ref n, double l, double r) {
+    switch (ir.op[n]) {
+    case Op::ADD:
+      return real(n, l + r);
+    case Op::SUB:
+      return real(n, l - r);
+    case Op::MUL:
+      return real(n, l * r);
+    case Op::DIV:
+      return real(n, l / r);
+    default:
+      return boolean(n, compare(ir.op[n], l, r));
+    }
+  }
+
+  void booleans(Ref n, bool l, bool r) {
+    switch (ir.op[n]) {
+    case Op::AND:
+      return boolean(n, l && r);
+    case Op::OR:
+      return boolean(n, l || r);
+    default:
+      return boolean(n, compare(ir.op[n], l, r));
+    }
+  }
+
+  // + concatenates, comparisons are bytewise
+  void strings(Ref n, const std::string &l, const std::string &r) {
+    if (ir.op[n] == Op::ADD) {
+      if (l.size() + r.size() <= MAX_FOLDED_STRING)
+        string(n, l + r);
+      return;
+    }
+    boolean(n, compare(ir.op[n], l, r));
+  }
+
+  // arguments for var parameters stay variables, which the call assigns
+  void call(Ref n) {
+    for (size_t i = 0; i < ir.c[n]; i++)
+      if (!ir.byReference(n, i))
+        expr(ir.begin(n)[i]);
+    for (size_t i = 0; i < ir.c[n]; i++)
+      if (ir.byReference(n, i))
+        set(ir.a[ir.begin(n)[i]], IR::NONE);
+  }
+
+  void expr(Ref n) {
+    switch (ir.op[n]) {
+    case Op::INT:
+    case Op::REAL:
+    case Op::STR:
+    case Op::BOOL:
+      return;
+    case Op::VAR: {
+      if (ir.b[n] != IR::NONE)
+        return expr(ir.b[n]);
+      Ref k = known[ir.a[n]];
+      if (k != IR::NONE)
+        replace(n, ir.op[k], ir.a[k]);
+      return;
+    }
+    case Op::TEE:
+      expr(ir.b[n]);
+      set(ir.a[n], isConstant(ir.b[n]) ? ir.b[n] : IR::NONE);
+      return;
+    case Op::CALL:
+      return call(n);
+    case Op::SIZE:
+      return expr(ir.a[n]);
+    case Op::NEG: {
+      Ref x = ir.a[n];
+      expr(x);
+      if (ir.op[x] == Op::INT)
+        integer(n, 0u - ir.a[x]);
+      else if (ir.op[x] == Op::REAL)
+        real(n, -ir.reals[ir.a[x]]);
+      return;
+    }
+    case Op::NOT:
+      expr(ir.a[n]);
+      if (ir.op[ir.a[n]] == Op::BOOL)
+        boolean(n, !ir.a[ir.a[n]]);
+      return;
+    default:
+      break;
+    }
+    Ref x = ir.a[n], y = ir.b[n];
+    expr(x);
+    expr(y);
+    if (!isConstant(x) || !isConstant(y))
+      return;
+    switch (ir.op[x]) {
+    case Op::INT:
+      return integers(n, ir.a[x], ir.a[y]);
+    case Op::REAL:
+      return reals(n, ir.reals[ir.a[x]], ir.reals[ir.a[y]]);
+    case Op::BOOL:
+      return booleans(n, ir.a[x], ir.a[y]);
+    default:
+      return strings(n, ir.strings[ir.a[x]], ir.strings[ir.a[y]]);
+    }
+  }
+
+  // the literal a declaration stores, NONE for arrays
+  Ref zero(Type t) {
+    if (IR::isArray(t))
+      return IR::NONE;
+    Ref &z = zeros[(int)t];
+    if (z != IR::NONE)
+      return z;
+    switch (t) {
+    case Type::INTEGER:
+      z = ir.add(Op::INT, t, 0);
+      break;
+    case Type::BOOLEAN:
+      z = ir.add(Op::BOOL, t, 0);
+      break;
+    case Type::REAL:
+      ir.reals.push_back(0);
+      z = ir.add(Op::REAL, t, ir.reals.size() - 1);
+      break;
+    case Type::STRING:
+      ir.strings.push_back("");
+      z = ir.add(Op::STR, t, ir.strings.size() - 1);
+      break;
+    default:
+      return IR::NONE;
+    }
+    return z;
+  }
+
+  void branches(Ref n) {
+    Ref cond = ir.a[n], then = ir.b[n], otherwise = ir.c[n];
+    size_t mark = log.size();
+    // only the branch taken shapes what is known after a constant if
+    if (ir.op[cond] == Op::BOOL) {
+      Ref dead = ir.a[cond] ? otherwise : then;
+      if (dead != IR::NONE) {
+        statement(dead);
+        undo(mark);
+      }
+      statement(ir.a[cond] ? then : otherwise);
+      return;
+    }
+    statement(then);
+    auto thenEnd = changes(mark);
+    undo(mark);
+    if (otherwise != IR::NONE)
+      statement(otherwise);
+    // a variable keeps a value only if both branches leave it the same
+    std::vector<std::pair<uint32_t, Ref>> merged;
+    for (auto &[var, value] : changes(mark))
+      merged.push_back({var, IR::NONE});
+    for (auto &[var, value] : thenEnd)
+      merged.push_back({var, same(value, known[var]) ? value : IR::NONE});
+    undo(mark);
+    for (auto &[var, value] : merged)
+      set(var, value);
+  }
+
+  void statement(Ref n) {
+    if (n == IR::NONE)
+      return;
+    switch (ir.op[n]) {
+    case Op::BLOCK:
+      for (const Ref *s = ir.begin(n); s != ir.end(n); s++)
+        statement(*s);
+      break;
+    case Op::DECLARE:
+      if (ir.b[n] != IR::NONE)
+        expr(ir.b[n]);
+      set(ir.a[n], zero(ir.vars[ir.a[n]].type));
+      break;
+    case Op::ASSIGN: {
+      Ref value = ir.b[n];
+      expr(value);
+      if (ir.c[n] != IR::NONE)
+        expr(ir.c[n]);
+      else
+        set(ir.a[n], isConstant(value) ? value : IR::NONE);
+      break;
+    }
+    case Op::READ:
+      for (const Ref *r = ir.begin(n); r != ir.end(n); r++) {
+        if (ir.b[*r] != IR::NONE)
+          expr(ir.b[*r]);
+        set(ir.a[*r], IR::NONE);
+      }
+      break;
+    case Op::CALL:
+      call(n);
+      break;
+    case Op::WRITE:
+      for (const Ref *a = ir.begin(n); a != ir.end(n); a++)
+        expr(*a);
+      break;
+    case Op::ASSERT:
+      expr(ir.a[n]);
+      break;
+    case Op::RETURN:
+      if (ir.a[n] != IR::NONE)
+        expr(ir.a[n]);
+      break;
+    case Op::IF:
+      expr(ir.a[n]);
+      branches(n);
+      break;
+    case Op::WHILE: {
+      // the body may run any number of times, including none
+      for (const uint32_t *v = assigned.begin(n); v != assigned.end(n); v++)
+        set(*v, IR::NONE);
+      size_t mark = log.size();
+      expr(ir.a[n]);
+      statement(ir.b[n]);
+      undo(mark);
+      break;
+    }
+    default:
+      break;
+    }
+  }
+};
+
+size_t fold(IR::Program &ir) {
+  Folder f(ir);
+  f.run();
+  return f.folded;
+}
+
+// Removes dead statements walking each body backwards with the set of
+// variables whose value may still be read.
+class DeadCode {
+public:
+  IR::Program &ir;
+  size_t removed = 0;
+
+  explicit DeadCode(IR::Program &ir)
+      : ir(ir), read(ir, IR::LoopVars::READ) {}
+
+  void run() {
+    for (auto &f : ir.functions) {
+      outputs.clear();
+      for (size_t i = 0; i < f.params.size(); i++)
+        if (f.references[i])
+          outputs.push_back(f.params[i]);
+      body(f.body);
+    }
+    outputs.clear();
+    body(ir.main);
+  }
+
+private:
+  using Live = std::vector<bool>; // by variable
+  IR::LoopVars read;
+  std::vector<uint32_t> outputs; // var parameters, read by the caller
+
+  void body(Ref n) {
+    Live live(ir.vars.size());
+    exit(live);
+    statement(n, live);
+  }
+
+  // live when the body returns
+  void exit(Live &live) const {
+    live.assign(live.size(), false);
+    for (uint32_t v : outputs)
+      live[v] = true;
+  }
+
+  // true if evaluating n has no effect and cannot trap, so a value never
+  // read need not be computed: calls may have effects, and an element out
+  // of range or an integer division traps
+  bool pure(Ref n) const {
+    if (n == IR::NONE)
+      return true;
+    switch (ir.op[n]) {
+    case Op::INT:
+    case Op::REAL:
+    case Op::STR:
+    case Op::BOOL:
+      return true;
+    case Op::VAR:
+      return ir.b[n] == IR::NONE;
+    case Op::TEE:
+      return pure(ir.b[n]);
+    case Op::CALL:
+      return false;
+    default:
+      if (ir.canTrap(n))
+        return false;
+      return pure(ir.a[n]) && (!IR::isBinary(ir.op[n]) || pure(ir.b[n]));
+    }
+  }
+
+  // marks the variables expression n reads
+  void uses(Ref n, Live &live) const {
+    if (n == IR::NONE)
+      return;
+    switch (ir.op[n]) {
+    case Op::INT:
+    case Op::REAL:
+    case Op::STR:
+    case Op::BOOL:
+      return;
+    case Op::VAR:
+      live[ir.a[n]] = true;
+      return uses(ir.b[n], live);
+    case Op::TEE: // the temporary is read after it, so stays live
+      return uses(ir.b[n], live);
+    case Op::CALL:
+      for (const Ref *r = ir.begin(n); r != ir.end(n); r++)
+        uses(*r, live);
+      return;
+    default:
+      uses(ir.a[n], live);
+      if (IR::isBinary(ir.op[n]))
+        uses(ir.b[n], live);
+    }
+  }
+
+  // true if control never continues after statement n
+  bool terminates(Ref n) const {
+    switch (ir.op[n]) {
+    case Op::RETURN:
+      return true;
+    case Op::BLOCK:
+      for (const Ref *s = ir.begin(n); s != ir.end(n); s++)
+        if (terminates(*s))
+          return true;
+      return false;
+    case Op::IF: {
+      Ref cond = ir.a[n], then = ir.b[n], otherwise = ir.c[n];
+      if (ir.op[cond] == Op::BOOL) {
+        Ref taken = ir.a[cond] ? then : otherwise;
+        return taken != IR::NONE && terminates(taken);
+      }
+      return otherwise != IR::NONE && terminates(then) &&
+             terminates(otherwise);
+    }
+    case Op::WHILE: // there is no break, only return leaves the loop
+      return ir.op[ir.a[n]] == Op::BOOL && ir.a[ir.a[n]];
+    default:
+      return false;
+    }
+  }
+
+  void block(Ref n, Live &live) {
+    Ref *first = ir.lists.data() + ir.b[n];
+    uint32_t size = ir.c[n];
+    for (uint32_t i = 0; i < size; i++)
+      if (terminates(first[i])) {
+        for (uint32_t j = i + 1; j < size; j++)
+          removed += ir.count(first[j]);
+        size = i + 1;
+        break;
+      }
+    // backwards, compacting the kept statements towards the end
+    uint32_t kept = size;
+    for (uint32_t i = size; i-- > 0;) {
+      Ref s = first[i];
+      if (!statement(s, live))
+        continue;
+      if (ir.op[s] == Op::BLOCK && ir.c[s] == 0)
+        removed++;
+      else
+        first[--kept] = s;
+    }
+    std::copy(first + kept, first + size, first);
+    ir.c[n] = size - kept;
+  }
+
+  // Updates live from after statement n to before it. Returns false if n
+  // is dead, otherwise n may have been rewritten into a simpler statement.
+  bool statement(Ref n, Live &live) {
+    switch (ir.op[n]) {
+    case Op::BLOCK:
+      block(n, live);
+      return true;
+    case Op::DECLARE: {
+      uint32_t var = ir.a[n];
+      if (IR::isArray(ir.vars[var].type)) {
+        uses(ir.b[n], live);
+        return true;
+      }
+      if (!live[var]) {
+        removed += ir.count(n);
+        return false;
+      }
+      live[var] = false;
+      return true;
+    }
+    case Op::ASSIGN: {
+      uint32_t var = ir.a[n];
+      if (ir.c[n] == IR::NONE) {
+        if (!live[var] && pure(ir.b[n])) {
+          removed += ir.count(n);
+          return false;
+        }
+        live[var] = false;
+      } else {
+        live[var] = true; // storing an element reads the array
+      }
+      uses(ir.b[n], live);
+      uses(ir.c[n], live);
+      return true;
+    }
+    case Op::READ:
+      for (const Ref *r = ir.begin(n); r != ir.end(n); r++)
+        live[ir.a[*r]] = ir.b[*r] != IR::NONE;
+      for (const Ref *r = ir.begin(n); r != ir.end(n); r++)
+        uses(ir.b[*r], live);
+      return true;
+    case Op::RETURN: // nothing after it is observable
+      exit(live);
+      uses(ir.a[n], live);
+      return true;
+    case Op::IF:
+      return branches(n, live);
+    case Op::WHILE: {
+      if (ir.op[ir.a[n]] == Op::BOOL && !ir.a[ir.a[n]]) {
+        removed += ir.count(n);
+        return false;
+      }
+      // live at the head: after the loop or read anywhere in it, which is
+      // a fixed point of the body
+      for (const uint32_t *v = read.begin(n); v != read.end(n); v++)
+        live[*v] = true;
+      Live head = live;
+      statement(ir.b[n], head);
+      return true;
+    }
+    case Op::CALL:
+    case Op::WRITE:
+      for (const Ref *a = ir.begin(n); a != ir.end(n); a++)
+        uses(*a, live);
+      return true;
+    default: // ASSERT
+      uses(ir.a[n], live);
+      return true;
+    }
+  }
+
+  bool branches(Ref n, Live &live) {
+    Ref cond = ir.a[n], then = ir.b[n], otherwise = ir.c[n];
+    if (ir.op[cond] == Op::BOOL) {
+      // the if becomes the branch taken, or goes away
+      Ref taken = ir.a[cond] ? then : otherwise;
+      if (taken == IR::NONE) {
+        removed += ir.count(n);
+        return false;
+      }
+      // n takes over the list of the block taken
+      removed += ir.count(cond) + ir.count(ir.a[cond] ? otherwise : then) + 1;
+      statement(taken, live);
+      ir.op[n] = Op::BLOCK;
+      ir.a[n] = 0;
+      ir.b[n] = ir.b[taken];
+      ir.c[n] = ir.c[taken];
+      return true;
+    }
+    Live other = live;
+    statement(then, live);
+    if (otherwise != IR::NONE) {
+      statement(otherwise, other);
+      if (ir.c[otherwise] == 0) {
+        removed += ir.count(otherwise);
+        ir.c[n] = otherwise = IR::NONE;
+      }
+    }
+    for (size_t v = 0; v < live.size(); v++)
+      if (other[v])
+        live[v] = true;
+    if (otherwise == IR::NONE && ir.c[then] == 0 && pure(cond)) {
+      removed += ir.count(n);
+      return false;
+    }
+    uses(cond, live);
+    return true;
+  }
+};
+
+size_t eliminateDeadCode(IR::Program &ir) {
+  DeadCode d(ir);
+  d.run();
+  return d.removed;
+}
+
+} // namespace Optimizer
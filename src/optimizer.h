@@ -0,0 +1,69 @@
+#ifndef OPTIMIZER_H_
+#define OPTIMIZER_H_
+
+#include "ir.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace Optimizer {
+
+// What inlining did with the calls of one function
+struct Inlined {
+  uint32_t function; // index in functions
+  size_t size;       // nodes in its body, after inlining into it
+  size_t calls;      // call sites in the program
+  size_t inlined;    // of those calls
+  std::string kept;  // why the others were kept, empty if none were
+};
+
+// Replaces calls by a copy of the function called: a procedure call by
+// the statements of the body, a function call by the expression of a body
+// that is a single return. Functions that call themselves, directly or
+// not, are never copied, nor bodies of more than limit nodes. Below the
+// limit a call is copied if it is the only one, or if the body is not much
+// bigger than the call, counting calls in loops as made many times.
+// Callees are done before their callers, so a copy is already inlined.
+// Returns the number of calls replaced, and one entry for each function
+// called in report if it is given.
+size_t inlineCalls(IR::Program &ir, size_t limit,
+                   std::vector<Inlined> *report = nullptr);
+
+// Folds operators whose operands are constants and replaces uses of
+// variables known to hold a constant, rewriting nodes in place into
+// literals. Knowledge flows through straight-line code and both branches
+// of an if; a while forgets the variables its body assigns. Runs on a type
+// checked program and returns the number of nodes rewritten.
+size_t fold(IR::Program &ir);
+
+// Removes statements that cannot run or whose effect is never seen: code
+// after a return or an endless loop, the branch an if with a constant
+// condition does not take, while loops that never run, and declarations
+// and assignments of values that are never read. Values that may have
+// effects or trap, such as calls and integer divisions, are kept. Returns
+// the number of nodes removed.
+size_t eliminateDeadCode(IR::Program &ir);
+
+// Moves operators whose operands no iteration of a while loop changes in
+// front of the outermost such loop, into a temporary the loop reads.
+// Division and % only move with a constant divisor they cannot trap on.
+// Returns the number of expressions moved.
+size_t hoistInvariants(IR::Program &ir);
+
+// Replaces i * k inside a while loop, where k is a constant and the body
+// steps i once by a constant c, by a temporary set to i * k ahead of the
+// loop and increased by c * k after each step. Integers wrap, so the two
+// always agree. Returns the number of products replaced.
+size_t reduceStrength(IR::Program &ir);
+
+// Proves array accesses in range, from the ranges integer variables hold
+// at them and from comparisons against .size that guard them, and adds
+// them to ir.inBounds so they are generated without a bounds check. A
+// variable stepped up or down in a while loop keeps the bound on the side
+// it moves away from. Gives up, proving nothing, on programs too large to
+// analyze quickly. Returns the number of accesses proved.
+size_t removeBoundsChecks(IR::Program &ir);
+
+} // namespace Optimizer
+
+#endif // OPTIMIZER_H_
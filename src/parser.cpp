@@ -13,146 +13,184 @@
 
 namespace Parser {
 
-struct ParserState {
-  Scanner::Token *current;
-  Scanner::Token *previous;
+// Recursive descent parser state for one parse; parses share nothing, so
+// several can run at once
+class ParserState {
+public:
+  Scanner::Scanner scanner;
+  Scanner::Token current;
+  Scanner::Token previous;
   bool hadError = false;
   bool panicMode = false;
+  std::string &diagnostics;
+  Memory::Arena &arena;
+
+  ParserState(std::string &diagnostics, Memory::Arena &arena)
+      : diagnostics(diagnostics), arena(arena) {}
+
+  std::string_view readCurrent();
+  std::string_view readPrevious();
+  bool isPrevious(Scanner::TokenType t);
+  bool isCurrent(Scanner::TokenType t);
+  void errorAt(const Scanner::Token &t, const char *msg);
+  void advance();
+  bool consume(Scanner::TokenType type, const char *msg);
+  void exitPanic();
+  bool isSign();
+  bool isLiteral();
+  bool isRelational();
+  bool isAdding();
+  bool isMultiplying();
+  Memory::List<std::pair<MultiplyingOperator *, Factor *>> factors();
+  Term *term();
+  Memory::List<std::pair<AddingOperator *, Term *>> terms();
+  SimpleExpr *simpleExpression();
+  Expr *expression();
+  Variable *variable(Symbols::Symbol s);
+  Factor *primary();
+  Factor *factor();
+  Variable *variable();
+  Memory::List<Expr *> arguments();
+  Write *write();
+  Read *read();
+  Assign *assign(Symbols::Symbol id);
+  Call *call(Symbols::Symbol id);
+  Return *return_();
+  Assert *assert();
+  SimpleStatement *simpleStatement();
+  VarDecl *varDecl();
+  If *if_();
+  While *while_();
+  Statement *statement();
+  Block *block();
+  Parameter *parameter();
+  Type *type();
+  Type *voidType();
+  Memory::List<Parameter *> parameters();
+  Function *function();
+  Memory::List<Function *> functions();
+  Program *program();
 };
 
-ParserState parser;
-
-Program *prog;
-
-static std::string readCurrent() {
-  std::string c(parser.current->start, parser.current->length);
-  return c;
-}
-
-static std::string readPrevious() {
-  std::string c(parser.previous->start, parser.previous->length);
-  return c;
-}
-
-static void print(Scanner::Token *t) {
-  fprintf(stderr, "'%.*s'", t->length, t->start);
+std::string_view ParserState::readCurrent() {
+  return std::string_view(current.start, current.length);
 }
 
-static void printCurrent(std::string msg) {
-  std::cout << msg << Scanner::getName(parser.current) << std::endl;
+std::string_view ParserState::readPrevious() {
+  return std::string_view(previous.start, previous.length);
 }
 
-static bool isPrevious(Scanner::TokenType t) {
-  return parser.previous->type == t;
+bool ParserState::isPrevious(Scanner::TokenType t) {
+  return previous.type == t;
 }
 
-static bool isCurrent(Scanner::TokenType t) {
-  return parser.current->type == t;
+bool ParserState::isCurrent(Scanner::TokenType t) {
+  return current.type == t;
 }
 
-static void errorAt(Scanner::Token *t, std::string msg) {
-  if (parser.panicMode)
+void ParserState::errorAt(const Scanner::Token &t, const char *msg) {
+  if (panicMode)
     return;
-  parser.panicMode = true;
-  fprintf(stderr, "[line %d] Error", t->line);
+  panicMode = true;
+  diagnostics += "[line " + std::to_string(t.line) + "] Error";
 
-  if (t->type == Scanner::TokenType::SCAN_EOF) {
-    fprintf(stderr, " at end");
-  } else if (t->type == Scanner::TokenType::SCAN_ERROR) {
-    fprintf(stderr, " %s", t->message);
+  if (t.type == Scanner::TokenType::SCAN_EOF) {
+    diagnostics += " at end";
+  } else if (t.type == Scanner::TokenType::SCAN_ERROR) {
+    diagnostics += " " + std::string(t.message);
   } else {
-    fprintf(stderr, " at '%.*s'", t->length, t->start);
+    diagnostics += " at '" + std::string(t.start, t.length) + "'";
   }
 
-  fprintf(stderr, ": %s\n", msg.c_str());
-  parser.hadError = true;
+  diagnostics += std::string(": ") + msg + "\n";
+  hadError = true;
 }
 
-static void advance() {
-  parser.previous = parser.current;
+void ParserState::advance() {
+  previous = current;
   for (;;) {
-    parser.current = Scanner::scanToken();
+    current = scanner.scanToken();
+    // comments may appear between any two tokens
+    if (isCurrent(Scanner::TokenType::COMMENT))
+      continue;
     if (!isCurrent(Scanner::TokenType::SCAN_ERROR))
       break;
-    errorAt(parser.current, "Scanner error");
+    errorAt(current, "Scanner error");
   }
 }
 
-static bool consume(Scanner::TokenType type, std::string msg) {
-  if (parser.current->type == type) {
+bool ParserState::consume(Scanner::TokenType type, const char *msg) {
+  if (current.type == type) {
     advance();
     return true;
   }
-  errorAt(parser.current, msg);
+  errorAt(current, msg);
   return false;
 }
 
-static void exitPanic() {
+void ParserState::exitPanic() {
   while (!isCurrent(Scanner::TokenType::SEMICOLON)) {
     if (isCurrent(Scanner::TokenType::SCAN_EOF))
       break;
-    std::cout << "Skipping token:" << Scanner::getName(parser.current)
-              << std::endl;
     advance();
   }
   advance();
-  parser.panicMode = false;
+  panicMode = false;
 }
 
-static bool isSign() { return isCurrent(T::PLUS) || isCurrent(T::MINUS); }
-static bool isLiteral() {
+bool ParserState::isSign() { return isCurrent(T::PLUS) || isCurrent(T::MINUS); }
+bool ParserState::isLiteral() {
   return isCurrent(T::INT_LIT) || isCurrent(T::REAL_LIT) ||
          isCurrent(T::STR_LIT);
 }
-static bool isRelational() {
+bool ParserState::isRelational() {
   return isCurrent(T::EQ) || isCurrent(T::NEQ) || isCurrent(T::LT) ||
          isCurrent(T::LTE) || isCurrent(T::GTE) || isCurrent(T::GT);
 }
-static bool isAdding() {
+bool ParserState::isAdding() {
   return isCurrent(T::PLUS) || isCurrent(T::MINUS) || isCurrent(T::OR);
 }
-static bool isMultiplying() {
+bool ParserState::isMultiplying() {
   return isCurrent(T::MUL) || isCurrent(T::DIV) || isCurrent(T::MOD) ||
          isCurrent(T::AND);
 }
 
-static Factor *factor();
-
-static std::list<std::pair<MultiplyingOperator *, Factor *>> factors() {
-  std::list<std::pair<MultiplyingOperator *, Factor *>> fs({});
+Memory::List<std::pair<MultiplyingOperator *, Factor *>>
+ParserState::factors() {
+  Memory::List<std::pair<MultiplyingOperator *, Factor *>> fs;
   // std::cout << "AA";
   while (isMultiplying()) {
-    MultiplyingOperator *mo = new MultiplyingOperator();
+    MultiplyingOperator *mo = arena.make<MultiplyingOperator>();
     mo->op = readCurrent();
     advance();
-    fs.push_back(std::make_pair(mo, factor()));
+    fs.push_back(arena, std::make_pair(mo, factor()));
   }
   return fs;
 }
 
-static Term *term() {
-  Term *t = new Term();
+Term *ParserState::term() {
+  Term *t = arena.make<Term>();
   // std::cout << "BB";
   t->factor = factor();
   t->factors = factors();
   return t;
 }
 
-static std::list<std::pair<AddingOperator *, Term *>> terms() {
-  std::list<std::pair<AddingOperator *, Term *>> ts({});
+Memory::List<std::pair<AddingOperator *, Term *>> ParserState::terms() {
+  Memory::List<std::pair<AddingOperator *, Term *>> ts;
   while (isAdding()) {
-    AddingOperator *ao = new AddingOperator();
+    AddingOperator *ao = arena.make<AddingOperator>();
     ao->op = readCurrent();
     advance();
     // std::cout << "BB";
     // ParserUtils::pprint(ao);
-    ts.push_back(std::make_pair(ao, term()));
+    ts.push_back(arena, std::make_pair(ao, term()));
   }
   return ts;
 }
 
-static SimpleExpr *simpleExpression() {
-  SimpleExpr *e = new SimpleExpr();
+SimpleExpr *ParserState::simpleExpression() {
+  SimpleExpr *e = arena.make<SimpleExpr>();
   if (isSign()) {
     advance();
     e->sign = readPrevious();
@@ -164,15 +202,15 @@ static SimpleExpr *simpleExpression() {
   return e;
 }
 
-static Expr *expression() {
-  Expr *e = new Expr();
+Expr *ParserState::expression() {
+  Expr *e = arena.make<Expr>();
   e->left = simpleExpression();
   // ParserUtils::pprint(e->left);
   // std::cout << "EP" << readPrevious() << std::endl;
   // std::cout << "EC" << readCurrent() << std::endl;
   if (isRelational()) {
     advance();
-    RelationalOperator *op = new RelationalOperator();
+    RelationalOperator *op = arena.make<RelationalOperator>();
     op->op = readPrevious();
     e->op = op;
     e->right = simpleExpression();
@@ -180,20 +218,18 @@ static Expr *expression() {
   return e;
 }
 
-static Variable *variable(std::string s) {
-  Variable *v = new Variable();
+Variable *ParserState::variable(Symbols::Symbol s) {
+  Variable *v = arena.make<Variable>();
   v->id = s;
   if (isCurrent(T::LEFT_BRACKET)) {
+    advance();
     v->index = expression();
     consume(T::RIGHT_BRACKET, "Expected ']' after index");
   }
   return v;
 }
 
-static std::list<Expr *> arguments();
-
-static Call *call(std::string s);
-static Factor *factor() {
+Factor *ParserState::primary() {
   // std::cout << "AA" << readPrevious() << std::endl;
   // std::cout << "BB" << readCurrent() << std::endl;
   //  ParserUtils::pprint(i);
@@ -205,20 +241,18 @@ static Factor *factor() {
   }
   if (isCurrent(T::ID)) {
     advance();
-    if (isCurrent(T::LEFT_PAREN)) {
-      Call *c = call(readPrevious());
-      consume(T::RIGHT_PAREN, "Expected ')' after function call");
-      return c;
-    }
-    return variable(readPrevious());
+    if (isCurrent(T::LEFT_PAREN))
+      return call(previous.symbol);
+    return variable(previous.symbol);
   }
   if (isCurrent(T::NOT)) {
-    Not *i = new Not();
+    advance();
+    Not *i = arena.make<Not>();
     i->factor = factor();
     return i;
   }
   if (isCurrent(T::INT_LIT)) {
-    IntegerLiteral *i = new IntegerLiteral();
+    IntegerLiteral *i = arena.make<IntegerLiteral>();
     i->value = readCurrent();
     // ParserUtils::pprint(i);
     // usleep(1000000);
@@ -227,55 +261,61 @@ static Factor *factor() {
     return i;
   }
   if (isCurrent(T::REAL_LIT)) {
-    RealLiteral *i = new RealLiteral();
+    RealLiteral *i = arena.make<RealLiteral>();
     i->value = readCurrent();
     advance();
     return i;
   }
   if (isCurrent(T::STR_LIT)) {
-    StringLiteral *i = new StringLiteral();
+    StringLiteral *i = arena.make<StringLiteral>();
     i->value = readCurrent();
     advance();
     return i;
   }
-  Size *i = new Size();
-  i->factor = factor();
-  consume(T::DOT, "Expected '.'");
-  advance();
-  if (!(readPrevious().compare("size") == 0))
-    errorAt(parser.previous, "Expected 'size' after '.'");
-  return i;
+  errorAt(current, "Expected expression");
+  return arena.make<IntegerLiteral>();
+}
+
+Factor *ParserState::factor() {
+  Factor *f = primary();
+  while (isCurrent(T::DOT)) {
+    advance();
+    Size *i = arena.make<Size>();
+    i->factor = f;
+    consume(T::ID, "Expected 'size' after '.'");
+    if (previous.symbol != Symbols::SIZE)
+      errorAt(previous, "Expected 'size' after '.'");
+    f = i;
+  }
+  return f;
 }
 
-static Variable *variable() {
-  Variable *v = new Variable();
+Variable *ParserState::variable() {
+  Variable *v = arena.make<Variable>();
   consume(T::ID, "Expected ID");
-  v->id = readPrevious();
+  v->id = previous.symbol;
   if (isCurrent(T::LEFT_BRACKET)) {
+    advance();
     v->index = expression();
     consume(T::RIGHT_BRACKET, "Expected ']' after index");
   }
   return v;
 }
 
-static std::list<Expr *> arguments() {
-  std::list<Expr *> as;
+Memory::List<Expr *> ParserState::arguments() {
+  Memory::List<Expr *> as;
   if (isCurrent(T::RIGHT_PAREN))
     return as;
-  as.push_back(expression());
-  while (!isCurrent(T::RIGHT_PAREN)) {
-    if (parser.panicMode) {
-      exitPanic();
-      return as;
-    }
-    consume(T::COMMA, "Expected ',' between expressions");
-    as.push_back(expression());
+  as.push_back(arena, expression());
+  while (isCurrent(T::COMMA)) {
+    advance();
+    as.push_back(arena, expression());
   }
   return as;
 }
 
-static Write *write() {
-  Write *w = new Write();
+Write *ParserState::write() {
+  Write *w = arena.make<Write>();
   consume(T::ID, "Expected writeln");
   consume(T::LEFT_PAREN, "Expected '('");
   w->arguments = arguments();
@@ -283,66 +323,69 @@ static Write *write() {
   return w;
 }
 
-static Read *read() {
+Read *ParserState::read() {
   consume(T::ID, "Expected read");
   consume(T::LEFT_PAREN, "Expected '('");
-  Read *r = new Read();
-  r->variables.push_back(variable());
-  while (!isCurrent(T::RIGHT_PAREN)) {
-    if (parser.panicMode) {
-      exitPanic();
-      return r;
-    }
-    consume(T::COMMA, "Expected ','");
+  Read *r = arena.make<Read>();
+  r->variables.push_back(arena, variable());
+  while (isCurrent(T::COMMA)) {
+    advance();
+    r->variables.push_back(arena, variable());
   }
-  advance();
+  consume(T::RIGHT_PAREN, "Expected ')'");
   return r;
 }
 
-static Assign *assign(std::string id) {
-  consume(T::ASSIGN, "Expected :=");
-  Assign *a = new Assign();
+Assign *ParserState::assign(Symbols::Symbol id) {
+  Assign *a = arena.make<Assign>();
   a->id = id;
+  if (isCurrent(T::LEFT_BRACKET)) {
+    advance();
+    a->index = expression();
+    consume(T::RIGHT_BRACKET, "Expected ']' after index");
+  }
+  consume(T::ASSIGN, "Expected :=");
   a->expression = expression();
   return a;
 }
 
-static Call *call(std::string id) {
-  Call *c = new Call();
+Call *ParserState::call(Symbols::Symbol id) {
+  Call *c = arena.make<Call>();
   c->id = id;
   consume(T::LEFT_PAREN, "Expected '('");
   c->arguments = arguments();
   consume(T::RIGHT_PAREN, "Expected ')'");
   return c;
 }
-static Return *return_() {
+Return *ParserState::return_() {
   consume(T::RETURN, "Expected 'return'");
-  Return *r = new Return();
-  r->expression = expression();
+  Return *r = arena.make<Return>();
+  // the value is optional, procedures return none
+  if (!isCurrent(T::SEMICOLON) && !isCurrent(T::END) && !isCurrent(T::ELSE))
+    r->expression = expression();
   return r;
 }
-static Assert *assert() {
+Assert *ParserState::assert() {
   consume(T::ASSERT, "Expected 'return'");
   consume(T::LEFT_PAREN, "Expected '('");
-  Assert *a = new Assert();
+  Assert *a = arena.make<Assert>();
   a->expression = expression();
   consume(T::RIGHT_PAREN, "Expected ')'");
   return a;
 }
 
-static SimpleStatement *simpleStatement() {
+SimpleStatement *ParserState::simpleStatement() {
   if (isCurrent(T::ID)) {
-    std::string s = readCurrent();
-    if (s.compare("read") == 0)
+    if (current.symbol == Symbols::READ)
       return read();
-    if (s.compare("writeln") == 0)
+    if (current.symbol == Symbols::WRITELN)
       return write();
     advance();
     // std::cout << "P" << readPrevious() << std::endl;
     // std::cout << "C" << readCurrent() << std::endl;
-    if (isCurrent(T::ASSIGN))
-      return assign(readPrevious());
-    return call(readPrevious());
+    if (isCurrent(T::ASSIGN) || isCurrent(T::LEFT_BRACKET))
+      return assign(previous.symbol);
+    return call(previous.symbol);
   }
   if (isCurrent(T::RETURN)) {
     return return_();
@@ -350,37 +393,27 @@ static SimpleStatement *simpleStatement() {
   if (isCurrent(T::ASSERT)) {
     return assert();
   }
-  errorAt(parser.current, "Expected read,writeln,ID,return,assert");
-  return new SimpleStatement();
+  errorAt(current, "Expected read,writeln,ID,return,assert");
+  return arena.make<SimpleStatement>();
 }
 
-static Block *block();
-
-static Type *type();
-
-static VarDecl *varDecl() {
-  VarDecl *v = new VarDecl();
+VarDecl *ParserState::varDecl() {
+  VarDecl *v = arena.make<VarDecl>();
   advance();
   consume(T::ID, "Expected identifier");
-  v->ids.push_back(readPrevious());
-  while (!isCurrent(T::COLON)) {
-    if (parser.panicMode) {
-      exitPanic();
-      break;
-    }
-    consume(T::COMMA, "Expected ','");
+  v->ids.push_back(arena, previous.symbol);
+  while (isCurrent(T::COMMA)) {
+    advance();
     consume(T::ID, "Expected identifier");
-    v->ids.push_back(readPrevious());
+    v->ids.push_back(arena, previous.symbol);
   }
   consume(T::COLON, "Expected ':'");
   v->type = type();
   return v;
 }
 
-static Statement *statement();
-
-static If *if_() {
-  If *i = new If();
+If *ParserState::if_() {
+  If *i = arena.make<If>();
   consume(T::IF, "Expected 'if'");
   i->condition = expression();
   consume(T::THEN, "Expected 'then'");
@@ -392,9 +425,8 @@ static If *if_() {
   return i;
 }
 
-static While *while_() {
-  While *w = new While();
-  std::cout << readCurrent();
+While *ParserState::while_() {
+  While *w = arena.make<While>();
   consume(T::WHILE, "Expected 'while'");
   w->condition = expression();
   consume(T::DO, "Expected 'do'");
@@ -402,85 +434,96 @@ static While *while_() {
   return w;
 }
 
-static Statement *statement() {
-  if (isCurrent(T::COMMENT)) {
-    advance();
-    return statement();
-  }
-  if (isCurrent(T::VAR)) {
-    return varDecl();
-  }
-  if (isCurrent(T::IF)) {
-    return if_();
-  }
-  if (isCurrent(T::WHILE)) {
-    return while_();
-  }
-  if (isCurrent(T::BEGIN)) {
-    return block();
-  }
-  return simpleStatement();
-}
-
-static Block *block() {
-  Block *b = new Block();
+Statement *ParserState::statement() {
+  int line = current.line;
+  Statement *s;
+  if (isCurrent(T::VAR))
+    s = varDecl();
+  else if (isCurrent(T::IF))
+    s = if_();
+  else if (isCurrent(T::WHILE))
+    s = while_();
+  else if (isCurrent(T::BEGIN))
+    s = block();
+  else
+    s = simpleStatement();
+  s->line = line;
+  return s;
+}
+
+Block *ParserState::block() {
+  Block *b = arena.make<Block>();
   consume(T::BEGIN, "Expected 'begin'");
-  while (!isCurrent(T::END) && !isPrevious(T::END)) {
-    // if (isCurrent(T::SCAN_ERROR) || isCurrent(T::SCAN_EOF)) {
-    //   errorAt(parser.current, parser.current->message);
-    //   exitPanic();
-    //   break;
-    // }
-    b->statements.push_back(statement());
-    advance();
+  while (!isCurrent(T::END) && !isCurrent(T::SCAN_EOF)) {
+    b->statements.push_back(arena, statement());
+    if (panicMode) {
+      exitPanic();
+      continue;
+    }
+    // the last statement of a block may omit its ';'
+    if (!isCurrent(T::END))
+      consume(T::SEMICOLON, "Expected ';'");
   }
-  if (isCurrent(T::END))
-    advance();
+  consume(T::END, "Expected 'end'");
   return b;
 }
 
-static Parameter *parameter() {
-  consume(T::LEFT_PAREN, "Expected (");
-  Parameter *p = new Parameter();
+Parameter *ParserState::parameter() {
+  Parameter *p = arena.make<Parameter>();
+  if (isCurrent(T::VAR)) {
+    p->byReference = true;
+    advance();
+  }
+  consume(T::ID, "Expected identifier");
+  p->id = previous.symbol;
+  consume(T::COLON, "Expected ':'");
+  p->type = type();
   return p;
 }
 
-static Type *type() {
-  Type *t = new Type();
+Type *ParserState::type() {
+  Type *t = arena.make<Type>();
   if (isCurrent(T::ARRAY)) {
     t->isArray = true;
     advance();
     consume(T::LEFT_BRACKET, "Expected '['");
-    t->size = expression();
+    if (!isCurrent(T::RIGHT_BRACKET))
+      t->size = expression();
     consume(T::RIGHT_BRACKET, "Expected ']'");
+    consume(T::OF, "Expected 'of'");
   }
   consume(T::ID, "Expected identifier");
-  t->type = readPrevious();
+  t->type = previous.symbol;
   return t;
 }
 
-static Type *voidType() {
-  Type *t = new Type();
-  t->type = "void";
+Type *ParserState::voidType() {
+  Type *t = arena.make<Type>();
+  t->type = Symbols::VOID;
   return t;
 }
 
-static std::list<Parameter *> parameters() {
-  std::list<Parameter *> ps;
+Memory::List<Parameter *> ParserState::parameters() {
+  Memory::List<Parameter *> ps;
   consume(T::LEFT_PAREN, "Expected '('");
-  while (!isCurrent(T::RIGHT_PAREN)) {
-    ps.push_back(parameter());
+  if (!isCurrent(T::RIGHT_PAREN)) {
+    ps.push_back(arena, parameter());
+    while (isCurrent(T::COMMA)) {
+      advance();
+      ps.push_back(arena, parameter());
+    }
   }
+  consume(T::RIGHT_PAREN, "Expected ')'");
   return ps;
 }
 
-static Function *function() {
-  Function *f = new Function();
+Function *ParserState::function() {
+  Function *f = arena.make<Function>();
   f->returnType = voidType();
   if (isCurrent(T::FUNCTION)) {
     advance();
     consume(T::ID, "Expected identifier");
-    f->id = readPrevious();
+    f->id = previous.symbol;
     f->parameters = parameters();
     consume(T::COLON, "Expected ':'");
     f->returnType = type();
@@ -488,7 +531,7 @@ static Function *function() {
   if (isCurrent(T::PROCEDURE)) {
     advance();
     consume(T::ID, "Expected identifier");
-    f->id = readPrevious();
+    f->id = previous.symbol;
     f->parameters = parameters();
   }
   consume(T::SEMICOLON, "Expected ';'");
@@ -497,45 +540,48 @@ static Function *function() {
   return f;
 }
 
-static std::list<Function *> functions() {
-  std::list<Function *> fs;
-  if (isCurrent(T::FUNCTION) || isCurrent(T::PROCEDURE)) {
-    fs.push_back(function());
+Memory::List<Function *> ParserState::functions() {
+  Memory::List<Function *> fs;
+  while (isCurrent(T::FUNCTION) || isCurrent(T::PROCEDURE)) {
+    fs.push_back(arena, function());
   }
   return fs;
 }
 
-static Program *program() {
-  Program *p = new Program();
+Program *ParserState::program() {
+  Program *p = arena.make<Program>();
   for (;;) {
-    if (parser.panicMode) {
+    if (panicMode) {
       exitPanic();
       break;
     }
     // printCurrent("C:");
     // std::cout << std::endl;
-    if (isCurrent(T::COMMENT)) {
-      advance();
-      continue;
+    if (isCurrent(T::SCAN_EOF)) {
+      errorAt(current, "Expected 'program'");
+      break;
     }
     if (isCurrent(T::SCAN_ERROR)) {
-      errorAt(parser.current, parser.current->message);
+      errorAt(current, current.message);
       exitPanic();
       continue;
     }
     if (isCurrent(T::DOT)) {
       advance();
-      while (isCurrent(T::COMMENT))
-        advance();
       consume(T::SCAN_EOF, "Expected EOF after '.'");
       break;
     }
     if (consume(T::PROGRAM, "Expected 'program'")) {
       consume(T::ID, "Expected identifier");
-      p->id = readPrevious();
+      p->id = previous.symbol;
       consume(T::SEMICOLON, "Expected ';'");
       p->functions = functions();
       p->block = block();
+      // the test programs put a ';' between the main block and the '.'
+      if (isCurrent(T::SEMICOLON))
+        advance();
+      consume(T::DOT, "Expected '.'");
+      consume(T::SCAN_EOF, "Expected EOF after '.'");
       break;
     }
     exitPanic();
@@ -543,34 +589,37 @@ static Program *program() {
   return p;
 }
 
-bool parse(const std::string source) {
-  Scanner::init(source);
-  parser.hadError = false;
-  parser.panicMode = false;
-  advance();
-  prog = program();
-  ParserUtils::pprint(prog);
+bool parse(std::string_view source) {
+  std::string diagnostics;
+  Symbols::Interner interner;
+  Memory::Arena arena;
+  ParserState parser(diagnostics, arena);
+  parser.scanner.init(source, &interner);
+  parser.advance();
+  Program *prog = parser.program();
+  std::cerr << diagnostics;
+  ParserUtils::pprint(prog, interner);
   return !parser.hadError;
 }
 
-bool parse(const std::string source, Program **p) {
-  Scanner::init(source);
-  parser.hadError = false;
-  parser.panicMode = false;
-  advance();
-  Program *pr = program();
-  *p = pr;
-  // std::cout << *p << std::endl;
-  // ParserUtils::pprint(*p);
+bool parse(std::string_view source, Program **p, Symbols::Interner &interner,
+           Memory::Arena &arena, std::string &diagnostics) {
+  ParserState parser(diagnostics, arena);
+  parser.scanner.init(source, &interner);
+  parser.advance();
+  *p = parser.program();
   return !parser.hadError;
 }
 
-void parseAndWalk(const std::string source, TreeWalker *tw) {
-  Scanner::init(source);
-  parser.hadError = false;
-  parser.panicMode = false;
-  advance();
-  prog = program();
+void parseAndWalk(std::string_view source, TreeWalker *tw) {
+  std::string diagnostics;
+  Symbols::Interner interner;
+  Memory::Arena arena;
+  ParserState parser(diagnostics, arena);
+  parser.scanner.init(source, &interner);
+  parser.advance();
+  Program *prog = parser.program();
+  std::cerr << diagnostics;
   if (!parser.hadError)
     prog->accept(tw);
 }
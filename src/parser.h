@@ -1,9 +1,11 @@
 #ifndef PARSER_H_
 #define PARSER_H_
 
+#include "arena.h"
 #include "scanner.h"
-#include <list>
+#include "symbols.h"
 #include <string>
+#include <string_view>
 
 namespace Parser {
 
@@ -81,6 +83,7 @@ public:
 
 class Statement : public TreeNode {
 public:
+  int line = 0; // of the first token
   void accept(TreeWalker *t) override { t->visitStatement(this); };
 };
 
@@ -106,7 +109,7 @@ public:
 
 class VarDecl : public Statement {
 public:
-  std::list<std::string> ids;
+  Memory::List<Symbols::Symbol> ids;
   Type *type;
   void accept(TreeWalker *t) override { t->visitVarDecl(this); };
 };
@@ -135,7 +138,7 @@ public:
 
 class Variable : public Factor {
 public:
-  std::string id;
+  Symbols::Symbol id;
   Expr *index;
   void accept(TreeWalker *t) override { t->visitVariable(this); };
 };
@@ -147,51 +150,52 @@ public:
 
 class IntegerLiteral : public Literal {
 public:
-  std::string value;
+  std::string_view value;
   void accept(TreeWalker *t) override { t->visitIntegerLiteral(this); };
 };
 
 class RealLiteral : public Literal {
 public:
-  std::string value;
+  std::string_view value;
   void accept(TreeWalker *t) override { t->visitRealLiteral(this); };
 };
 
 class StringLiteral : public Literal {
 public:
-  std::string value;
+  std::string_view value;
   void accept(TreeWalker *t) override { t->visitStringLiteral(this); };
 };
 
 class Call : public Factor, public SimpleStatement {
 public:
-  std::string id;
-  std::list<Expr *> arguments;
-  void accept(TreeWalker *t) override { t->visitFactor(this); };
+  Symbols::Symbol id;
+  Memory::List<Expr *> arguments;
+  void accept(TreeWalker *t) override { t->visitCall(this); };
 };
 
 class Assign : public SimpleStatement {
 public:
-  std::string id;
+  Symbols::Symbol id;
+  Expr *index = nullptr; // of an array element
   Expr *expression;
   void accept(TreeWalker *t) override { t->visitAssign(this); };
 };
 
 class Return : public SimpleStatement {
 public:
-  Expr *expression;
+  Expr *expression = nullptr; // none in procedures
   void accept(TreeWalker *t) override { t->visitReturn(this); };
 };
 
 class Read : public SimpleStatement {
 public:
-  std::list<Variable *> variables;
+  Memory::List<Variable *> variables;
   void accept(TreeWalker *t) override { t->visitRead(this); };
 };
 
 class Write : public SimpleStatement {
 public:
-  std::list<Expr *> arguments;
+  Memory::List<Expr *> arguments;
   void accept(TreeWalker *t) override { t->visitWrite(this); };
 };
 
@@ -204,33 +208,33 @@ public:
 class Term : public TreeNode {
 public:
   Factor *factor;
-  std::list<std::pair<MultiplyingOperator *, Factor *>> factors;
+  Memory::List<std::pair<MultiplyingOperator *, Factor *>> factors;
   void accept(TreeWalker *t) override { t->visitTerm(this); };
 };
 
 class AddingOperator : public TreeNode {
 public:
-  std::string op;
+  std::string_view op;
   void accept(TreeWalker *t) override { t->visitAddingOperator(this); };
 };
 
 class MultiplyingOperator : public TreeNode {
 public:
-  std::string op;
+  std::string_view op;
   void accept(TreeWalker *t) override { t->visitMultiplyingOperator(this); };
 };
 
 class RelationalOperator : public TreeNode {
 public:
-  std::string op;
+  std::string_view op;
   void accept(TreeWalker *t) override { t->visitRelationalOperator(this); };
 };
 
 class SimpleExpr : public TreeNode {
 public:
-  std::string sign = "+";
+  std::string_view sign = "+";
   Term *term;
-  std::list<std::pair<AddingOperator *, Term *>> terms;
+  Memory::List<std::pair<AddingOperator *, Term *>> terms;
   void accept(TreeWalker *t) override { t->visitSimpleExpr(this); };
 };
 
@@ -244,46 +248,51 @@ public:
 
 class Type : public TreeNode {
 public:
-  std::string type;
+  Symbols::Symbol type;
   bool isArray;
-  Expr *size;
+  Expr *size; // null for parameters, which take arrays of any size
   void accept(TreeWalker *t) override { t->visitType(this); };
 };
 
 class Block : public StructuredStatement {
 public:
-  std::list<Statement *> statements;
+  Memory::List<Statement *> statements;
   void accept(TreeWalker *t) override { t->visitBlock(this); };
 };
 
 class Parameter : public TreeNode {
 public:
-  std::string id;
+  Symbols::Symbol id;
   Type *type;
+  bool byReference = false; // a var parameter
   void accept(TreeWalker *t) override { t->visitParameter(this); };
 };
 
 class Function : public TreeNode {
 public:
-  std::string id;
+  Symbols::Symbol id;
   Type *returnType;
-  std::list<Parameter *> parameters;
+  Memory::List<Parameter *> parameters;
   Block *block;
   void accept(TreeWalker *t) override { t->visitFunction(this); };
 };
 
 class Program : public TreeNode {
 public:
-  std::string id;
-  std::list<Function *> functions;
+  Symbols::Symbol id;
+  Memory::List<Function *> functions;
   Block *block;
   // void appendFunction(Function *f) { functions.push_back(f); }
   void accept(TreeWalker *t) override { t->visitProgram(this); };
 };
 
-bool parse(const std::string source);
-bool parse(const std::string source, Program **p);
-void parseAndWalk(const std::string source, TreeWalker *tw);
+bool parse(std::string_view source);
+// identifiers are interned into interner, parse errors are appended to
+// diagnostics. The tree is allocated in arena and its literal and operator
+// texts point into source, so it lives until either is released.
+bool parse(std::string_view source, Program **p, Symbols::Interner &interner,
+           Memory::Arena &arena, std::string &diagnostics);
+void parseAndWalk(std::string_view source, TreeWalker *tw);
 
 // Stmts *getProgram();
 
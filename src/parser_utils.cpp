@@ -4,8 +4,11 @@
 namespace ParserUtils {
 class PrintWalker : public Parser::TreeWalker {
 public:
+  const Symbols::Interner &names;
+  explicit PrintWalker(const Symbols::Interner &names) : names(names) {}
+
   void visitProgram(const Parser::Program *i) override {
-    std::cout << "(PROGRAM " << i->id;
+    std::cout << "(PROGRAM " << names.name(i->id);
     std::cout << std::endl << "(FUNCTIONS\n";
     for (Parser::TreeNode *n : i->functions) {
       n->accept(this);
@@ -17,16 +20,26 @@ public:
     std::cout << ")\n";
   }
   void visitFunction(const Parser::Function *i) override {
-    std::cout << "DUMMY";
+    std::cout << "(FUNCTION " << names.name(i->id) << " ";
+    for (auto p : i->parameters)
+      p->accept(this);
+    i->returnType->accept(this);
+    std::cout << "\n";
+    i->block->accept(this);
+    std::cout << ")\n";
   }
   void visitParameter(const Parser::Parameter *i) override {
-    std::cout << "DUMMY";
+    std::cout << "(PARAMETER " << (i->byReference ? "VAR " : "")
+              << names.name(i->id) << " ";
+    i->type->accept(this);
+    std::cout << ") ";
   }
   void visitType(const Parser::Type *i) override {
-    std::cout << "(TYPE " << i->type;
+    std::cout << "(TYPE " << names.name(i->type);
     if (i->isArray) {
       std::cout << " SIZE:";
-      i->size->accept(this);
+      if (i->size)
+        i->size->accept(this);
     }
     std::cout << ")";
   }
@@ -52,14 +65,19 @@ public:
   void visitVarDecl(const Parser::VarDecl *i) override {
     std::cout << "(DECLARE";
     for (auto s : i->ids)
-      std::cout << " " << s;
+      std::cout << " " << names.name(s);
     std::cout << " ";
     i->type->accept(this);
     std::cout << ")\n";
   }
 
   void visitAssign(const Parser::Assign *i) override {
-    std::cout << "(ASSIGN " << i->id << " ";
+    std::cout << "(ASSIGN " << names.name(i->id) << " ";
+    if (i->index) {
+      std::cout << "(INDEX ";
+      i->index->accept(this);
+      std::cout << ") ";
+    }
     i->expression->accept(this);
     std::cout << ")\n";
   }
@@ -122,7 +140,7 @@ public:
     std::cout << "MO" << i->op << " ";
   }
   void visitVariable(const Parser::Variable *i) override {
-    std::cout << "VAR:" << i->id << " ";
+    std::cout << "VAR:" << names.name(i->id) << " ";
   }
   void visitLiteral(const Parser::Literal *i) override { std::cout << "LIT"; }
   void visitIntegerLiteral(const Parser::IntegerLiteral *i) override {
@@ -136,9 +154,9 @@ public:
   }
 };
 
-void pprint(Parser::TreeNode *p) {
-  PrintWalker *pw = new PrintWalker();
-  p->accept(pw);
+void pprint(Parser::TreeNode *p, const Symbols::Interner &names) {
+  PrintWalker pw(names);
+  p->accept(&pw);
 }
 
 } // namespace ParserUtils
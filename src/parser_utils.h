@@ -6,7 +6,7 @@
 
 namespace ParserUtils {
 class PrintWalker;
-void pprint(Parser::TreeNode *p);
+void pprint(Parser::TreeNode *p, const Symbols::Interner &names);
 
 #endif // PARSER_UTILS_H_
 }
@@ -0,0 +1,196 @@
+#include "peephole.h"
+#include <iterator>
+#include <vector>
+
+namespace Peephole {
+
+using Wasm::Instr;
+using Wasm::Op;
+
+// The code rewritten so far and the constructs open at its end. Rules look
+// at the last instructions only and run after each one appended, so they
+// also match what earlier rewrites left.
+struct Tail {
+  std::vector<Instr> code;
+  std::vector<Op> open; // BLOCK, LOOP or IF of each enclosing construct
+
+  // the instruction k from the end, 1 being the last
+  Instr &at(size_t k) { return code[code.size() - k]; }
+  bool ends(Op x, Op y) {
+    return code.size() >= 2 && at(2).op == x && at(1).op == y;
+  }
+  // replaces the last k instructions by the last one
+  void keepLast(size_t k) {
+    code[code.size() - k] = code.back();
+    code.resize(code.size() - k + 1);
+  }
+};
+
+// i32.eqz of an i32 comparison as one comparison
+static Op inverse(Op o) {
+  switch (o) {
+  case Op::I32_EQ:
+    return Op::I32_NE;
+  case Op::I32_NE:
+    return Op::I32_EQ;
+  case Op::I32_LT_S:
+    return Op::I32_GE_S;
+  case Op::I32_LT_U:
+    return Op::I32_GE_U;
+  case Op::I32_GT_S:
+    return Op::I32_LE_S;
+  case Op::I32_GT_U:
+    return Op::I32_LE_U;
+  case Op::I32_LE_S:
+    return Op::I32_GT_S;
+  case Op::I32_LE_U:
+    return Op::I32_GT_U;
+  case Op::I32_GE_S:
+    return Op::I32_LT_S;
+  case Op::I32_GE_U:
+    return Op::I32_LT_U;
+  default:
+    return Op::NOP;
+  }
+}
+
+// leaves 0 or 1, which i32.eqz twice does not change
+static bool boolean(Op o) {
+  return (o >= Op::I32_EQZ && o <= Op::I32_GE_U) ||
+         (o >= Op::F64_EQ && o <= Op::F64_GE);
+}
+
+// local.set x; local.get x => local.tee x
+static bool tee(Tail &t) {
+  if (!t.ends(Op::LOCAL_SET, Op::LOCAL_GET) || t.at(2).a != t.at(1).a)
+    return false;
+  t.code.pop_back();
+  t.at(1).op = Op::LOCAL_TEE;
+  return true;
+}
+
+// local.tee x; drop => local.set x
+static bool teeDrop(Tail &t) {
+  if (!t.ends(Op::LOCAL_TEE, Op::DROP))
+    return false;
+  t.code.pop_back();
+  t.at(1).op = Op::LOCAL_SET;
+  return true;
+}
+
+// local.get x or a constant; drop =>
+static bool pureDrop(Tail &t) {
+  if (t.code.size() < 2 || t.at(1).op != Op::DROP)
+    return false;
+  Op o = t.at(2).op;
+  if (o != Op::LOCAL_GET && o != Op::I32_CONST && o != Op::F64_CONST)
+    return false;
+  t.code.resize(t.code.size() - 2);
+  return true;
+}
+
+// i32.const 0; i32.add, sub, or, xor or a shift =>
+// i32.const 1; i32.mul or a division =>
+static bool identity(Tail &t) {
+  if (t.code.size() < 2 || t.at(2).op != Op::I32_CONST)
+    return false;
+  Op o = t.at(1).op;
+  int64_t c = t.at(2).i;
+  bool zero = o == Op::I32_ADD || o == Op::I32_SUB || o == Op::I32_OR ||
+              o == Op::I32_XOR || o == Op::I32_SHL || o == Op::I32_SHR_S ||
+              o == Op::I32_SHR_U;
+  bool one = o == Op::I32_MUL || o == Op::I32_DIV_S || o == Op::I32_DIV_U;
+  if (!(zero && c == 0) && !(one && c == 1))
+    return false;
+  t.code.resize(t.code.size() - 2);
+  return true;
+}
+
+// i32.eqz; i32.eqz; br_if or if => br_if or if
+static bool eqzCondition(Tail &t) {
+  if (t.code.size() < 3 || t.at(3).op != Op::I32_EQZ ||
+      t.at(2).op != Op::I32_EQZ ||
+      (t.at(1).op != Op::BR_IF && t.at(1).op != Op::IF))
+    return false;
+  t.keepLast(3);
+  return true;
+}
+
+// a comparison; i32.eqz; i32.eqz => the comparison
+static bool eqzBoolean(Tail &t) {
+  if (t.code.size() < 3 || !boolean(t.at(3).op) ||
+      !t.ends(Op::I32_EQZ, Op::I32_EQZ))
+    return false;
+  t.code.resize(t.code.size() - 2);
+  return true;
+}
+
+// an i32 comparison; i32.eqz => the inverse comparison; reals have no
+// inverse, as a comparison with NaN is always false
+static bool invert(Tail &t) {
+  if (t.code.size() < 2 || t.at(1).op != Op::I32_EQZ ||
+      inverse(t.at(2).op) == Op::NOP)
+    return false;
+  t.code.pop_back();
+  t.at(1).op = inverse(t.at(1).op);
+  return true;
+}
+
+// br 0; end or else of a block or if => end or else, the branch going
+// where the code goes anyway
+static bool branchNext(Tail &t) {
+  if (t.code.size() < 2 || t.at(2).op != Op::BR || t.at(2).a != 0 ||
+      (t.at(1).op != Op::END && t.at(1).op != Op::ELSE) || t.open.empty() ||
+      t.open.back() == Op::LOOP)
+    return false;
+  t.keepLast(2);
+  return true;
+}
+
+// tried in order after each instruction, until none applies
+static bool (*const RULES[])(Tail &t) = {
+    tee,          teeDrop,    pureDrop, identity,
+    eqzCondition, eqzBoolean, invert,   branchNext,
+};
+
+static size_t rewrite(Wasm::Function &f) {
+  Tail t;
+  t.code.reserve(f.body.size());
+  // lines mark positions in t.code, which rewrites may pull back
+  size_t line = 0;
+  for (size_t k = 0; k < f.body.size(); k++) {
+    for (; line < f.lines.size() && f.lines[line].first == k; line++)
+      f.lines[line].first = t.code.size();
+    Op o = f.body[k].op;
+    t.code.push_back(f.body[k]);
+    for (size_t r = 0; r < std::size(RULES);)
+      r = RULES[r](t) ? 0 : r + 1;
+    for (size_t l = line; l-- > 0 && f.lines[l].first > t.code.size();)
+      f.lines[l].first = t.code.size();
+    if (o == Op::BLOCK || o == Op::LOOP || o == Op::IF)
+      t.open.push_back(o);
+    else if (o == Op::END)
+      t.open.pop_back();
+  }
+  // of lines pulled back onto one instruction, the last one holds
+  size_t kept = 0;
+  for (size_t l = 0; l < f.lines.size(); l++) {
+    if (kept && f.lines[kept - 1].first == f.lines[l].first)
+      kept--;
+    if (!kept || f.lines[kept - 1].second != f.lines[l].second)
+      f.lines[kept++] = f.lines[l];
+  }
+  f.lines.resize(kept);
+  size_t removed = f.body.size() - t.code.size();
+  f.body = std::move(t.code);
+  return removed;
+}
+
+size_t rewrite(Wasm::Module &m) {
+  size_t removed = 0;
+  for (Wasm::Function &f : m.functions)
+    removed += rewrite(f);
+  return removed;
+}
+
+} // namespace Peephole
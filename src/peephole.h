@@ -0,0 +1,23 @@
+#ifndef PEEPHOLE_H_
+#define PEEPHOLE_H_
+
+#include "wasm.h"
+#include <cstddef>
+
+namespace Peephole {
+
+// Rewrites short runs of instructions in the functions of m into fewer
+// ones that do the same, by the rules in peephole.cpp, such as
+//
+//   local.set $x         local.tee $x
+//   local.get $x    =>
+//
+// Rules see only straight-line code, which no branch enters in the
+// middle, so they need no analysis of the function. The source lines of
+// the functions stay on the code they mark. Returns the number of
+// instructions removed.
+size_t rewrite(Wasm::Module &m);
+
+} // namespace Peephole
+
+#endif // PEEPHOLE_H_
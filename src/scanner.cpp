@@ -1,6 +1,5 @@
 #include "scanner.h"
-#include <cstdlib>
-#include <cstring>
+#include "scanner_simd.h"
 #include <iostream>
 
 namespace Scanner {
@@ -9,125 +8,92 @@ namespace Scanner {
 std::string TokenName[]{TOKEN_TYPES(F)};
 #undef F
 
-struct Scanner {
-  char *src;
-  const char *start;
-  const char *current;
-  int line;
-};
-
-static Scanner scanner;
-
-void init(const std::string source) {
-  scanner.src = (char *)std::malloc(source.size() + 1);
-  std::memcpy(scanner.src, source.c_str(), source.size());
-  scanner.start = scanner.src;
-  scanner.current = scanner.src;
-  scanner.line = 1;
+void Scanner::init(std::string_view source, Symbols::Interner *interner) {
+  this->interner = interner;
+  start = source.data();
+  current = source.data();
+  line = 1;
+  simd = &kernels();
 }
 
-std::string getName(Token *t) { return TokenName[static_cast<int>(t->type)]; }
+std::string getName(const Token &t) {
+  return TokenName[static_cast<int>(t.type)];
+}
 std::string getName(TokenType t) { return TokenName[static_cast<int>(t)]; }
 
-static bool isEnd() { return *scanner.current == '\0'; }
+bool Scanner::isEnd() const { return *current == '\0'; }
 
-static Token *makeToken(TokenType type) {
-  Token *t = new Token();
-  t->type = type;
-  t->start = scanner.start;
-  t->length = (int)(scanner.current - scanner.start);
-  t->line = scanner.line;
-  t->message = "";
+// tokens are small PODs returned by value, scanning never touches the heap
+Token Scanner::makeToken(TokenType type) {
+  Token t;
+  t.type = type;
+  t.start = start;
+  t.length = (int)(current - start);
+  t.line = line;
+  t.message = "";
+  t.symbol = Symbols::NONE;
   return t;
 }
 
-Token *copyToken(Token *t) {
-  Token *tn = new Token();
-  tn->type = t->type;
-  tn->start = t->start;
-  tn->message = t->message;
-  tn->length = t->length;
-  tn->line = t->line;
-  return tn;
-}
-
-Token *errorToken(const char *msg) {
-  Token *t = makeToken(TokenType::SCAN_ERROR);
-  t->message = msg;
+Token Scanner::errorToken(const char *msg) {
+  Token t = makeToken(TokenType::SCAN_ERROR);
+  t.message = msg;
   return t;
 }
 
-static char peek() { return *scanner.current; }
+char Scanner::peek() const { return *current; }
 
-static char advance() {
-  scanner.current++;
-  return scanner.current[-1];
+char Scanner::advance() {
+  current++;
+  return current[-1];
 }
 
-static bool match(char expected) {
+bool Scanner::match(char expected) {
   if (isEnd())
     return false;
-  if (*scanner.current != expected)
+  if (*current != expected)
     return false;
   advance();
   return true;
 }
 
-static bool matchS(std::string e) {
-  if (isEnd())
-    return false;
-  const char *expected = e.c_str();
-  int count = e.length();
-  // printf("Count:%d\n", count);
-  for (int i = 0; i < count - 1; i++) {
-    // printf("Current:%c Expected:%c\n", scanner.current[i], expected[i]);
-    if (scanner.current[i] != expected[i])
-      return false;
-  }
-  scanner.current += count;
-  return true;
+// runs shorter than this are scanned byte by byte before calling a kernel,
+// most separators and identifiers are shorter than one vector
+static const int SHORT_RUN = 8;
+
+static bool isSpace(char c) {
+  return c == ' ' || c == '\r' || c == '\t' || c == '\n';
 }
 
-static void skipWhitespace() {
-  for (;;) {
+void Scanner::skipWhitespace() {
+  for (int i = 0; i < SHORT_RUN; i++) {
     char c = peek();
-    switch (c) {
-    case ' ':
-    case '\r':
-    case '\t':
-      advance();
-      break;
-    case '\n':
-      scanner.line++;
-      advance();
-      break;
-    default:
+    if (!isSpace(c))
       return;
-    }
+    if (c == '\n')
+      line++;
+    advance();
   }
+  current = simd->skipSpace(current, &line);
 }
 
-static bool gotoChar(char c) {
-  while (!isEnd()) {
-    if (peek() == c) {
-      advance();
-      return true;
-    }
-    advance();
-  }
-  return false;
+// moves to the next c (or the end) and consumes it
+bool Scanner::gotoChar(char c) {
+  current = simd->findChar(current, c, &line);
+  if (isEnd())
+    return false;
+  advance();
+  return true;
 }
 
-static Token *string() {
-  while (peek() != '"' && !isEnd()) {
-    if (peek() == '\\') {
-      if (scanner.current[1] == '\"') {
-        advance();
-      }
-    }
-    if (peek() == '\n')
-      scanner.line++;
+Token Scanner::string() {
+  for (;;) {
+    current = simd->findQuote(current, &line);
+    if (peek() != '\\')
+      break;
     advance();
+    if (peek() == '"')
+      advance();
   }
   if (isEnd())
     return errorToken("Unterminated string.");
@@ -141,7 +107,11 @@ static bool isAlpha(char c) {
   return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z');
 }
 
-static Token *number() {
+static bool isIdentifierChar(char c) {
+  return isAlpha(c) || isDigit(c) || c == '_';
+}
+
+Token Scanner::number() {
   while (isDigit(peek()))
     advance();
   if (match('.')) {
@@ -156,28 +126,118 @@ static Token *number() {
         return errorToken("Expected at least one digit after 'e'");
       while (isDigit(peek()))
         advance();
-      return makeToken(TokenType::REAL_LIT);
     }
+    return makeToken(TokenType::REAL_LIT);
   }
   return makeToken(TokenType::INT_LIT);
 }
 
-static Token *identifier() {
-  while (isAlpha(peek()) || isDigit(peek()) || peek() == '_')
+// Keywords are the TOKEN_TYPES entries whose description is a plain word.
+// They are found with a perfect hash on (first char, last char, length)
+// whose multipliers are searched for at compile time.
+struct Keyword {
+  const char *text;
+  int length;
+  TokenType type;
+};
+
+#define F(name, desc) {desc, sizeof(desc) - 1, TokenType::name},
+static constexpr Keyword Tokens[]{TOKEN_TYPES(F)};
+#undef F
+
+static constexpr int TOKEN_COUNT = sizeof(Tokens) / sizeof(Tokens[0]);
+static constexpr int KEYWORD_SLOTS = 64;
+
+static constexpr bool isKeyword(const Keyword &k) {
+  if (k.length == 0)
+    return false;
+  for (int i = 0; i < k.length; i++)
+    if (k.text[i] < 'a' || k.text[i] > 'z')
+      return false;
+  return true;
+}
+
+static constexpr unsigned keywordHash(const char *s, int length, unsigned a,
+                                      unsigned b) {
+  return ((unsigned char)s[0] * a + (unsigned char)s[length - 1] * b +
+          (unsigned)length) %
+         KEYWORD_SLOTS;
+}
+
+struct KeywordTable {
+  unsigned a = 0;
+  unsigned b = 0;
+  int maxLength = 0;
+  signed char slots[KEYWORD_SLOTS]{};
+};
+
+static constexpr bool fillKeywordTable(KeywordTable &t) {
+  for (int i = 0; i < KEYWORD_SLOTS; i++)
+    t.slots[i] = -1;
+  for (int i = 0; i < TOKEN_COUNT; i++) {
+    if (!isKeyword(Tokens[i]))
+      continue;
+    unsigned h = keywordHash(Tokens[i].text, Tokens[i].length, t.a, t.b);
+    if (t.slots[h] != -1)
+      return false;
+    t.slots[h] = (signed char)i;
+    if (Tokens[i].length > t.maxLength)
+      t.maxLength = Tokens[i].length;
+  }
+  return true;
+}
+
+static constexpr KeywordTable makeKeywordTable() {
+  KeywordTable t;
+  for (t.a = 1; t.a < KEYWORD_SLOTS; t.a++)
+    for (t.b = 0; t.b < KEYWORD_SLOTS; t.b++)
+      if (fillKeywordTable(t))
+        return t;
+  t.maxLength = -1;
+  return t;
+}
+
+static constexpr KeywordTable keywords = makeKeywordTable();
+static_assert(keywords.maxLength > 0,
+              "no perfect hash for keywords, increase KEYWORD_SLOTS");
+
+static TokenType identifierType(const char *s, int length) {
+  if (length > keywords.maxLength)
+    return TokenType::ID;
+  int slot = keywords.slots[keywordHash(s, length, keywords.a, keywords.b)];
+  if (slot < 0 || Tokens[slot].length != length)
+    return TokenType::ID;
+  for (int i = 0; i < length; i++)
+    if (s[i] != Tokens[slot].text[i])
+      return TokenType::ID;
+  return Tokens[slot].type;
+}
+
+Token Scanner::identifier() {
+  int i = 0;
+  while (i < SHORT_RUN && isIdentifierChar(peek())) {
     advance();
-  return makeToken(TokenType::ID);
+    i++;
+  }
+  if (i == SHORT_RUN)
+    current = simd->skipIdentifier(current);
+  Token t = makeToken(identifierType(start, (int)(current - start)));
+  if (t.type == TokenType::ID && interner)
+    t.symbol = interner->intern(std::string_view(t.start, t.length));
+  return t;
 }
 
-Token *scanToken() {
+Token Scanner::scanToken() {
   skipWhitespace();
-  scanner.start = scanner.current;
+  start = current;
   if (isEnd())
     return makeToken(TokenType::SCAN_EOF);
   char c = advance();
   switch (c) {
   case '/':
     if (peek() == '/') {
-      gotoChar('\n');
+      // the newline is left for skipWhitespace to count
+      current = simd->findChar(current, '\n', &line);
       return makeToken(TokenType::COMMENT);
     }
     return makeToken(TokenType::DIV);
@@ -228,98 +288,6 @@ Token *scanToken() {
     return makeToken(TokenType::COMMA);
   case ';':
     return makeToken(TokenType::SEMICOLON);
-  case 'o':
-    if (matchS("r ")) {
-      scanner.current--;
-      return makeToken(TokenType::OR);
-    }
-    if (matchS("f ")) {
-      scanner.current--;
-      return makeToken(TokenType::OF);
-    }
-    break;
-  case 'a':
-    if (matchS("nd ")) {
-      scanner.current--;
-      return makeToken(TokenType::AND);
-    }
-    if (matchS("rray ")) {
-      scanner.current--;
-      return makeToken(TokenType::ARRAY);
-    }
-    if (matchS("ssert ")) {
-      scanner.current--;
-      return makeToken(TokenType::ASSERT);
-    }
-    break;
-  case 'n':
-    if (matchS("ot ")) {
-      scanner.current--;
-      return makeToken(TokenType::NOT);
-    }
-    break;
-  case 'i':
-    if (matchS("f ")) {
-      scanner.current--;
-      return makeToken(TokenType::IF);
-    }
-    break;
-  case 't':
-    if (matchS("hen ")) {
-      scanner.current--;
-      return makeToken(TokenType::THEN);
-    }
-    break;
-  case 'e':
-    if (matchS("lse ")) {
-      scanner.current--;
-      return makeToken(TokenType::ELSE);
-    }
-    if (matchS("nd ")) {
-      scanner.current--;
-      return makeToken(TokenType::END);
-    }
-    break;
-  case 'w':
-    if (matchS("hile ")) {
-      scanner.current--;
-      return makeToken(TokenType::WHILE);
-    }
-    break;
-  case 'd':
-    if (matchS("o ")) {
-      scanner.current--;
-      return makeToken(TokenType::WHILE);
-    }
-    break;
-  case 'b':
-    if (matchS("egin ")) {
-      scanner.current--;
-      return makeToken(TokenType::BEGIN);
-    }
-    break;
-  case 'v':
-    if (matchS("ar ")) {
-      scanner.current--;
-      return makeToken(TokenType::VAR);
-    }
-    break;
-  case 'p':
-    if (matchS("rocedure ")) {
-      scanner.current--;
-      return makeToken(TokenType::PROCEDURE);
-    }
-    if (matchS("rogram ")) {
-      scanner.current--;
-      return makeToken(TokenType::PROGRAM);
-    }
-    break;
-  case 'r':
-    if (matchS("eturn ")) {
-      scanner.current--;
-      return makeToken(TokenType::RETURN);
-    }
-    break;
   case '"':
     return string();
   }
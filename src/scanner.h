@@ -1,7 +1,9 @@
 #ifndef SCANNER_H_
 #define SCANNER_H_
 
-#include "string"
+#include "symbols.h"
+#include <string>
+#include <string_view>
 
 namespace Scanner {
 
@@ -62,14 +64,41 @@ struct Token {
   const char *message;
   int length;
   int line;
+  Symbols::Symbol symbol; // interned text of ID tokens, NONE otherwise
 };
 
-void init(const std::string source);
-std::string getName(Token *t);
+struct Kernels;
+
+// Scanning state for one source, several scanners can run at once
+class Scanner {
+public:
+  // source must be followed by Source::Buffer::PADDING NUL bytes. With an
+  // interner, identifiers are interned as they are scanned
+  void init(std::string_view source, Symbols::Interner *interner = nullptr);
+  Token scanToken();
+  Token errorToken(const char *msg);
+
+private:
+  const char *start = nullptr;
+  const char *current = nullptr;
+  int line = 1;
+  const Kernels *simd = nullptr;
+  Symbols::Interner *interner = nullptr;
+
+  bool isEnd() const;
+  char peek() const;
+  char advance();
+  bool match(char expected);
+  Token makeToken(TokenType type);
+  void skipWhitespace();
+  bool gotoChar(char c);
+  Token string();
+  Token number();
+  Token identifier();
+};
+
+std::string getName(const Token &t);
 std::string getName(TokenType t);
-Token *scanToken();
-Token *errorToken(const char *msg);
-Token *copyToken(Token *t);
 
 } // namespace Scanner
 
@@ -0,0 +1,261 @@
+#include "scanner_simd.h"
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__)
+#define SCANNER_SSE2 1
+#include <immintrin.h>
+#endif
+
+namespace Scanner {
+
+static bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool isIdentifierChar(char c) {
+  return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') ||
+         ('0' <= c && c <= '9') || c == '_';
+}
+
+static const char *skipSpaceScalar(const char *p, int *lines) {
+  while (isSpace(*p)) {
+    if (*p == '\n')
+      (*lines)++;
+    p++;
+  }
+  return p;
+}
+
+static const char *findCharScalar(const char *p, char c, int *lines) {
+  while (*p != c && *p != '\0') {
+    if (*p == '\n')
+      (*lines)++;
+    p++;
+  }
+  return p;
+}
+
+static const char *findQuoteScalar(const char *p, int *lines) {
+  while (*p != '"' && *p != '\\' && *p != '\0') {
+    if (*p == '\n')
+      (*lines)++;
+    p++;
+  }
+  return p;
+}
+
+static const char *skipIdentifierScalar(const char *p) {
+  while (isIdentifierChar(*p))
+    p++;
+  return p;
+}
+
+static const Kernels scalar{"scalar", skipSpaceScalar, findCharScalar,
+                            findQuoteScalar, skipIdentifierScalar};
+
+#ifdef SCANNER_SSE2
+
+// newlines among the first n bytes of a chunk
+static int newlinesBefore(unsigned newlines, int n) {
+  if (n < 32)
+    newlines &= (1u << n) - 1;
+  return newlines ? __builtin_popcount(newlines) : 0;
+}
+
+// SSE2 is the compile-time baseline, these need no runtime check
+
+static const char *skipSpaceSSE2(const char *p, int *lines) {
+  const __m128i space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'),
+                cr = _mm_set1_epi8('\r'), nl = _mm_set1_epi8('\n');
+  for (;; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i n = _mm_cmpeq_epi8(v, nl);
+    __m128i s = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), n),
+                             _mm_or_si128(_mm_cmpeq_epi8(v, tab),
+                                          _mm_cmpeq_epi8(v, cr)));
+    unsigned other = ~(unsigned)_mm_movemask_epi8(s) & 0xFFFF;
+    unsigned newlines = _mm_movemask_epi8(n);
+    if (other) {
+      int i = __builtin_ctz(other);
+      *lines += newlinesBefore(newlines, i);
+      return p + i;
+    }
+    if (newlines)
+      *lines += __builtin_popcount(newlines);
+  }
+}
+
+static const char *findCharSSE2(const char *p, char c, int *lines) {
+  const __m128i target = _mm_set1_epi8(c), zero = _mm_setzero_si128(),
+                nl = _mm_set1_epi8('\n');
+  for (;; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    unsigned stop = _mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(v, target), _mm_cmpeq_epi8(v, zero)));
+    unsigned newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+    if (stop) {
+      int i = __builtin_ctz(stop);
+      *lines += newlinesBefore(newlines, i);
+      return p + i;
+    }
+    if (newlines)
+      *lines += __builtin_popcount(newlines);
+  }
+}
+
+static const char *findQuoteSSE2(const char *p, int *lines) {
+  const __m128i quote = _mm_set1_epi8('"'), slash = _mm_set1_epi8('\\'),
+                zero = _mm_setzero_si128(), nl = _mm_set1_epi8('\n');
+  for (;; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    unsigned stop = _mm_movemask_epi8(
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                  _mm_cmpeq_epi8(v, slash)),
+                     _mm_cmpeq_epi8(v, zero)));
+    unsigned newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+    if (stop) {
+      int i = __builtin_ctz(stop);
+      *lines += newlinesBefore(newlines, i);
+      return p + i;
+    }
+    if (newlines)
+      *lines += __builtin_popcount(newlines);
+  }
+}
+
+// signed compares are fine: bytes >= 0x80 are negative and never match
+static const char *skipIdentifierSSE2(const char *p) {
+  const __m128i caseBit = _mm_set1_epi8(0x20);
+  const __m128i a = _mm_set1_epi8('a' - 1), z = _mm_set1_epi8('z' + 1),
+                d0 = _mm_set1_epi8('0' - 1), d9 = _mm_set1_epi8('9' + 1),
+                underscore = _mm_set1_epi8('_');
+  for (;; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i lower = _mm_or_si128(v, caseBit);
+    __m128i letter =
+        _mm_and_si128(_mm_cmpgt_epi8(lower, a), _mm_cmplt_epi8(lower, z));
+    __m128i digit =
+        _mm_and_si128(_mm_cmpgt_epi8(v, d0), _mm_cmplt_epi8(v, d9));
+    __m128i ok = _mm_or_si128(_mm_or_si128(letter, digit),
+                              _mm_cmpeq_epi8(v, underscore));
+    unsigned other = ~(unsigned)_mm_movemask_epi8(ok) & 0xFFFF;
+    if (other)
+      return p + __builtin_ctz(other);
+  }
+}
+
+static const Kernels sse2{"sse2", skipSpaceSSE2, findCharSSE2, findQuoteSSE2,
+                          skipIdentifierSSE2};
+
+// every AVX2 CPU has popcnt, let the AVX2 kernels use it
+#define AVX2 __attribute__((target("avx2,popcnt")))
+
+AVX2 static const char *skipSpaceAVX2(const char *p, int *lines) {
+  const __m256i space = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t'),
+                cr = _mm256_set1_epi8('\r'), nl = _mm256_set1_epi8('\n');
+  for (;; p += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    __m256i n = _mm256_cmpeq_epi8(v, nl);
+    __m256i s =
+        _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, space), n),
+                        _mm256_or_si256(_mm256_cmpeq_epi8(v, tab),
+                                        _mm256_cmpeq_epi8(v, cr)));
+    unsigned other = ~(unsigned)_mm256_movemask_epi8(s);
+    unsigned newlines = _mm256_movemask_epi8(n);
+    if (other) {
+      int i = __builtin_ctz(other);
+      *lines += newlinesBefore(newlines, i);
+      return p + i;
+    }
+    if (newlines)
+      *lines += __builtin_popcount(newlines);
+  }
+}
+
+AVX2 static const char *findCharAVX2(const char *p, char c, int *lines) {
+  const __m256i target = _mm256_set1_epi8(c), zero = _mm256_setzero_si256(),
+                nl = _mm256_set1_epi8('\n');
+  for (;; p += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    unsigned stop = _mm256_movemask_epi8(_mm256_or_si256(
+        _mm256_cmpeq_epi8(v, target), _mm256_cmpeq_epi8(v, zero)));
+    unsigned newlines = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+    if (stop) {
+      int i = __builtin_ctz(stop);
+      *lines += newlinesBefore(newlines, i);
+      return p + i;
+    }
+    if (newlines)
+      *lines += __builtin_popcount(newlines);
+  }
+}
+
+AVX2 static const char *findQuoteAVX2(const char *p, int *lines) {
+  const __m256i quote = _mm256_set1_epi8('"'),
+                slash = _mm256_set1_epi8('\\'),
+                zero = _mm256_setzero_si256(), nl = _mm256_set1_epi8('\n');
+  for (;; p += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    unsigned stop = _mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                                        _mm256_cmpeq_epi8(v, slash)),
+                        _mm256_cmpeq_epi8(v, zero)));
+    unsigned newlines = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+    if (stop) {
+      int i = __builtin_ctz(stop);
+      *lines += newlinesBefore(newlines, i);
+      return p + i;
+    }
+    if (newlines)
+      *lines += __builtin_popcount(newlines);
+  }
+}
+
+AVX2 static const char *skipIdentifierAVX2(const char *p) {
+  const __m256i caseBit = _mm256_set1_epi8(0x20);
+  const __m256i a = _mm256_set1_epi8('a' - 1), z = _mm256_set1_epi8('z' + 1),
+                d0 = _mm256_set1_epi8('0' - 1), d9 = _mm256_set1_epi8('9' + 1),
+                underscore = _mm256_set1_epi8('_');
+  for (;; p += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    __m256i lower = _mm256_or_si256(v, caseBit);
+    __m256i letter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, a),
+                                      _mm256_cmpgt_epi8(z, lower));
+    __m256i digit =
+        _mm256_and_si256(_mm256_cmpgt_epi8(v, d0), _mm256_cmpgt_epi8(d9, v));
+    __m256i ok = _mm256_or_si256(_mm256_or_si256(letter, digit),
+                                 _mm256_cmpeq_epi8(v, underscore));
+    unsigned other = ~(unsigned)_mm256_movemask_epi8(ok);
+    if (other)
+      return p + __builtin_ctz(other);
+  }
+}
+
+static const Kernels avx2{"avx2", skipSpaceAVX2, findCharAVX2, findQuoteAVX2,
+                          skipIdentifierAVX2};
+
+#endif // SCANNER_SSE2
+
+static const Kernels *selectKernels() {
+  const char *force = std::getenv("MINIPL_SCAN_KERNELS");
+  if (force && std::strcmp(force, "scalar") == 0)
+    return &scalar;
+#ifdef SCANNER_SSE2
+  if (force && std::strcmp(force, "sse2") == 0)
+    return &sse2;
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return &avx2;
+  return &sse2;
+#else
+  return &scalar;
+#endif
+}
+
+const Kernels &kernels() {
+  static const Kernels *k = selectKernels();
+  return *k;
+}
+
+} // namespace Scanner
@@ -0,0 +1,27 @@
+#ifndef SCANNER_SIMD_H_
+#define SCANNER_SIMD_H_
+
+namespace Scanner {
+
+// Bulk scanning kernels used by the scanner's hot loops. The input must be
+// NUL terminated and readable for Source::Buffer::PADDING bytes past the NUL;
+// every kernel stops at the NUL.
+struct Kernels {
+  const char *name;
+  // skips ' ', '\t', '\r' and '\n', adding the newlines to *lines
+  const char *(*skipSpace)(const char *p, int *lines);
+  // returns the first c or NUL, adding the newlines before it to *lines
+  const char *(*findChar)(const char *p, char c, int *lines);
+  // returns the first '"', '\\' or NUL, adding the newlines before it
+  const char *(*findQuote)(const char *p, int *lines);
+  // skips letters, digits and '_'
+  const char *(*skipIdentifier)(const char *p);
+};
+
+// best kernels for this CPU: AVX2, SSE2 or scalar. MINIPL_SCAN_KERNELS can
+// be set to "scalar" or "sse2" to force a narrower set
+const Kernels &kernels();
+
+} // namespace Scanner
+
+#endif // SCANNER_SIMD_H_
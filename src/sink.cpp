@@ -0,0 +1,113 @@
+#include "sink.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace Sink {
+
+static bool writeAll(int fd, const char *p, size_t n) {
+  while (n) {
+    ssize_t w = write(fd, p, n);
+    if (w < 0 && errno == EINTR)
+      continue;
+    if (w <= 0)
+      return false;
+    p += w;
+    n -= w;
+  }
+  return true;
+}
+
+void Buffer::grow() {
+  if (!cursor) {
+    if (chunks.empty())
+      chunks.emplace_back(new char[CHUNK]);
+    current = 0;
+  } else if (fd >= 0) {
+    // a bound buffer reuses its only chunk
+    if (!writeAll(fd, chunks[0].get(), CHUNK))
+      failed = true;
+    written += CHUNK;
+  } else if (++current == chunks.size()) {
+    chunks.emplace_back(new char[CHUNK]);
+  }
+  cursor = chunks[current].get();
+  limit = cursor + CHUNK;
+}
+
+void Buffer::append(const char *p, size_t n) {
+  while (n) {
+    if (cursor == limit)
+      grow();
+    size_t k = std::min(n, (size_t)(limit - cursor));
+    std::memcpy(cursor, p, k);
+    cursor += k;
+    p += k;
+    n -= k;
+  }
+}
+
+size_t Buffer::size() const {
+  if (!cursor)
+    return written;
+  return written + current * CHUNK + (cursor - chunks[current].get());
+}
+
+void Buffer::clear() {
+  current = 0;
+  written = 0;
+  failed = false;
+  cursor = chunks.empty() ? nullptr : chunks[0].get();
+  limit = cursor ? cursor + CHUNK : nullptr;
+}
+
+bool Buffer::flush() {
+  if (fd < 0 || !cursor)
+    return !failed;
+  size_t n = cursor - chunks[0].get();
+  if (!writeAll(fd, chunks[0].get(), n))
+    failed = true;
+  written += n;
+  cursor = chunks[0].get();
+  return !failed;
+}
+
+bool Buffer::writeTo(int out) const {
+  if (!cursor)
+    return true;
+  std::vector<iovec> iov(current + 1);
+  for (size_t c = 0; c <= current; c++)
+    iov[c] = {chunks[c].get(), c < current ? CHUNK
+                                           : (size_t)(cursor - chunks[c].get())};
+  size_t first = 0;
+  while (first < iov.size()) {
+    int count = std::min(iov.size() - first, (size_t)IOV_MAX);
+    ssize_t w = writev(out, &iov[first], count);
+    if (w < 0 && errno == EINTR)
+      continue;
+    if (w < 0)
+      return false;
+    // skip what was written, a short write can end inside a chunk
+    while (first < iov.size() && (size_t)w >= iov[first].iov_len)
+      w -= iov[first++].iov_len;
+    if (first < iov.size()) {
+      iov[first].iov_base = (char *)iov[first].iov_base + w;
+      iov[first].iov_len -= w;
+    }
+  }
+  return true;
+}
+
+std::string Buffer::str() const {
+  std::string s;
+  s.reserve(size());
+  for (size_t c = 0; cursor && c <= current; c++)
+    s.append(chunks[c].get(), c < current ? CHUNK
+                                          : (size_t)(cursor - chunks[c].get()));
+  return s;
+}
+
+} // namespace Sink
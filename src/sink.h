@@ -0,0 +1,65 @@
+#ifndef SINK_H_
+#define SINK_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Sink {
+
+// Output collected in fixed size chunks, so appending never moves what was
+// written before. A buffer bound to a file descriptor writes each chunk as
+// soon as it fills and holds only one. An unbound buffer keeps everything
+// until writeTo() sends it to a descriptor with a single writev.
+class Buffer {
+public:
+  static const size_t CHUNK = 1 << 16;
+
+  Buffer() = default;
+  explicit Buffer(int fd) : fd(fd) {}
+  Buffer(const Buffer &) = delete;
+  Buffer &operator=(const Buffer &) = delete;
+
+  void put(char c) {
+    if (cursor == limit)
+      grow();
+    *cursor++ = c;
+  }
+  void append(const char *p, size_t n);
+  Buffer &operator+=(char c) {
+    put(c);
+    return *this;
+  }
+  Buffer &operator+=(std::string_view s) {
+    append(s.data(), s.size());
+    return *this;
+  }
+
+  // bytes appended since the last clear
+  size_t size() const;
+  // forgets the contents, keeps the chunks for reuse
+  void clear();
+  // writes what a bound buffer still holds, false if a write failed
+  bool flush();
+  // writes the contents of an unbound buffer to fd, false on failure
+  bool writeTo(int fd) const;
+  // a copy of the contents of an unbound buffer
+  std::string str() const;
+
+private:
+  std::vector<std::unique_ptr<char[]>> chunks;
+  size_t current = 0; // chunk being filled, later ones are spare
+  char *cursor = nullptr;
+  char *limit = nullptr;
+  size_t written = 0; // bytes a bound buffer has written
+  int fd = -1;
+  bool failed = false;
+
+  void grow();
+};
+
+} // namespace Sink
+
+#endif // SINK_H_
@@ -0,0 +1,115 @@
+#include "source.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Source {
+
+Buffer::Buffer(std::string_view text) { copy(text); }
+
+Buffer::~Buffer() { release(); }
+
+void Buffer::release() {
+  if (mapped)
+    munmap(src, mapped);
+  else
+    std::free(src);
+  src = nullptr;
+  length = 0;
+  mapped = 0;
+}
+
+void Buffer::copy(std::string_view text) {
+  release();
+  src = (char *)std::malloc(text.size() + PADDING);
+  std::memcpy(src, text.data(), text.size());
+  std::memset(src + text.size(), 0, PADDING);
+  length = text.size();
+}
+
+// reads a stream of unknown size (pipe, tty) into a padded heap buffer;
+// returns nullptr with errno set on failure
+static char *readAll(int fd, size_t *length) {
+  size_t cap = 1 << 16, len = 0;
+  char *buf = (char *)std::malloc(cap + Buffer::PADDING);
+  if (!buf) {
+    errno = ENOMEM;
+    return nullptr;
+  }
+  for (;;) {
+    ssize_t n = read(fd, buf + len, cap - len);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      std::free(buf);
+      return nullptr;
+    }
+    if (n == 0)
+      break;
+    len += n;
+    if (len == cap) {
+      cap *= 2;
+      char *grown = (char *)std::realloc(buf, cap + Buffer::PADDING);
+      if (!grown) {
+        std::free(buf);
+        errno = ENOMEM;
+        return nullptr;
+      }
+      buf = grown;
+    }
+  }
+  std::memset(buf + len, 0, Buffer::PADDING);
+  *length = len;
+  return buf;
+}
+
+void Buffer::open(const std::string path) {
+  release();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw(errno);
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    int e = errno;
+    close(fd);
+    throw(e);
+  }
+  if (!S_ISREG(st.st_mode)) {
+    src = readAll(fd, &length);
+    int e = errno;
+    close(fd);
+    if (!src)
+      throw(e);
+    return;
+  }
+  size_t size = st.st_size;
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t total = (size + PADDING + page - 1) / page * page;
+  // reserve zeroed pages for the file and its padding, then map the file over
+  // the front; the tail of the last file page is zero-filled by the kernel
+  void *base = mmap(nullptr, total, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS,
+                    -1, 0);
+  if (base == MAP_FAILED) {
+    int e = errno;
+    close(fd);
+    throw(e);
+  }
+  if (size > 0 && mmap(base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd,
+                       0) == MAP_FAILED) {
+    int e = errno;
+    munmap(base, total);
+    close(fd);
+    throw(e);
+  }
+  close(fd);
+  madvise(base, total, MADV_SEQUENTIAL);
+  src = (char *)base;
+  length = size;
+  mapped = total;
+}
+
+} // namespace Source
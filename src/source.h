@@ -0,0 +1,42 @@
+#ifndef SOURCE_H_
+#define SOURCE_H_
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace Source {
+
+// Read-only program text followed by at least PADDING NUL bytes, so the
+// scanner can run over it without bounds checks. Files are memory-mapped,
+// anything else (pipes, in-memory strings) is copied once.
+class Buffer {
+public:
+  // covers the widest scanner kernel load starting at the sentinel
+  static const size_t PADDING = 64;
+
+  Buffer() = default;
+  explicit Buffer(std::string_view text);
+  Buffer(const Buffer &) = delete;
+  Buffer &operator=(const Buffer &) = delete;
+  ~Buffer();
+
+  // throws errno on failure
+  void open(const std::string path);
+
+  const char *data() const { return src ? src : EMPTY; }
+  size_t size() const { return length; }
+  std::string_view view() const { return std::string_view(data(), length); }
+
+private:
+  static constexpr char EMPTY[PADDING]{};
+  char *src = nullptr;
+  size_t length = 0;
+  size_t mapped = 0; // bytes mapped with mmap, 0 if src is heap allocated
+  void release();
+  void copy(std::string_view text);
+};
+
+} // namespace Source
+
+#endif // SOURCE_H_
@@ -0,0 +1,618 @@
+#include "ssa.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace SSA {
+
+using IR::Op;
+using IR::Ref;
+using IR::Type;
+
+uint32_t Graph::resolve(uint32_t v) const {
+  while (values[v].kind == Value::PHI && phis[values[v].ref].forward != NONE)
+    v = phis[values[v].ref].forward;
+  return v;
+}
+
+std::vector<std::vector<uint32_t>> Graph::dominatorTree() const {
+  std::vector<std::vector<uint32_t>> children(blocks.size());
+  for (uint32_t b = 1; b < blocks.size(); b++)
+    if (blocks[b].idom != NONE)
+      children[blocks[b].idom].push_back(b);
+  return children;
+}
+
+Builder::Builder(const IR::Program &ir)
+    : ir(ir), assigned(ir, IR::LoopVars::ASSIGNED),
+      defs(ir.vars.size(), NONE), seen(ir.vars.size()),
+      other(ir.vars.size(), NONE) {}
+
+Graph Builder::build(Ref body) {
+  Graph graph;
+  g = &graph;
+  current = block();
+  statement(body);
+  undo(0);
+  computeDominators();
+  g = nullptr;
+  return graph;
+}
+
+uint32_t Builder::block() {
+  g->blocks.emplace_back();
+  return g->blocks.size() - 1;
+}
+
+bool Builder::reachable(uint32_t b) const {
+  return b == 0 || !g->blocks[b].preds.empty();
+}
+
+// control reaching an unreachable block does not count
+bool Builder::edge(uint32_t from, uint32_t to) {
+  if (!reachable(from))
+    return false;
+  g->blocks[from].succs.push_back(to);
+  g->blocks[to].preds.push_back(from);
+  return true;
+}
+
+uint32_t Builder::value(Value::Kind kind, uint32_t ref) {
+  g->values.push_back({kind, ref});
+  return g->values.size() - 1;
+}
+
+uint32_t Builder::phi(uint32_t block, uint32_t var,
+                      std::vector<uint32_t> operands) {
+  g->phis.push_back({block, var, std::move(operands)});
+  g->blocks[block].phis.push_back(g->phis.size() - 1);
+  return value(Value::PHI, g->phis.size() - 1);
+}
+
+bool Builder::tracked(uint32_t var) const {
+  Type t = ir.vars[var].type;
+  return t == Type::INTEGER || t == Type::BOOLEAN || t == Type::REAL;
+}
+
+// Definitions are logged so a branch can be undone, as in Symbols::Scopes.
+void Builder::def(uint32_t var, uint32_t value) {
+  log.push_back({var, defs[var]});
+  defs[var] = value;
+}
+
+// variables not defined in the body, like parameters, hold some value
+uint32_t Builder::read(uint32_t var) {
+  if (defs[var] == NONE)
+    def(var, value(Value::OPAQUE, 0));
+  return defs[var];
+}
+
+void Builder::undo(size_t mark) {
+  for (; log.size() > mark; log.pop_back())
+    defs[log.back().first] = log.back().second;
+}
+
+// variables defined since mark, once each, with their current values
+std::vector<std::pair<uint32_t, uint32_t>> Builder::changes(size_t mark) {
+  std::vector<std::pair<uint32_t, uint32_t>> c;
+  generation++;
+  for (size_t i = mark; i < log.size(); i++) {
+    uint32_t var = log[i].first;
+    if (seen[var] != generation) {
+      seen[var] = generation;
+      c.push_back({var, defs[var]});
+    }
+  }
+  return c;
+}
+
+// defines var after an if, from the values the branches leave
+void Builder::join(uint32_t var, uint32_t then, uint32_t otherwise,
+                   uint32_t thenEnd, uint32_t elseEnd) {
+  if (!reachable(thenEnd))
+    then = otherwise;
+  else if (!reachable(elseEnd))
+    otherwise = then;
+  if (then == NONE || otherwise == NONE)
+    return;
+  def(var, then == otherwise ? then : phi(current, var, {then, otherwise}));
+}
+
+void Builder::branches(Ref n) {
+  uint32_t cond = current;
+  size_t mark = log.size();
+  current = block();
+  edge(cond, current);
+  statement(ir.b[n]);
+  uint32_t thenEnd = current;
+  auto thenDefs = changes(mark);
+  undo(mark);
+  uint32_t elseEnd = cond;
+  if (ir.c[n] != IR::NONE) {
+    current = block();
+    edge(cond, current);
+    statement(ir.c[n]);
+    elseEnd = current;
+  }
+  auto elseDefs = changes(mark);
+  undo(mark);
+  current = block();
+  edge(thenEnd, current);
+  edge(elseEnd, current);
+  for (auto &[var, value] : elseDefs)
+    other[var] = value;
+  for (auto &[var, value] : thenDefs) {
+    uint32_t otherwise = other[var] != NONE ? other[var] : defs[var];
+    other[var] = NONE;
+    join(var, value, otherwise, thenEnd, elseEnd);
+  }
+  for (auto &[var, value] : elseDefs)
+    if (other[var] != NONE) {
+      other[var] = NONE;
+      join(var, defs[var], value, thenEnd, elseEnd);
+    }
+}
+
+// The head gets a phi for each variable the loop assigns. The operands
+// coming around the back edge are known once the body has been built.
+void Builder::loop(Ref n) {
+  uint32_t head = block();
+  edge(current, head);
+  std::vector<uint32_t> phis;
+  for (const uint32_t *v = assigned.begin(n); v != assigned.end(n); v++)
+    if (tracked(*v)) {
+      uint32_t entry = read(*v);
+      uint32_t p = phi(head, *v, {entry});
+      phis.push_back(g->values[p].ref);
+      def(*v, p);
+    }
+  size_t mark = log.size();
+  current = head;
+  expr(ir.a[n]);
+  current = block();
+  edge(head, current);
+  statement(ir.b[n]);
+  bool back = edge(current, head);
+  for (uint32_t p : phis)
+    if (back)
+      g->phis[p].operands.push_back(defs[g->phis[p].var]);
+  undo(mark);
+  current = block();
+  edge(head, current);
+  // a phi of itself and one other value is that value
+  for (uint32_t p : phis) {
+    Phi &phi = g->phis[p];
+    uint32_t self = defs[phi.var], same = NONE;
+    bool trivial = true;
+    for (uint32_t o : phi.operands) {
+      o = g->resolve(o);
+      if (o == self || o == same)
+        continue;
+      trivial = same == NONE;
+      same = o;
+    }
+    if (trivial && same != NONE) {
+      phi.forward = same;
+      def(phi.var, same);
+    }
+  }
+}
+
+void Builder::expr(Ref n) {
+  if (n == IR::NONE)
+    return;
+  uint32_t read = NONE;
+  switch (ir.op[n]) {
+  case Op::INT:
+  case Op::REAL:
+  case Op::STR:
+  case Op::BOOL:
+    break;
+  case Op::VAR:
+    expr(ir.b[n]);
+    if (ir.b[n] == IR::NONE && tracked(ir.a[n]))
+      read = this->read(ir.a[n]);
+    break;
+  case Op::TEE:
+    expr(ir.b[n]);
+    if (tracked(ir.a[n]))
+      def(ir.a[n], value(Value::NODE, ir.b[n]));
+    break;
+  case Op::CALL:
+    for (const Ref *r = ir.begin(n); r != ir.end(n); r++)
+      expr(*r);
+    // the call assigns what it takes by reference
+    for (size_t i = 0; i < ir.c[n]; i++) {
+      uint32_t var = ir.a[ir.begin(n)[i]];
+      if (ir.byReference(n, i) && tracked(var))
+        def(var, value(Value::OPAQUE, 0));
+    }
+    break;
+  default:
+    expr(ir.a[n]);
+    if (IR::isBinary(ir.op[n]))
+      expr(ir.b[n]);
+  }
+  g->blocks[current].code.push_back({n, read});
+}
+
+void Builder::statement(Ref n) {
+  switch (ir.op[n]) {
+  case Op::BLOCK:
+    for (const Ref *s = ir.begin(n); s != ir.end(n); s++)
+      statement(*s);
+    break;
+  case Op::DECLARE:
+    expr(ir.b[n]);
+    if (tracked(ir.a[n]))
+      def(ir.a[n], value(Value::ZERO, (uint32_t)ir.vars[ir.a[n]].type));
+    break;
+  case Op::ASSIGN:
+    expr(ir.b[n]);
+    expr(ir.c[n]);
+    if (ir.c[n] == IR::NONE && tracked(ir.a[n]))
+      def(ir.a[n], value(Value::NODE, ir.b[n]));
+    break;
+  case Op::READ:
+    for (const Ref *r = ir.begin(n); r != ir.end(n); r++) {
+      expr(ir.b[*r]);
+      if (ir.b[*r] == IR::NONE && tracked(ir.a[*r]))
+        def(ir.a[*r], value(Value::OPAQUE, 0));
+    }
+    break;
+  case Op::CALL:
+    expr(n);
+    break;
+  case Op::WRITE:
+    for (const Ref *a = ir.begin(n); a != ir.end(n); a++)
+      expr(*a);
+    break;
+  case Op::IF:
+    expr(ir.a[n]);
+    branches(n);
+    break;
+  case Op::WHILE:
+    loop(n);
+    break;
+  case Op::RETURN: // what follows is unreachable
+    expr(ir.a[n]);
+    current = block();
+    break;
+  default: // ASSERT
+    expr(ir.a[n]);
+  }
+}
+
+// Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm": the
+// immediate dominators are refined in reverse postorder to a fixed point.
+void Builder::computeDominators() {
+  auto &blocks = g->blocks;
+  std::vector<uint32_t> order, number(blocks.size(), NONE); // postorder
+  std::vector<std::pair<uint32_t, uint32_t>> stack{{0, 0}}; // block, succ
+  std::vector<bool> visited(blocks.size());
+  visited[0] = true;
+  while (!stack.empty()) {
+    auto &[b, i] = stack.back();
+    if (i < blocks[b].succs.size()) {
+      uint32_t s = blocks[b].succs[i++];
+      if (!visited[s]) {
+        visited[s] = true;
+        stack.push_back({s, 0});
+      }
+      continue;
+    }
+    number[b] = order.size();
+    order.push_back(b);
+    stack.pop_back();
+  }
+  auto intersect = [&](uint32_t x, uint32_t y) {
+    while (x != y) {
+      while (number[x] < number[y])
+        x = blocks[x].idom;
+      while (number[y] < number[x])
+        y = blocks[y].idom;
+    }
+    return x;
+  };
+  blocks[0].idom = 0;
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (size_t i = order.size() - 1; i-- > 0;) {
+      Block &b = blocks[order[i]];
+      uint32_t idom = NONE;
+      for (uint32_t p : b.preds)
+        if (blocks[p].idom != NONE)
+          idom = idom == NONE ? p : intersect(p, idom);
+      if (b.idom != idom) {
+        b.idom = idom;
+        changed = true;
+      }
+    }
+  }
+}
+
+// value numbering
+
+// An expression up to the numbers of its operands.
+struct Key {
+  uint32_t op, type;
+  uint64_t x, y;
+  bool operator==(const Key &k) const {
+    return op == k.op && type == k.type && x == k.x && y == k.y;
+  }
+};
+
+struct KeyHash {
+  size_t operator()(const Key &k) const {
+    uint64_t h = (uint64_t)k.op << 32 | k.type;
+    h = h * 0x9e3779b97f4a7c15 ^ k.x;
+    h = h * 0x9e3779b97f4a7c15 ^ k.y;
+    return h ^ h >> 29;
+  }
+};
+
+class Numbering {
+public:
+  IR::Program &ir;
+  size_t replaced = 0;
+
+  explicit Numbering(IR::Program &ir)
+      : ir(ir), vn(ir.size(), NONE), leader(ir.size(), IR::NONE),
+        evaluated(ir.size()) {}
+
+  void body(const Graph &graph) {
+    g = &graph;
+    valueVn.assign(graph.values.size(), NONE);
+    phiVn.assign(graph.phis.size(), NONE);
+    // preorder over the dominator tree, leaving a block ends its scope
+    auto children = graph.dominatorTree();
+    std::vector<std::pair<uint32_t, size_t>> stack{{0, NONE}};
+    while (!stack.empty()) {
+      auto [b, mark] = stack.back();
+      stack.pop_back();
+      if (mark != NONE) {
+        undo(mark);
+        continue;
+      }
+      stack.push_back({b, log.size()});
+      block(graph.blocks[b]);
+      for (auto c = children[b].rbegin(); c != children[b].rend(); c++)
+        stack.push_back({*c, NONE});
+    }
+    g = nullptr;
+  }
+
+  // Replaces expressions by the temporary of their leader in program
+  // order, where the leader is known to have been evaluated before.
+  void rewrite(Ref n) { statement(n); }
+
+private:
+  const Graph *g = nullptr;
+  uint32_t next = 0;
+  std::vector<uint32_t> vn;  // by node
+  std::vector<Ref> leader;   // by node, the first with its number
+  std::vector<bool> evaluated;
+  std::vector<uint32_t> valueVn, phiVn;
+  std::unordered_map<Key, std::pair<uint32_t, Ref>, KeyHash> table;
+  std::vector<Key> log; // keys entered, undone when a scope ends
+  std::unordered_map<Key, uint32_t, KeyHash> constants;
+
+  uint32_t fresh() { return next++; }
+
+  void undo(size_t mark) {
+    for (; log.size() > mark; log.pop_back())
+      table.erase(log.back());
+  }
+
+  uint32_t constant(const Key &k) {
+    auto [it, added] = constants.try_emplace(k, next);
+    if (added)
+      next++;
+    return it->second;
+  }
+
+  uint32_t real(double d) {
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof bits);
+    return constant({(uint32_t)Op::REAL, (uint32_t)Type::REAL, bits, 0});
+  }
+
+  uint32_t ofValue(uint32_t v) {
+    v = g->resolve(v);
+    const Value &value = g->values[v];
+    switch (value.kind) {
+    case Value::NODE:
+      return vn[value.ref];
+    case Value::PHI:
+      return phiVn[value.ref];
+    case Value::ZERO:
+      if ((Type)value.ref == Type::REAL)
+        return real(0);
+      return constant({(uint32_t)(value.ref == (uint32_t)Type::BOOLEAN
+                                      ? Op::BOOL
+                                      : Op::INT),
+                       value.ref, 0, 0});
+    default:
+      if (valueVn[v] == NONE)
+        valueVn[v] = fresh();
+      return valueVn[v];
+    }
+  }
+
+  void block(const Block &b) {
+    // operands around a back edge are not numbered yet, so differ
+    for (uint32_t p : b.phis) {
+      if (g->phis[p].forward != NONE)
+        continue;
+      uint32_t same = NONE;
+      for (uint32_t o : g->phis[p].operands) {
+        uint32_t x = ofValue(o);
+        if (x == NONE || (same != NONE && x != same)) {
+          same = NONE;
+          break;
+        }
+        same = x;
+      }
+      phiVn[p] = same != NONE ? same : fresh();
+    }
+    for (const Eval &e : b.code)
+      number(e);
+  }
+
+  static bool commutes(Op o) {
+    return o == Op::ADD || o == Op::MUL || o == Op::EQ || o == Op::NEQ ||
+           o == Op::AND || o == Op::OR;
+  }
+
+  void number(const Eval &e) {
+    Ref n = e.node;
+    switch (ir.op[n]) {
+    case Op::INT:
+    case Op::BOOL:
+      vn[n] = constant({(uint32_t)ir.op[n], (uint32_t)ir.type[n], ir.a[n], 0});
+      return;
+    case Op::REAL:
+      vn[n] = real(ir.reals[ir.a[n]]);
+      return;
+    case Op::VAR: {
+      uint32_t x = e.value != NONE ? ofValue(e.value) : NONE;
+      vn[n] = x != NONE ? x : fresh();
+      return;
+    }
+    case Op::TEE:
+      vn[n] = vn[ir.b[n]];
+      return;
+    case Op::STR:
+    case Op::CALL:
+    case Op::SIZE:
+      vn[n] = fresh();
+      return;
+    default:
+      break;
+    }
+    // strings are compared and joined in memory, not worth a temporary
+    Op o = ir.op[n];
+    Ref l = ir.a[n], r = IR::isBinary(o) ? ir.b[n] : IR::NONE;
+    if (ir.type[l] == Type::STRING) {
+      vn[n] = fresh();
+      return;
+    }
+    uint64_t x = vn[l], y = r != IR::NONE ? vn[r] : NONE;
+    if (o == Op::GT || o == Op::GTE) {
+      o = o == Op::GT ? Op::LT : Op::LTE;
+      std::swap(x, y);
+    } else if (commutes(o) && y < x) {
+      std::swap(x, y);
+    }
+    Key k{(uint32_t)o, (uint32_t)ir.type[n], x, y};
+    auto [it, added] = table.try_emplace(k, next, n);
+    if (added) {
+      next++;
+      log.push_back(k);
+    }
+    vn[n] = it->second.first;
+    leader[n] = it->second.second;
+  }
+
+  void replace(Ref n, Ref l) {
+    // the leader stores its value on first reuse
+    if (ir.op[l] != Op::TEE) {
+      uint32_t var = ir.addVariable(Symbols::NONE, ir.type[l], IR::NONE);
+      Ref copy = ir.add(ir.op[l], ir.type[l], ir.a[l], ir.b[l], ir.c[l]);
+      ir.op[l] = Op::TEE;
+      ir.a[l] = var;
+      ir.b[l] = copy;
+      ir.c[l] = 0;
+    }
+    ir.op[n] = Op::VAR;
+    ir.a[n] = ir.a[l];
+    ir.b[n] = IR::NONE;
+    ir.c[n] = 0;
+    replaced++;
+  }
+
+  void expr(Ref n) {
+    if (n == IR::NONE)
+      return;
+    if (n < leader.size()) {
+      Ref l = leader[n];
+      if (l != IR::NONE && l != n && evaluated[l])
+        return replace(n, l);
+    }
+    switch (ir.op[n]) {
+    case Op::INT:
+    case Op::REAL:
+    case Op::STR:
+    case Op::BOOL:
+      break;
+    case Op::VAR:
+    case Op::TEE:
+      expr(ir.b[n]);
+      break;
+    case Op::CALL:
+      for (const Ref *r = ir.begin(n); r != ir.end(n); r++)
+        expr(*r);
+      break;
+    default:
+      expr(ir.a[n]);
+      if (IR::isBinary(ir.op[n]))
+        expr(ir.b[n]);
+    }
+    if (n < evaluated.size())
+      evaluated[n] = true;
+  }
+
+  void statement(Ref n) {
+    switch (ir.op[n]) {
+    case Op::BLOCK:
+      for (const Ref *s = ir.begin(n); s != ir.end(n); s++)
+        statement(*s);
+      break;
+    case Op::DECLARE:
+      expr(ir.b[n]);
+      break;
+    case Op::ASSIGN:
+      expr(ir.b[n]);
+      expr(ir.c[n]);
+      break;
+    case Op::READ:
+      for (const Ref *r = ir.begin(n); r != ir.end(n); r++)
+        expr(ir.b[*r]);
+      break;
+    case Op::CALL:
+    case Op::WRITE:
+      for (const Ref *a = ir.begin(n); a != ir.end(n); a++)
+        expr(*a);
+      break;
+    case Op::IF:
+      expr(ir.a[n]);
+      statement(ir.b[n]);
+      if (ir.c[n] != IR::NONE)
+        statement(ir.c[n]);
+      break;
+    case Op::WHILE:
+      expr(ir.a[n]);
+      statement(ir.b[n]);
+      break;
+    default: // ASSERT and RETURN
+      expr(ir.a[n]);
+    }
+  }
+};
+
+size_t numberValues(IR::Program &ir) {
+  Builder builder(ir);
+  Numbering numbering(ir);
+  std::vector<Ref> bodies;
+  for (auto &f : ir.functions)
+    bodies.push_back(f.body);
+  bodies.push_back(ir.main);
+  for (Ref body : bodies)
+    numbering.body(builder.build(body));
+  // rewriting appends nodes, so only once every graph is done with
+  for (Ref body : bodies)
+    numbering.rewrite(body);
+  return numbering.replaced;
+}
+
+} // namespace SSA
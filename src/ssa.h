@@ -0,0 +1,101 @@
+#ifndef SSA_H_
+#define SSA_H_
+
+#include "ir.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace SSA {
+
+const uint32_t NONE = ~0u;
+
+// What a variable holds at some point: the result of an expression node,
+// a phi merging the values reaching the head of a block, the zero of a
+// declaration, or a value nothing is known about, like one read from input.
+struct Value {
+  enum Kind { NODE, PHI, ZERO, OPAQUE } kind;
+  uint32_t ref; // node, phi or type
+};
+
+struct Phi {
+  uint32_t block;
+  uint32_t var;
+  std::vector<uint32_t> operands; // values, in the order of the predecessors
+  uint32_t forward = NONE;        // the value a trivial phi stands for
+};
+
+// An expression node in evaluation order, with the value a variable node
+// reads, NONE for other nodes and for variables kept in memory.
+struct Eval {
+  IR::Ref node;
+  uint32_t value;
+};
+
+struct Block {
+  std::vector<uint32_t> preds, succs;
+  std::vector<uint32_t> phis;
+  std::vector<Eval> code; // operands before the node using them
+  uint32_t idom = NONE;   // immediate dominator, the entry is its own
+};
+
+// The control flow graph of one body in SSA form. Variables the generator
+// keeps in locals, integers, Booleans and reals, are renamed into values;
+// strings and arrays live in memory and are not tracked. The entry is
+// block 0 and blocks without predecessors after it are unreachable.
+struct Graph {
+  std::vector<Block> blocks;
+  std::vector<Value> values;
+  std::vector<Phi> phis;
+
+  // follows trivial phis to the value they stand for
+  uint32_t resolve(uint32_t value) const;
+  // children of each block in the dominator tree, in block order
+  std::vector<std::vector<uint32_t>> dominatorTree() const;
+};
+
+// Builds the graphs of the bodies of one program, which must not change
+// while the builder is in use.
+class Builder {
+public:
+  explicit Builder(const IR::Program &ir);
+  Graph build(IR::Ref body);
+
+private:
+  const IR::Program &ir;
+  IR::LoopVars assigned;
+  Graph *g = nullptr;
+  uint32_t current = 0;                      // block
+  std::vector<uint32_t> defs;                // by variable, NONE if unknown
+  std::vector<std::pair<uint32_t, uint32_t>> log; // variable, previous def
+  std::vector<uint32_t> seen, other;         // by variable, scratch
+  uint32_t generation = 0;
+
+  uint32_t block();
+  bool edge(uint32_t from, uint32_t to);
+  bool reachable(uint32_t b) const;
+  uint32_t value(Value::Kind kind, uint32_t ref);
+  uint32_t phi(uint32_t block, uint32_t var, std::vector<uint32_t> operands);
+  bool tracked(uint32_t var) const;
+  void def(uint32_t var, uint32_t value);
+  uint32_t read(uint32_t var);
+  void undo(size_t mark);
+  std::vector<std::pair<uint32_t, uint32_t>> changes(size_t mark);
+  void join(uint32_t var, uint32_t then, uint32_t otherwise,
+            uint32_t thenEnd, uint32_t elseEnd);
+  void branches(IR::Ref n);
+  void loop(IR::Ref n);
+  void expr(IR::Ref n);
+  void statement(IR::Ref n);
+  void computeDominators();
+};
+
+// Global value numbering over the dominator tree of each body. The first
+// evaluation of an expression that a dominated one repeats is stored in a
+// temporary with a TEE, and the repetitions read the temporary. Returns the
+// number of expressions replaced.
+size_t numberValues(IR::Program &ir);
+
+} // namespace SSA
+
+#endif // SSA_H_
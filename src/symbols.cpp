@@ -0,0 +1,100 @@
+#include "symbols.h"
+#include <cstring>
+
+namespace Symbols {
+
+#define F(name, text) text,
+static const char *BuiltinNames[]{BUILTIN_SYMBOLS(F)};
+#undef F
+
+static const size_t BLOCK_SIZE = 1 << 14;
+
+// FNV-1a
+static uint32_t hash(std::string_view s) {
+  uint32_t h = 2166136261u;
+  for (char c : s) {
+    h ^= (unsigned char)c;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+Interner::Interner() { clear(); }
+
+void Interner::clear() {
+  names.clear();
+  hashes.clear();
+  slots.assign(64, NONE);
+  blocks.clear();
+  blockUsed = blockSize = 0;
+  names.push_back("");
+  hashes.push_back(0);
+  for (Symbol s = 1; s < BUILTIN_COUNT; s++)
+    intern(BuiltinNames[s]);
+}
+
+std::string_view Interner::store(std::string_view name) {
+  if (blockUsed + name.size() > blockSize) {
+    blockSize = name.size() > BLOCK_SIZE ? name.size() : BLOCK_SIZE;
+    blocks.emplace_back(new char[blockSize]);
+    blockUsed = 0;
+  }
+  char *p = blocks.back().get() + blockUsed;
+  std::memcpy(p, name.data(), name.size());
+  blockUsed += name.size();
+  return std::string_view(p, name.size());
+}
+
+void Interner::grow() {
+  slots.assign(slots.size() * 2, NONE);
+  size_t mask = slots.size() - 1;
+  for (Symbol s = 1; s < names.size(); s++) {
+    size_t i = hashes[s] & mask;
+    while (slots[i] != NONE)
+      i = (i + 1) & mask;
+    slots[i] = s;
+  }
+}
+
+Symbol Interner::intern(std::string_view name) {
+  uint32_t h = hash(name);
+  size_t mask = slots.size() - 1;
+  size_t i = h & mask;
+  for (; slots[i] != NONE; i = (i + 1) & mask) {
+    Symbol s = slots[i];
+    if (hashes[s] == h && names[s] == name)
+      return s;
+  }
+  Symbol s = names.size();
+  names.push_back(store(name));
+  hashes.push_back(h);
+  slots[i] = s;
+  // keep the load factor under 1/2
+  if (names.size() * 2 > slots.size())
+    grow();
+  return s;
+}
+
+void Scopes::reset(size_t symbols) {
+  bound.assign(symbols, {0, 0});
+  log.clear();
+  marks.clear();
+}
+
+void Scopes::bind(Symbol s, uint32_t value) {
+  if (s >= bound.size())
+    bound.resize(s + 1, {0, 0});
+  log.push_back({s, bound[s]});
+  bound[s] = {value, (uint32_t)marks.size()};
+}
+
+void Scopes::leave() {
+  size_t mark = marks.back();
+  marks.pop_back();
+  while (log.size() > mark) {
+    bound[log.back().symbol] = log.back().old;
+    log.pop_back();
+  }
+}
+
+} // namespace Symbols
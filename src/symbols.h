@@ -0,0 +1,91 @@
+#ifndef SYMBOLS_H_
+#define SYMBOLS_H_
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace Symbols {
+
+// Dense id of an interned identifier, usable as an array index
+using Symbol = uint32_t;
+
+// names the compiler looks for, interned first so their ids are constants
+#define BUILTIN_SYMBOLS(F)                                                     \
+  F(NONE, "")                                                                  \
+  F(INTEGER, "integer")                                                        \
+  F(REAL, "real")                                                              \
+  F(STRING, "string")                                                          \
+  F(BOOLEAN, "Boolean")                                                        \
+  F(VOID, "void")                                                              \
+  F(READ, "read")                                                              \
+  F(WRITELN, "writeln")                                                        \
+  F(SIZE, "size")                                                              \
+  F(TRUE, "true")                                                              \
+  F(FALSE, "false")
+
+#define F(name, text) name,
+enum Builtin : Symbol { BUILTIN_SYMBOLS(F) BUILTIN_COUNT };
+#undef F
+
+// Maps every distinct identifier to a Symbol. Names are copied into the
+// interner, so they outlive the source they were scanned from.
+class Interner {
+public:
+  Interner();
+  Symbol intern(std::string_view name);
+  std::string_view name(Symbol s) const { return names[s]; }
+  // number of symbols, every Symbol is below this
+  size_t size() const { return names.size(); }
+  // forgets everything except the builtins
+  void clear();
+
+private:
+  std::vector<std::string_view> names;
+  std::vector<uint32_t> hashes;
+  std::vector<Symbol> slots; // open addressing, NONE marks a free slot
+  std::vector<std::unique_ptr<char[]>> blocks;
+  size_t blockUsed = 0;
+  size_t blockSize = 0;
+
+  std::string_view store(std::string_view name);
+  void grow();
+};
+
+// Nested scopes binding symbols to values, 0 meaning unbound. Symbols are
+// dense, so the innermost binding of each is kept in an array indexed by
+// Symbol. Bindings that get shadowed are saved in an undo log, and leave()
+// restores them, so a scope costs O(1) plus its own declarations.
+class Scopes {
+public:
+  // forgets all bindings, symbols is the interner size
+  void reset(size_t symbols);
+  void enter() { marks.push_back(log.size()); }
+  void leave();
+  void bind(Symbol s, uint32_t value);
+  uint32_t lookup(Symbol s) const {
+    return s < bound.size() ? bound[s].value : 0;
+  }
+  // true if s is bound in the innermost scope
+  bool isLocal(Symbol s) const {
+    return lookup(s) && bound[s].depth == marks.size();
+  }
+
+private:
+  struct Binding {
+    uint32_t value;
+    uint32_t depth;
+  };
+  struct Undo {
+    Symbol symbol;
+    Binding old;
+  };
+  std::vector<Binding> bound;
+  std::vector<Undo> log;
+  std::vector<size_t> marks; // log size when each open scope was entered
+};
+
+} // namespace Symbols
+
+#endif // SYMBOLS_H_
@@ -0,0 +1,165 @@
+#include "vectorizer.h"
+#include <algorithm>
+
+namespace Vectorizer {
+
+using IR::Op;
+using IR::Ref;
+using IR::Type;
+
+// Checks one while loop against the shape of a Loop, filling it in
+class Matcher {
+public:
+  const IR::Program &ir;
+  Loop &loop;
+
+  Matcher(const IR::Program &ir, Loop &loop) : ir(ir), loop(loop) {}
+
+  bool run(Ref n) {
+    Ref condition = ir.a[n], body = ir.b[n];
+    Ref i;
+    if (ir.op[condition] == Op::LT) {
+      i = ir.a[condition];
+      loop.limit = ir.b[condition];
+    } else if (ir.op[condition] == Op::GT) {
+      i = ir.b[condition];
+      loop.limit = ir.a[condition];
+    } else {
+      return false;
+    }
+    if (!plain(i) || ir.vars[ir.a[i]].type != Type::INTEGER)
+      return false;
+    loop.counter = ir.a[i];
+    // a begin-end body is a block in the block of the loop
+    while (ir.op[body] == Op::BLOCK && ir.c[body] == 1)
+      body = *ir.begin(body);
+    if (ir.op[body] != Op::BLOCK || ir.c[body] < 2)
+      return false;
+    const Ref *last = ir.end(body) - 1;
+    if (!step(*last))
+      return false;
+    // the counter and the sums are the variables the loop assigns
+    assigned.push_back(loop.counter);
+    loop.element = Type::VOID;
+    for (const Ref *s = ir.begin(body); s != last; s++) {
+      if (ir.op[*s] != Op::ASSIGN)
+        return false;
+      uint32_t var = ir.a[*s];
+      Type t = ir.vars[var].type;
+      if (ir.c[*s] != IR::NONE) {
+        if (!IR::isArray(t) || !index(ir.c[*s]) || !element(IR::elementOf(t)))
+          return false;
+        add(loop.arrays, var);
+      } else {
+        if (t != Type::INTEGER || !element(t) || ir.op[ir.b[*s]] != Op::ADD ||
+            std::count(assigned.begin(), assigned.end(), var))
+          return false;
+        assigned.push_back(var);
+      }
+      loop.statements.push_back(*s);
+    }
+    if (loop.element != Type::INTEGER && loop.element != Type::REAL)
+      return false;
+    for (Ref s : loop.statements)
+      if (!(ir.c[s] != IR::NONE ? vector(ir.b[s]) : sum(s)))
+        return false;
+    return invariant(loop.limit);
+  }
+
+private:
+  std::vector<uint32_t> assigned;
+
+  static void add(std::vector<uint32_t> &vars, uint32_t var) {
+    if (!std::count(vars.begin(), vars.end(), var))
+      vars.push_back(var);
+  }
+
+  // a variable read without an index
+  bool plain(Ref n) const {
+    return ir.op[n] == Op::VAR && ir.b[n] == IR::NONE;
+  }
+
+  bool index(Ref n) const { return plain(n) && ir.a[n] == loop.counter; }
+
+  // all arrays and sums of a loop have one element type
+  bool element(Type t) {
+    if (loop.element == Type::VOID)
+      loop.element = t;
+    return loop.element == t;
+  }
+
+  // i := i + 1 or i := 1 + i
+  bool step(Ref n) const {
+    if (ir.op[n] != Op::ASSIGN || ir.a[n] != loop.counter ||
+        ir.c[n] != IR::NONE || ir.op[ir.b[n]] != Op::ADD)
+      return false;
+    Ref x = ir.a[ir.b[n]], y = ir.b[ir.b[n]];
+    if (ir.op[x] == Op::INT)
+      std::swap(x, y);
+    return index(x) && ir.op[y] == Op::INT && ir.a[y] == 1;
+  }
+
+  // s := s + e or s := e + s, with e not reading s
+  bool sum(Ref n) {
+    Ref x = ir.a[ir.b[n]], y = ir.b[ir.b[n]];
+    if (plain(x) && ir.a[x] == ir.a[n])
+      return vector(y);
+    return plain(y) && ir.a[y] == ir.a[n] && vector(x);
+  }
+
+  bool invariant(Ref n) const {
+    switch (ir.op[n]) {
+    case Op::INT:
+      return true;
+    case Op::VAR:
+      return plain(n) &&
+             !std::count(assigned.begin(), assigned.end(), ir.a[n]);
+    case Op::SIZE:
+      return plain(ir.a[n]);
+    default:
+      return false;
+    }
+  }
+
+  // an expression computing the lanes of a v128 at once
+  bool vector(Ref n) {
+    Type t = loop.element;
+    switch (ir.op[n]) {
+    case Op::INT:
+      return t == Type::INTEGER;
+    case Op::REAL:
+      return t == Type::REAL;
+    case Op::VAR:
+      if (ir.b[n] == IR::NONE) {
+        if (ir.type[n] != t || !invariant(n))
+          return false;
+        add(loop.scalars, ir.a[n]);
+      } else {
+        if (ir.type[n] != t || !index(ir.b[n]))
+          return false;
+        add(loop.arrays, ir.a[n]);
+      }
+      return true;
+    case Op::NEG:
+      return ir.type[n] == t && vector(ir.a[n]);
+    case Op::DIV: // integer division traps and has no lanes
+      if (t != Type::REAL)
+        return false;
+      [[fallthrough]];
+    case Op::ADD:
+    case Op::SUB:
+    case Op::MUL:
+      return ir.type[n] == t && vector(ir.a[n]) && vector(ir.b[n]);
+    default:
+      return false;
+    }
+  }
+};
+
+bool match(const IR::Program &ir, Ref n, Loop &loop) {
+  loop = Loop();
+  Matcher m(ir, loop);
+  return m.run(n);
+}
+
+} // namespace Vectorizer
@@ -0,0 +1,43 @@
+#ifndef VECTORIZER_H_
+#define VECTORIZER_H_
+
+#include "ir.h"
+#include <cstdint>
+#include <vector>
+
+namespace Vectorizer {
+
+// A while loop whose iterations do the same thing to the elements at one
+// index, so that the generator can run several of them at once in the
+// lanes of a v128:
+//
+//   while i < limit do
+//   begin
+//     a[i] := e;
+//     s := s + e;
+//     i := i + 1;
+//   end
+//
+// with any number of element stores and sums in any order. A sum adds up
+// integers into a variable read nowhere else in the loop. The limit and
+// the scalars the expressions e read stay the same while the loop runs,
+// and every element e reads is at index i. All arrays hold the element
+// type of the loop.
+struct Loop {
+  uint32_t counter;                // variable i
+  IR::Ref limit;                   // expression i is compared below
+  IR::Type element;                // INTEGER or REAL
+  std::vector<IR::Ref> statements; // ASSIGN nodes, without the step
+  std::vector<uint32_t> arrays;    // accessed, each once
+  std::vector<uint32_t> scalars;   // variables e reads, each once
+};
+
+// elements of type t in a v128
+inline uint32_t lanes(IR::Type t) { return t == IR::Type::REAL ? 2 : 4; }
+
+// True if while loop n has the shape of a Loop, which is then filled in.
+bool match(const IR::Program &ir, IR::Ref n, Loop &loop);
+
+} // namespace Vectorizer
+
+#endif // VECTORIZER_H_
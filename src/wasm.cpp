@@ -0,0 +1,431 @@
+#include "wasm.h"
+#include <cstring>
+
+namespace Wasm {
+
+struct OpInfo {
+  const char *text;
+  uint32_t code;
+  Imm imm;
+  uint8_t align;
+};
+
+#define F(name, text, code, imm, align) {text, code, Imm::imm, align},
+static const OpInfo Ops[]{WASM_OPS(F)};
+#undef F
+
+const char *opName(Op o) { return Ops[(int)o].text; }
+Imm immediate(Op o) { return Ops[(int)o].imm; }
+
+const char *valTypeName(ValType t) {
+  switch (t) {
+  case ValType::I32:
+    return "i32";
+  case ValType::I64:
+    return "i64";
+  case ValType::F32:
+    return "f32";
+  case ValType::F64:
+    return "f64";
+  default:
+    return "v128";
+  }
+}
+
+Instr memory(Op op, uint32_t offset) {
+  return Instr{op, Ops[(int)op].align, offset};
+}
+
+uint32_t Module::type(const FuncType &t) {
+  for (uint32_t i = 0; i < types.size(); i++)
+    if (types[i] == t)
+      return i;
+  types.push_back(t);
+  return types.size() - 1;
+}
+
+uint32_t Module::importedFunctions() const {
+  uint32_t n = 0;
+  for (auto &i : imports)
+    n += i.kind == Extern::FUNC;
+  return n;
+}
+
+uint32_t Module::function(std::string_view name) const {
+  uint32_t f = 0;
+  for (auto &i : imports) {
+    if (i.kind != Extern::FUNC)
+      continue;
+    if (i.name == name)
+      return f;
+    f++;
+  }
+  for (auto &d : functions) {
+    if (d.name == name)
+      return f;
+    f++;
+  }
+  return NOT_FOUND;
+}
+
+uint32_t Module::global(std::string_view name) const {
+  for (uint32_t g = 0; g < globals.size(); g++)
+    if (globals[g].name == name)
+      return g;
+  return NOT_FOUND;
+}
+
+const FuncType &Module::signature(uint32_t function) const {
+  uint32_t f = 0;
+  for (auto &i : imports)
+    if (i.kind == Extern::FUNC && f++ == function)
+      return types[i.type];
+  return types[functions[function - f].type];
+}
+
+std::string_view Module::functionName(uint32_t function) const {
+  uint32_t f = 0;
+  for (auto &i : imports)
+    if (i.kind == Extern::FUNC && f++ == function)
+      return i.name;
+  return functions[function - f].name;
+}
+
+void Module::dropUnused() {
+  uint32_t imported = importedFunctions();
+  std::vector<bool> used(functionCount());
+  std::vector<uint32_t> work;
+  for (uint32_t f = 0; f < functions.size(); f++)
+    if (!functions[f].exportName.empty()) {
+      used[imported + f] = true;
+      work.push_back(imported + f);
+    }
+  while (!work.empty()) {
+    uint32_t f = work.back();
+    work.pop_back();
+    if (f < imported)
+      continue;
+    for (auto &i : functions[f - imported].body)
+      if (i.op == Op::CALL && !used[i.a]) {
+        used[i.a] = true;
+        work.push_back(i.a);
+      }
+  }
+  std::vector<uint32_t> index(used.size());
+  std::vector<Import> keptImports;
+  uint32_t function = 0, next = 0;
+  for (auto &i : imports) {
+    if (i.kind == Extern::FUNC) {
+      if (!used[function]) {
+        function++;
+        continue;
+      }
+      index[function++] = next++;
+    }
+    keptImports.push_back(std::move(i));
+  }
+  imports = std::move(keptImports);
+  std::vector<Function> kept;
+  for (uint32_t f = 0; f < functions.size(); f++)
+    if (used[imported + f]) {
+      index[imported + f] = next++;
+      kept.push_back(std::move(functions[f]));
+    }
+  functions = std::move(kept);
+
+  std::vector<bool> usedGlobal(globals.size());
+  for (auto &f : functions)
+    for (auto &i : f.body)
+      if (i.op == Op::GLOBAL_GET || i.op == Op::GLOBAL_SET)
+        usedGlobal[i.a] = true;
+  std::vector<uint32_t> globalIndex(globals.size());
+  std::vector<Global> keptGlobals;
+  for (uint32_t g = 0; g < globals.size(); g++)
+    if (usedGlobal[g]) {
+      globalIndex[g] = keptGlobals.size();
+      keptGlobals.push_back(std::move(globals[g]));
+    }
+  globals = std::move(keptGlobals);
+  for (auto &f : functions)
+    for (auto &i : f.body)
+      if (i.op == Op::CALL)
+        i.a = index[i.a];
+      else if (i.op == Op::GLOBAL_GET || i.op == Op::GLOBAL_SET)
+        i.a = globalIndex[i.a];
+}
+
+// binary format
+
+// Every writer below runs on a Counter first when the size of what it
+// writes is needed up front, so sections go straight to the sink.
+struct Counter {
+  size_t n = 0;
+  void put(char) { n++; }
+  void append(const char *, size_t k) { n += k; }
+};
+
+template <class Out> static void uleb(Out &out, uint64_t v) {
+  do {
+    uint8_t byte = v & 0x7f;
+    v >>= 7;
+    if (v)
+      byte |= 0x80;
+    out.put(byte);
+  } while (v);
+}
+
+template <class Out> static void sleb(Out &out, int64_t v) {
+  for (;;) {
+    uint8_t byte = v & 0x7f;
+    v >>= 7; // arithmetic shift keeps the sign
+    if ((v == 0 && !(byte & 0x40)) || (v == -1 && (byte & 0x40))) {
+      out.put(byte);
+      return;
+    }
+    out.put(byte | 0x80);
+  }
+}
+
+template <class Out> static void name(Out &out, std::string_view s) {
+  uleb(out, s.size());
+  out.append(s.data(), s.size());
+}
+
+template <class Out> static void limits(Out &out, const Limits &l) {
+  out.put(l.hasMax ? 1 : 0);
+  uleb(out, l.min);
+  if (l.hasMax)
+    uleb(out, l.max);
+}
+
+template <class Out> static void instr(Out &out, const Instr &i) {
+  const OpInfo &info = Ops[(int)i.op];
+  if (info.code > 0xff) {
+    out.put(info.code >> 16);
+    uleb(out, info.code & 0xffff);
+  } else {
+    out.put(info.code);
+  }
+  switch (info.imm) {
+  case Imm::NONE:
+    break;
+  case Imm::BLOCK:
+    out.put(i.a);
+    break;
+  case Imm::LABEL:
+  case Imm::FUNC:
+  case Imm::LOCAL:
+  case Imm::GLOBAL:
+    uleb(out, i.a);
+    break;
+  case Imm::I32:
+    sleb(out, (int32_t)i.i);
+    break;
+  case Imm::I64:
+    sleb(out, i.i);
+    break;
+  case Imm::F64: {
+    char bytes[8];
+    std::memcpy(bytes, &i.f, 8); // wasm is little endian, as are our hosts
+    out.append(bytes, 8);
+    break;
+  }
+  case Imm::MEM:
+    uleb(out, i.a);
+    uleb(out, i.b);
+    break;
+  case Imm::ZERO:
+    out.put(0);
+    break;
+  case Imm::ZERO2:
+    out.put(0);
+    out.put(0);
+    break;
+  case Imm::LANE:
+    out.put(i.a);
+    break;
+  }
+}
+
+// writes a section, running body once to measure it and once to write it
+template <class Body>
+static void section(Sink::Buffer &out, uint8_t id, Body body) {
+  Counter size;
+  body(size);
+  out.put(id);
+  uleb(out, size.n);
+  body(out);
+}
+
+// local declarations, runs of one type
+static std::vector<std::pair<uint32_t, ValType>> localRuns(const Function &f) {
+  std::vector<std::pair<uint32_t, ValType>> runs;
+  for (ValType t : f.locals) {
+    if (!runs.empty() && runs.back().second == t)
+      runs.back().first++;
+    else
+      runs.push_back({1, t});
+  }
+  return runs;
+}
+
+template <class Out> static void localDecls(Out &out, const Function &f) {
+  auto runs = localRuns(f);
+  uleb(out, runs.size());
+  for (auto &r : runs) {
+    uleb(out, r.first);
+    out.put((char)r.second);
+  }
+}
+
+template <class Out> static void functionBody(Out &out, const Function &f) {
+  localDecls(out, f);
+  for (const Instr &i : f.body)
+    instr(out, i);
+  out.put(0x0b);
+}
+
+// offset in the module and source line of the lines of function f, whose
+// body starts at offset at
+static void lineOffsets(const Function &f, size_t at,
+                        std::vector<std::pair<uint32_t, uint32_t>> &out) {
+  Counter c{at};
+  localDecls(c, f);
+  size_t k = 0;
+  for (size_t i = 0; i < f.body.size() && k < f.lines.size(); i++) {
+    for (; k < f.lines.size() && f.lines[k].first == i; k++)
+      out.push_back({c.n, f.lines[k].second});
+    instr(c, f.body[i]);
+  }
+}
+
+void encode(const Module &m, Sink::Buffer &out) {
+  size_t start = out.size();
+  out.append("\0asm\1\0\0\0", 8);
+
+  section(out, 1, [&](auto &s) {
+    uleb(s, m.types.size());
+    for (auto &t : m.types) {
+      s.put(0x60);
+      uleb(s, t.params.size());
+      for (ValType v : t.params)
+        s.put((char)v);
+      uleb(s, t.results.size());
+      for (ValType v : t.results)
+        s.put((char)v);
+    }
+  });
+
+  if (!m.imports.empty()) {
+    section(out, 2, [&](auto &s) {
+      uleb(s, m.imports.size());
+      for (auto &i : m.imports) {
+        name(s, i.module);
+        name(s, i.field);
+        s.put((char)i.kind);
+        if (i.kind == Extern::FUNC)
+          uleb(s, i.type);
+        else
+          limits(s, i.limits);
+      }
+    });
+  }
+
+  section(out, 3, [&](auto &s) {
+    uleb(s, m.functions.size());
+    for (auto &f : m.functions)
+      uleb(s, f.type);
+  });
+
+  if (m.hasMemory) {
+    section(out, 5, [&](auto &s) {
+      uleb(s, 1);
+      limits(s, m.memory);
+    });
+  }
+
+  if (!m.globals.empty()) {
+    section(out, 6, [&](auto &s) {
+      uleb(s, m.globals.size());
+      for (auto &g : m.globals) {
+        s.put((char)g.type);
+        s.put(g.mut);
+        instr(s, g.init);
+        s.put(0x0b);
+      }
+    });
+  }
+
+  section(out, 7, [&](auto &s) {
+    uint32_t exports = m.hasMemory && !m.memoryExport.empty();
+    for (auto &f : m.functions)
+      exports += !f.exportName.empty();
+    uleb(s, exports);
+    uint32_t index = m.importedFunctions();
+    for (auto &f : m.functions) {
+      if (!f.exportName.empty()) {
+        name(s, f.exportName);
+        s.put((char)Extern::FUNC);
+        uleb(s, index);
+      }
+      index++;
+    }
+    if (m.hasMemory && !m.memoryExport.empty()) {
+      name(s, m.memoryExport);
+      s.put((char)Extern::MEMORY);
+      uleb(s, 0);
+    }
+  });
+
+  // bodies are measured once, not once per enclosing size
+  std::vector<size_t> sizes;
+  Counter code;
+  uleb(code, m.functions.size());
+  for (auto &f : m.functions) {
+    Counter body;
+    functionBody(body, f);
+    sizes.push_back(body.n);
+    uleb(code, body.n);
+    code.n += body.n;
+  }
+  out.put(10);
+  uleb(out, code.n);
+  uleb(out, m.functions.size());
+  std::vector<std::pair<uint32_t, uint32_t>> lines; // offset, source line
+  for (size_t f = 0; f < m.functions.size(); f++) {
+    uleb(out, sizes[f]);
+    if (!m.functions[f].lines.empty())
+      lineOffsets(m.functions[f], out.size() - start, lines);
+    functionBody(out, m.functions[f]);
+  }
+
+  if (!m.data.empty()) {
+    section(out, 11, [&](auto &s) {
+      uleb(s, m.data.size());
+      for (auto &d : m.data) {
+        s.put(0); // active, memory 0
+        Instr offset{Op::I32_CONST};
+        offset.i = d.offset;
+        instr(s, offset);
+        s.put(0x0b);
+        name(s, d.bytes);
+      }
+    });
+  }
+
+  if (!lines.empty()) {
+    section(out, 0, [&](auto &s) {
+      name(s, "lines");
+      uleb(s, lines.size());
+      uint32_t offset = 0, line = 0;
+      for (auto [o, l] : lines) {
+        uleb(s, o - offset);
+        sleb(s, (int64_t)l - line);
+        offset = o;
+        line = l;
+      }
+    });
+  }
+}
+
+} // namespace Wasm
@@ -0,0 +1,254 @@
+#ifndef WASM_H_
+#define WASM_H_
+
+#include "sink.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace Wasm {
+
+enum class ValType : uint8_t {
+  I32 = 0x7f,
+  I64 = 0x7e,
+  F32 = 0x7d,
+  F64 = 0x7c,
+  V128 = 0x7b
+};
+const char *valTypeName(ValType t);
+
+// block type of a block, loop or if without results
+const uint32_t VOID_BLOCK = 0x40;
+
+// Immediate operand kinds. LABEL, FUNC, LOCAL and GLOBAL are indices,
+// MEM is an alignment (log2) in a and an offset in b, ZERO and ZERO2 are
+// the reserved memory index bytes of the memory instructions, LANE is the
+// lane byte of a SIMD lane access in a.
+enum class Imm : uint8_t {
+  NONE,
+  BLOCK,
+  LABEL,
+  FUNC,
+  LOCAL,
+  GLOBAL,
+  I32,
+  I64,
+  F64,
+  MEM,
+  ZERO,
+  ZERO2,
+  LANE
+};
+
+// name, text, opcode, immediate, natural alignment of memory accesses.
+// Opcodes above 0xff are a prefix byte shifted left by 16 and a sub-opcode.
+#define WASM_OPS(F)                                                            \
+  F(UNREACHABLE, "unreachable", 0x00, NONE, 0)                                 \
+  F(NOP, "nop", 0x01, NONE, 0)                                                 \
+  F(BLOCK, "block", 0x02, BLOCK, 0)                                            \
+  F(LOOP, "loop", 0x03, BLOCK, 0)                                              \
+  F(IF, "if", 0x04, BLOCK, 0)                                                  \
+  F(ELSE, "else", 0x05, NONE, 0)                                               \
+  F(END, "end", 0x0b, NONE, 0)                                                 \
+  F(BR, "br", 0x0c, LABEL, 0)                                                  \
+  F(BR_IF, "br_if", 0x0d, LABEL, 0)                                            \
+  F(RETURN, "return", 0x0f, NONE, 0)                                           \
+  F(CALL, "call", 0x10, FUNC, 0)                                               \
+  F(DROP, "drop", 0x1a, NONE, 0)                                               \
+  F(SELECT, "select", 0x1b, NONE, 0)                                           \
+  F(LOCAL_GET, "local.get", 0x20, LOCAL, 0)                                    \
+  F(LOCAL_SET, "local.set", 0x21, LOCAL, 0)                                    \
+  F(LOCAL_TEE, "local.tee", 0x22, LOCAL, 0)                                    \
+  F(GLOBAL_GET, "global.get", 0x23, GLOBAL, 0)                                 \
+  F(GLOBAL_SET, "global.set", 0x24, GLOBAL, 0)                                 \
+  F(I32_LOAD, "i32.load", 0x28, MEM, 2)                                        \
+  F(F64_LOAD, "f64.load", 0x2b, MEM, 3)                                        \
+  F(I32_LOAD8_U, "i32.load8_u", 0x2d, MEM, 0)                                  \
+  F(I32_STORE, "i32.store", 0x36, MEM, 2)                                      \
+  F(F64_STORE, "f64.store", 0x39, MEM, 3)                                      \
+  F(I32_STORE8, "i32.store8", 0x3a, MEM, 0)                                    \
+  F(MEMORY_SIZE, "memory.size", 0x3f, ZERO, 0)                                 \
+  F(MEMORY_GROW, "memory.grow", 0x40, ZERO, 0)                                 \
+  F(I32_CONST, "i32.const", 0x41, I32, 0)                                      \
+  F(I64_CONST, "i64.const", 0x42, I64, 0)                                      \
+  F(F64_CONST, "f64.const", 0x44, F64, 0)                                      \
+  F(I32_EQZ, "i32.eqz", 0x45, NONE, 0)                                         \
+  F(I32_EQ, "i32.eq", 0x46, NONE, 0)                                           \
+  F(I32_NE, "i32.ne", 0x47, NONE, 0)                                           \
+  F(I32_LT_S, "i32.lt_s", 0x48, NONE, 0)                                       \
+  F(I32_LT_U, "i32.lt_u", 0x49, NONE, 0)                                       \
+  F(I32_GT_S, "i32.gt_s", 0x4a, NONE, 0)                                       \
+  F(I32_GT_U, "i32.gt_u", 0x4b, NONE, 0)                                       \
+  F(I32_LE_S, "i32.le_s", 0x4c, NONE, 0)                                       \
+  F(I32_LE_U, "i32.le_u", 0x4d, NONE, 0)                                       \
+  F(I32_GE_S, "i32.ge_s", 0x4e, NONE, 0)                                       \
+  F(I32_GE_U, "i32.ge_u", 0x4f, NONE, 0)                                       \
+  F(F64_EQ, "f64.eq", 0x61, NONE, 0)                                           \
+  F(F64_NE, "f64.ne", 0x62, NONE, 0)                                           \
+  F(F64_LT, "f64.lt", 0x63, NONE, 0)                                           \
+  F(F64_GT, "f64.gt", 0x64, NONE, 0)                                           \
+  F(F64_LE, "f64.le", 0x65, NONE, 0)                                           \
+  F(F64_GE, "f64.ge", 0x66, NONE, 0)                                           \
+  F(I32_CLZ, "i32.clz", 0x67, NONE, 0)                                         \
+  F(I32_CTZ, "i32.ctz", 0x68, NONE, 0)                                         \
+  F(I32_ADD, "i32.add", 0x6a, NONE, 0)                                         \
+  F(I32_SUB, "i32.sub", 0x6b, NONE, 0)                                         \
+  F(I32_MUL, "i32.mul", 0x6c, NONE, 0)                                         \
+  F(I32_DIV_S, "i32.div_s", 0x6d, NONE, 0)                                     \
+  F(I32_DIV_U, "i32.div_u", 0x6e, NONE, 0)                                     \
+  F(I32_REM_S, "i32.rem_s", 0x6f, NONE, 0)                                     \
+  F(I32_REM_U, "i32.rem_u", 0x70, NONE, 0)                                     \
+  F(I32_AND, "i32.and", 0x71, NONE, 0)                                         \
+  F(I32_OR, "i32.or", 0x72, NONE, 0)                                           \
+  F(I32_XOR, "i32.xor", 0x73, NONE, 0)                                         \
+  F(I32_SHL, "i32.shl", 0x74, NONE, 0)                                         \
+  F(I32_SHR_S, "i32.shr_s", 0x75, NONE, 0)                                     \
+  F(I32_SHR_U, "i32.shr_u", 0x76, NONE, 0)                                     \
+  F(F64_ABS, "f64.abs", 0x99, NONE, 0)                                         \
+  F(F64_NEG, "f64.neg", 0x9a, NONE, 0)                                         \
+  F(F64_SQRT, "f64.sqrt", 0x9f, NONE, 0)                                       \
+  F(F64_ADD, "f64.add", 0xa0, NONE, 0)                                         \
+  F(F64_SUB, "f64.sub", 0xa1, NONE, 0)                                         \
+  F(F64_MUL, "f64.mul", 0xa2, NONE, 0)                                         \
+  F(F64_DIV, "f64.div", 0xa3, NONE, 0)                                         \
+  F(I32_TRUNC_F64_S, "i32.trunc_f64_s", 0xaa, NONE, 0)                         \
+  F(F64_CONVERT_I32_S, "f64.convert_i32_s", 0xb7, NONE, 0)                     \
+  F(MEMORY_COPY, "memory.copy", 0xfc000a, ZERO2, 0)                            \
+  F(MEMORY_FILL, "memory.fill", 0xfc000b, ZERO, 0)                           \
+  F(V128_LOAD, "v128.load", 0xfd0000, MEM, 4)                                  \
+  F(V128_STORE, "v128.store", 0xfd000b, MEM, 4)                                \
+  F(I32X4_SPLAT, "i32x4.splat", 0xfd0011, NONE, 0)                             \
+  F(F64X2_SPLAT, "f64x2.splat", 0xfd0014, NONE, 0)                             \
+  F(I32X4_EXTRACT_LANE, "i32x4.extract_lane", 0xfd001b, LANE, 0)               \
+  F(I32X4_NEG, "i32x4.neg", 0xfd00a1, NONE, 0)                                 \
+  F(I32X4_ADD, "i32x4.add", 0xfd00ae, NONE, 0)                                 \
+  F(I32X4_SUB, "i32x4.sub", 0xfd00b1, NONE, 0)                                 \
+  F(I32X4_MUL, "i32x4.mul", 0xfd00b5, NONE, 0)                                 \
+  F(F64X2_NEG, "f64x2.neg", 0xfd00ed, NONE, 0)                                 \
+  F(F64X2_ADD, "f64x2.add", 0xfd00f0, NONE, 0)                                 \
+  F(F64X2_SUB, "f64x2.sub", 0xfd00f1, NONE, 0)                                 \
+  F(F64X2_MUL, "f64x2.mul", 0xfd00f2, NONE, 0)                                 \
+  F(F64X2_DIV, "f64x2.div", 0xfd00f3, NONE, 0)
+
+#define F(name, text, code, imm, align) name,
+enum class Op : uint16_t { WASM_OPS(F) };
+#undef F
+
+const char *opName(Op o);
+Imm immediate(Op o);
+
+struct Instr {
+  Op op;
+  uint32_t a = 0; // index, label depth, block type or alignment
+  uint32_t b = 0; // memory offset
+  union {
+    int64_t i = 0; // integer constant
+    double f;      // f64 constant
+  };
+};
+
+// a load or store with natural alignment
+Instr memory(Op op, uint32_t offset = 0);
+
+struct FuncType {
+  std::vector<ValType> params;
+  std::vector<ValType> results;
+  bool operator==(const FuncType &o) const {
+    return params == o.params && results == o.results;
+  }
+};
+
+struct Limits {
+  uint32_t min = 0;
+  uint32_t max = 0;
+  bool hasMax = false;
+};
+
+// kinds of imports and exports, valued as in the binary format
+enum class Extern : uint8_t { FUNC = 0, MEMORY = 2, GLOBAL = 3 };
+
+struct Import {
+  std::string module;
+  std::string field;
+  Extern kind = Extern::FUNC;
+  std::string name; // of a function in the text format, without '$'
+  uint32_t type = 0;
+  Limits limits; // of a memory
+};
+
+struct Function {
+  std::string name;       // without '$', may be empty
+  std::string exportName; // empty if not exported
+  uint32_t type = 0;
+  std::vector<ValType> locals;         // declared after the parameters
+  std::vector<std::string> localNames; // parameters first, may be short
+  std::vector<Instr> body;             // without the final end
+  // source line by the index of the first instruction of its code, in
+  // body order; the lines custom section of the binary format
+  std::vector<std::pair<uint32_t, uint32_t>> lines;
+};
+
+struct Global {
+  std::string name;
+  ValType type = ValType::I32;
+  bool mut = false;
+  Instr init{Op::I32_CONST};
+};
+
+// an active data segment in memory 0
+struct Data {
+  uint32_t offset;
+  std::string bytes;
+};
+
+const uint32_t NOT_FOUND = ~0u;
+
+// A module in memory. Functions are indexed with the imported ones first,
+// as in the binary format.
+class Module {
+public:
+  std::vector<FuncType> types;
+  std::vector<Import> imports;
+  std::vector<Function> functions;
+  std::vector<Global> globals;
+  std::vector<Data> data;
+  bool hasMemory = false; // defined in the module rather than imported
+  Limits memory;
+  std::string memoryExport;
+
+  // index of t in types, added if new
+  uint32_t type(const FuncType &t);
+  uint32_t importedFunctions() const;
+  uint32_t functionCount() const {
+    return importedFunctions() + functions.size();
+  }
+  // index of a named function or global, NOT_FOUND if there is none
+  uint32_t function(std::string_view name) const;
+  uint32_t global(std::string_view name) const;
+  const FuncType &signature(uint32_t function) const;
+  std::string_view functionName(uint32_t function) const;
+  // removes the functions, imported or not, that no exported function
+  // reaches through calls and the globals the rest do not use, and
+  // renumbers the references to those kept
+  void dropUnused();
+};
+
+// Appends the binary format of m to out. If functions have lines, a custom
+// section named "lines" follows, mapping code to source lines: the number
+// of entries, then for each one in the order of the code its offset in the
+// module, an unsigned LEB128, and its line, a signed LEB128, both as the
+// difference to the entry before, which starts out at offset and line 0.
+// Engines skip custom sections, so the code runs the same.
+void encode(const Module &m, Sink::Buffer &out);
+// appends the text format of m to out
+void print(const Module &m, Sink::Buffer &out);
+// Adds the fields of a module in the text format to m. Only the flat
+// instruction syntax and the fields the runtime library uses are supported.
+// Returns false and describes the problem in error if text is malformed.
+bool parse(std::string_view text, Module &m, std::string &error);
+
+} // namespace Wasm
+
+#endif // WASM_H_
@@ -16,18 +16,27 @@ function showDetails(mem) {
         u8[2] + "," + u8[3] + "]";
 };
 
-var mp = 0;
-function malloc(size) {
-  p = mp + 1;
-  mp = mp + size() + 1;
-  return p;
-}
-
-var memory = new WebAssembly.Memory({initial:10});
-function consoleLogString(offset, length) {
+// one page to start with, which the allocator of the module grows
+var memory = new WebAssembly.Memory({initial:1});
+function readString(offset, length) {
   var bytes = new Uint8Array(memory.buffer, offset, length);
-  var string = new TextDecoder('utf8').decode(bytes);
-  console.log(string);
+  return new TextDecoder('utf8').decode(bytes);
+};
+
+// writeln arguments are collected until the line is complete
+var line = "";
+function writeString(offset, length) {
+  line += readString(offset, length);
+};
+function writeln() {
+  console.log(line);
+  line = "";
+};
+// stores at most capacity bytes of input, returning how many
+function readInput(offset, capacity) {
+  var bytes = new TextEncoder().encode(prompt() || "").subarray(0, capacity);
+  new Uint8Array(memory.buffer, offset, capacity).set(bytes);
+  return bytes.length;
 };
 
 
@@ -36,8 +45,16 @@ function toString(x) {
 };
 
 var importObject = {
-    console: {
-      log: consoleLogString
+    io: {
+      write_int: (x) => { line += x; },
+      write_real: (x) => { line += x; },
+      write_bool: (x) => { line += x ? "true" : "false"; },
+      write_string: writeString,
+      writeln: writeln,
+      read_int: () => parseInt(prompt()) | 0,
+      read_real: () => parseFloat(prompt()),
+      read_string: readInput,
+      assert_failed: () => { throw new Error("Assertion failed"); }
     },
     js: {
         memory: memory
@@ -55,8 +72,8 @@ var importObject = {
         lte: (a,b) => a<=b,
         gte: (a,b) => a>=b,
         not: (a) => !a,
-        or: (a) => a || b,
-        and: (a) => a && b
+        or: (a,b) => a || b,
+        and: (a,b) => a && b
     }
 };
 
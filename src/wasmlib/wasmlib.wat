@@ -1,7 +1,15 @@
 ;;(module
 ;;(import "console" "log" (func $log (param i32)))
 ;; (import "String" "fromCharCode" (func $toChar (param i32)))
-(import "console" "log" (func $log (param i32 i32)))
+(import "io" "write_int" (func $write_int (param i32)))
+(import "io" "write_real" (func $write_real (param f64)))
+(import "io" "write_bool" (func $write_bool (param i32)))
+(import "io" "write_string" (func $write_bytes (param i32 i32)))
+(import "io" "writeln" (func $writeln))
+(import "io" "read_int" (func $read_int (result i32)))
+(import "io" "read_real" (func $read_real (result f64)))
+(import "io" "read_string" (func $read_bytes (param i32 i32) (result i32)))
+(import "io" "assert_failed" (func $assert_failed))
 (import "math" "add" (func $add (param i32 i32) (result i32)))
 (import "math" "sub" (func $sub (param i32 i32) (result i32)))
 (import "math" "mul" (func $mul (param i32 i32) (result i32)))
@@ -13,26 +21,481 @@
 (import "math" "gt" (func $gt (param i32 i32) (result i32)))
 (import "math" "lte" (func $lte (param i32 i32) (result i32)))
 (import "math" "gte" (func $gte (param i32 i32) (result i32)))
-(import "math" "not" (func $not (param i32 i32) (result i32)))
+(import "math" "not" (func $not (param i32) (result i32)))
 (import "math" "or" (func $or (param i32 i32) (result i32)))
 (import "math" "and" (func $and (param i32 i32) (result i32)))
 
-;; 10 64kB pages of memory
+;; memory grows from one 64kB page as the allocator needs it
 ;;(memory (export "memory") 1 10)
-(import "js" "memory" (memory 10))
-
-(func $writeln_string (param $offset i32)
-  ;; (param $size i32)
-  local.get $offset
-  ;; local.get $size
-  i32.const 20
-  call $log)
+(import "js" "memory" (memory 1))
+;; A string is the address of an i32 length followed by its bytes. Strings
+;; are never changed once built, so assigning one copies only the address.
+;; Nothing is stored at address 0, whose zero length makes 0 the empty
+;; string.
+
+;; An array is the address of an i32 size and 4 bytes of padding, followed
+;; by its elements: 4 bytes each, addresses for strings, or 8 for reals.
+
+;; Strings and arrays built at runtime live in blocks of the heap, which
+;; starts after the literals the compiler lays out above the first 48
+;; bytes. A block is its size in bytes and a link, followed by the 8-aligned
+;; address $alloc returns. Free blocks of 16 << c bytes, c up to 7, are
+;; kept on one list per class, with the head at 8 + 4c; larger free blocks
+;; are kept on one list in address order, with the head at 40, and merged
+;; with the free blocks next to them. A block freed at the top of the heap
+;; lowers the top instead.
+(global $heap (mut i32) (i32.const 48))
+
+;; the address of size bytes aligned to 8, from the list of its class, the
+;; first large free block big enough, whose end is split off if the rest
+;; stays large, or the top of the heap
+(func $alloc (param $size i32) (result i32)
+  (local $n i32) (local $class i32) (local $link i32) (local $b i32)
+  (local $rest i32)
+  local.get $size
+  i32.const 15
+  i32.add
+  i32.const -8
+  i32.and
+  local.tee $n
+  i32.const 2048
+  i32.le_u
+  if
+    i32.const 28
+    local.get $n
+    i32.const 1
+    i32.sub
+    i32.const 15
+    i32.or
+    i32.clz
+    i32.sub
+    local.tee $class
+    i32.const 2
+    i32.shl
+    local.tee $link
+    i32.load offset=8
+    local.tee $b
+    if
+      local.get $link
+      local.get $b
+      i32.load offset=4
+      i32.store offset=8
+      local.get $b
+      i32.const 8
+      i32.add
+      return
+    end
+    i32.const 16
+    local.get $class
+    i32.shl
+    local.set $n
+  else
+    i32.const 40
+    local.set $link
+    block $none
+      loop $next
+        local.get $link
+        i32.load
+        local.tee $b
+        i32.eqz
+        br_if $none
+        local.get $b
+        i32.load
+        local.get $n
+        i32.ge_u
+        if
+          local.get $b
+          i32.load
+          local.get $n
+          i32.sub
+          local.tee $rest
+          i32.const 2048
+          i32.gt_u
+          if
+            local.get $b
+            local.get $rest
+            i32.store
+            local.get $b
+            local.get $rest
+            i32.add
+            local.tee $b
+            local.get $n
+            i32.store
+          else
+            local.get $link
+            local.get $b
+            i32.load offset=4
+            i32.store
+          end
+          local.get $b
+          i32.const 8
+          i32.add
+          return
+        end
+        local.get $b
+        i32.const 4
+        i32.add
+        local.set $link
+        br $next
+      end
+    end
+  end
+  local.get $n
+  call $grow
+  local.tee $b
+  local.get $n
+  i32.store
+  local.get $b
+  i32.const 8
+  i32.add)
+
+;; gives block p of $alloc back, to the list of its class if it is small
+(func $free (param $p i32)
+  (local $b i32) (local $n i32) (local $link i32) (local $next i32)
+  (local $prev i32) (local $last i32)
+  local.get $p
+  i32.const 8
+  i32.sub
+  local.tee $b
+  i32.load
+  local.tee $n
+  i32.const 2048
+  i32.le_u
+  if
+    local.get $b
+    local.get $n
+    i32.ctz
+    i32.const 2
+    i32.shl
+    i32.const 8
+    i32.sub
+    local.tee $link
+    i32.load
+    i32.store offset=4
+    local.get $link
+    local.get $b
+    i32.store
+    return
+  end
+  ;; the link to the first large free block after b, and the link to the
+  ;; one before that
+  i32.const 40
+  local.set $link
+  block $found
+    loop $next
+      local.get $link
+      i32.load
+      local.tee $next
+      i32.eqz
+      br_if $found
+      local.get $next
+      local.get $b
+      i32.gt_u
+      br_if $found
+      local.get $link
+      local.set $prev
+      local.get $next
+      i32.const 4
+      i32.add
+      local.set $link
+      br $next
+    end
+  end
+  ;; merged with the free blocks right after and right before it
+  local.get $b
+  local.get $n
+  i32.add
+  local.get $next
+  i32.eq
+  if
+    local.get $next
+    i32.load
+    local.get $n
+    i32.add
+    local.set $n
+    local.get $next
+    i32.load offset=4
+    local.set $next
+  end
+  local.get $link
+  i32.const 40
+  i32.ne
+  if
+    local.get $link
+    i32.const 4
+    i32.sub
+    local.tee $last
+    local.get $last
+    i32.load
+    i32.add
+    local.get $b
+    i32.eq
+    if
+      local.get $last
+      i32.load
+      local.get $n
+      i32.add
+      local.set $n
+      local.get $last
+      local.set $b
+      local.get $prev
+      local.set $link
+    end
+  end
+  local.get $b
+  local.get $n
+  i32.add
+  global.get $heap
+  i32.eq
+  if
+    local.get $b
+    global.set $heap
+    local.get $link
+    i32.const 0
+    i32.store
+    return
+  end
+  local.get $b
+  local.get $n
+  i32.store
+  local.get $b
+  local.get $next
+  i32.store offset=4
+  local.get $link
+  local.get $b
+  i32.store)
+
+;; n bytes from the top of the heap, growing memory when the heap reaches
+;; its end by the pages missing and as many again as there are, since
+;; growing may copy
+(func $grow (param $n i32) (result i32) (local $p i32) (local $end i32)
+  global.get $heap
+  local.tee $p
+  local.get $n
+  i32.add
+  local.tee $end
+  memory.size
+  i32.const 16
+  i32.shl
+  i32.gt_u
+  if
+    local.get $end
+    memory.size
+    i32.const 16
+    i32.shl
+    i32.sub
+    i32.const 65535
+    i32.add
+    i32.const 16
+    i32.shr_u
+    memory.size
+    i32.add
+    memory.grow
+    i32.const -1
+    i32.eq
+    if
+      unreachable
+    end
+  end
+  local.get $end
+  global.set $heap
+  local.get $p)
+
+(func $write_string (param $s i32)
+  local.get $s
+  i32.const 4
+  i32.add
+  local.get $s
+  i32.load
+  call $write_bytes)
+
+;; a string of up to 4096 bytes read by the host into a buffer, then
+;; copied to a block that fits
+(func $read_string (result i32) (local $p i32) (local $n i32) (local $s i32)
+  i32.const 4100
+  call $alloc
+  local.tee $p
+  i32.const 4
+  i32.add
+  i32.const 4096
+  call $read_bytes
+  local.tee $n
+  i32.const 4
+  i32.add
+  call $alloc
+  local.tee $s
+  local.get $n
+  i32.store
+  local.get $s
+  i32.const 4
+  i32.add
+  local.get $p
+  i32.const 4
+  i32.add
+  local.get $n
+  memory.copy
+  local.get $p
+  call $free
+  local.get $s)
+
+;; a joined with b, or either one if the other is empty
+(func $string_concat (param $a i32) (param $b i32) (result i32)
+  (local $la i32) (local $lb i32) (local $p i32)
+  local.get $b
+  i32.load
+  local.tee $lb
+  i32.eqz
+  if
+    local.get $a
+    return
+  end
+  local.get $a
+  i32.load
+  local.tee $la
+  i32.eqz
+  if
+    local.get $b
+    return
+  end
+  local.get $la
+  local.get $lb
+  i32.add
+  i32.const 4
+  i32.add
+  call $alloc
+  local.tee $p
+  local.get $la
+  local.get $lb
+  i32.add
+  i32.store
+  local.get $p
+  i32.const 4
+  i32.add
+  local.get $a
+  i32.const 4
+  i32.add
+  local.get $la
+  memory.copy
+  local.get $p
+  i32.const 4
+  i32.add
+  local.get $la
+  i32.add
+  local.get $b
+  i32.const 4
+  i32.add
+  local.get $lb
+  memory.copy
+  local.get $p)
+
+;; -1, 0 or 1 as a orders before, with or after b, comparing bytes unsigned
+;; and a prefix before the longer string
+(func $string_compare (param $a i32) (param $b i32) (result i32)
+  (local $la i32) (local $lb i32) (local $i i32) (local $x i32) (local $y i32)
+  local.get $a
+  i32.load
+  local.set $la
+  local.get $b
+  i32.load
+  local.set $lb
+  block $done
+    loop $next
+      local.get $i
+      local.get $la
+      i32.ge_u
+      br_if $done
+      local.get $i
+      local.get $lb
+      i32.ge_u
+      br_if $done
+      local.get $a
+      local.get $i
+      i32.add
+      i32.load8_u offset=4
+      local.tee $x
+      local.get $b
+      local.get $i
+      i32.add
+      i32.load8_u offset=4
+      local.tee $y
+      i32.ne
+      if
+        local.get $x
+        local.get $y
+        i32.gt_u
+        local.get $x
+        local.get $y
+        i32.lt_u
+        i32.sub
+        return
+      end
+      local.get $i
+      i32.const 1
+      i32.add
+      local.set $i
+      br $next
+    end
+  end
+  local.get $la
+  local.get $lb
+  i32.gt_u
+  local.get $la
+  local.get $lb
+  i32.lt_u
+  i32.sub)
+
+;; 1 if a and b hold the same bytes, checking the lengths first
+(func $string_equal (param $a i32) (param $b i32) (result i32)
+  (local $n i32) (local $i i32)
+  local.get $a
+  local.get $b
+  i32.eq
+  if
+    i32.const 1
+    return
+  end
+  local.get $a
+  i32.load
+  local.tee $n
+  local.get $b
+  i32.load
+  i32.ne
+  if
+    i32.const 0
+    return
+  end
+  block $done
+    loop $next
+      local.get $i
+      local.get $n
+      i32.ge_u
+      br_if $done
+      local.get $a
+      local.get $i
+      i32.add
+      i32.load8_u offset=4
+      local.get $b
+      local.get $i
+      i32.add
+      i32.load8_u offset=4
+      i32.ne
+      if
+        i32.const 0
+        return
+      end
+      local.get $i
+      i32.const 1
+      i32.add
+      local.set $i
+      br $next
+    end
+  end
+  i32.const 1)
+
 ;; (func (export "toChar")
     ;; i32.const 13
     ;; call $toChar)
 
-(data (i32.const 10) "TEST")
-
 ;; https://developer.mozilla.org/en-US/docs/WebAssembly/Understanding_the_text_format
 ;;(table 2 funcref)
 ;;  (func $f1 (result i32)
@@ -45,3 +508,48 @@
 ;;    local.get $i
 ;;    call_indirect (type $return_i32))
 ;;)
+
+;; a zeroed array of size elements of 1 << shift bytes, trapping on a
+;; negative size or one too big to address
+(func $array_new (param $size i32) (param $shift i32) (result i32)
+  (local $bytes i32) (local $p i32)
+  local.get $size
+  i32.const 0x10000000
+  i32.ge_u
+  if
+    unreachable
+  end
+  local.get $size
+  local.get $shift
+  i32.shl
+  local.tee $bytes
+  i32.const 8
+  i32.add
+  call $alloc
+  local.tee $p
+  local.get $size
+  i32.store
+  local.get $p
+  i32.const 8
+  i32.add
+  i32.const 0
+  local.get $bytes
+  memory.fill
+  local.get $p)
+
+;; a copy of array a with elements of 1 << shift bytes, arrays being values
+(func $array_copy (param $a i32) (param $shift i32) (result i32)
+  (local $bytes i32) (local $p i32)
+  local.get $a
+  i32.load
+  local.get $shift
+  i32.shl
+  i32.const 8
+  i32.add
+  local.tee $bytes
+  call $alloc
+  local.tee $p
+  local.get $a
+  local.get $bytes
+  memory.copy
+  local.get $p)
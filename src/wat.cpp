@@ -0,0 +1,726 @@
+#include "wasm.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_map>
+
+// The text format: a printer for --emit=wat, and a parser that reads the
+// runtime library so it can be written in wat and linked into every module.
+
+namespace Wasm {
+
+// text format
+
+static void quoted(Sink::Buffer &out, std::string_view s) {
+  static const char hex[] = "0123456789abcdef";
+  out += '"';
+  for (unsigned char c : s) {
+    if (c >= 0x20 && c < 0x7f && c != '"' && c != '\\') {
+      out += c;
+    } else {
+      out += '\\';
+      out += hex[c >> 4];
+      out += hex[c & 15];
+    }
+  }
+  out += '"';
+}
+
+static void index(Sink::Buffer &out, std::string_view name, uint32_t i) {
+  out += ' ';
+  if (name.empty()) {
+    out += std::to_string(i);
+  } else {
+    out += '$';
+    out += name;
+  }
+}
+
+static void f64(Sink::Buffer &out, double v) {
+  char buf[32];
+  if (std::isnan(v))
+    snprintf(buf, sizeof(buf), "nan");
+  else if (std::isinf(v))
+    snprintf(buf, sizeof(buf), v < 0 ? "-inf" : "inf");
+  else
+    snprintf(buf, sizeof(buf), "%.17g", v);
+  out += buf;
+}
+
+static void instr(Sink::Buffer &out, const Module &m, const Function &f,
+                  const Instr &i) {
+  out += opName(i.op);
+  switch (immediate(i.op)) {
+  case Imm::BLOCK:
+    if (i.a != VOID_BLOCK) {
+      out += " (result ";
+      out += valTypeName(ValType(i.a));
+      out += ')';
+    }
+    break;
+  case Imm::LABEL:
+  case Imm::LANE:
+    out += ' ';
+    out += std::to_string(i.a);
+    break;
+  case Imm::FUNC:
+    index(out, m.functionName(i.a), i.a);
+    break;
+  case Imm::LOCAL:
+    index(out, i.a < f.localNames.size() ? f.localNames[i.a] : "", i.a);
+    break;
+  case Imm::GLOBAL:
+    index(out, i.a < m.globals.size() ? m.globals[i.a].name : "", i.a);
+    break;
+  case Imm::I32:
+    out += ' ';
+    out += std::to_string((int32_t)i.i);
+    break;
+  case Imm::I64:
+    out += ' ';
+    out += std::to_string(i.i);
+    break;
+  case Imm::F64:
+    out += ' ';
+    f64(out, i.f);
+    break;
+  case Imm::MEM:
+    if (i.b) {
+      out += " offset=";
+      out += std::to_string(i.b);
+    }
+    if (i.a != memory(i.op).a) {
+      out += " align=";
+      out += std::to_string(1u << i.a);
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+static void valTypes(Sink::Buffer &out, const char *field,
+                     const std::vector<ValType> &types) {
+  if (types.empty())
+    return;
+  out += " (";
+  out += field;
+  for (ValType t : types) {
+    out += ' ';
+    out += valTypeName(t);
+  }
+  out += ')';
+}
+
+static void limits(Sink::Buffer &out, const Limits &l) {
+  out += ' ';
+  out += std::to_string(l.min);
+  if (l.hasMax) {
+    out += ' ';
+    out += std::to_string(l.max);
+  }
+}
+
+static void function(Sink::Buffer &out, const Module &m, const Function &f) {
+  const FuncType &t = m.types[f.type];
+  out += "  (func";
+  if (!f.name.empty())
+    out += " $" + f.name;
+  if (!f.exportName.empty()) {
+    out += " (export ";
+    quoted(out, f.exportName);
+    out += ')';
+  }
+  size_t local = 0;
+  auto declare = [&](const char *field, ValType type) {
+    out += " (";
+    out += field;
+    if (local < f.localNames.size() && !f.localNames[local].empty())
+      out += " $" + f.localNames[local];
+    out += ' ';
+    out += valTypeName(type);
+    out += ')';
+    local++;
+  };
+  for (ValType p : t.params)
+    declare("param", p);
+  valTypes(out, "result", t.results);
+  for (ValType l : f.locals)
+    declare("local", l);
+  out += '\n';
+  std::string indent = "    ";
+  size_t line = 0; // next of f.lines
+  for (size_t k = 0; k < f.body.size(); k++) {
+    const Instr &i = f.body[k];
+    if (i.op == Op::END || i.op == Op::ELSE)
+      indent.resize(indent.size() - 2);
+    // source lines as comments, which the binary format has a section for
+    for (; line < f.lines.size() && f.lines[line].first == k; line++)
+      out += indent + ";; line " + std::to_string(f.lines[line].second) + '\n';
+    out += indent;
+    instr(out, m, f, i);
+    out += '\n';
+    if (immediate(i.op) == Imm::BLOCK || i.op == Op::ELSE)
+      indent += "  ";
+  }
+  out += "  )\n";
+}
+
+void print(const Module &m, Sink::Buffer &out) {
+  out += "(module\n";
+  for (auto &i : m.imports) {
+    out += "  (import ";
+    quoted(out, i.module);
+    out += ' ';
+    quoted(out, i.field);
+    if (i.kind == Extern::FUNC) {
+      out += " (func";
+      if (!i.name.empty())
+        out += " $" + i.name;
+      valTypes(out, "param", m.types[i.type].params);
+      valTypes(out, "result", m.types[i.type].results);
+    } else {
+      out += " (memory";
+      limits(out, i.limits);
+    }
+    out += "))\n";
+  }
+  if (m.hasMemory) {
+    out += "  (memory";
+    if (!m.memoryExport.empty()) {
+      out += " (export ";
+      quoted(out, m.memoryExport);
+      out += ')';
+    }
+    limits(out, m.memory);
+    out += ")\n";
+  }
+  Function none;
+  for (auto &g : m.globals) {
+    out += "  (global";
+    if (!g.name.empty())
+      out += " $" + g.name;
+    out += g.mut ? " (mut " : " ";
+    out += valTypeName(g.type);
+    out += g.mut ? ") (" : " (";
+    instr(out, m, none, g.init);
+    out += "))\n";
+  }
+  for (auto &f : m.functions)
+    function(out, m, f);
+  for (auto &d : m.data) {
+    out += "  (data (i32.const " + std::to_string(d.offset) + ") ";
+    quoted(out, d.bytes);
+    out += ")\n";
+  }
+  out += ")\n";
+}
+
+// parser
+
+namespace {
+
+struct SyntaxError {
+  std::string message;
+};
+
+struct Token {
+  enum Kind { OPEN, CLOSE, ATOM, STRING, END } kind;
+  std::string_view text; // contents without quotes for strings
+};
+
+class TextParser {
+public:
+  std::string_view s;
+  size_t pos = 0;
+  Module &m;
+  Token token;
+
+  // references resolved once every field is known
+  struct Fixup {
+    uint32_t function;
+    uint32_t instr;
+    std::string_view name;
+  };
+  std::vector<Fixup> fixups;
+  std::vector<std::string_view> labels;
+
+  TextParser(std::string_view s, Module &m) : s(s), m(m) { advance(); }
+
+  [[noreturn]] void fail(const std::string &message) {
+    int line = 1;
+    for (size_t i = 0; i < pos && i < s.size(); i++)
+      line += s[i] == '\n';
+    throw SyntaxError{"line " + std::to_string(line) + ": " + message};
+  }
+
+  void skipSpace() {
+    while (pos < s.size()) {
+      char c = s[pos];
+      if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+        pos++;
+      } else if (s.compare(pos, 2, ";;") == 0) {
+        while (pos < s.size() && s[pos] != '\n')
+          pos++;
+      } else if (s.compare(pos, 2, "(;") == 0) {
+        size_t end = s.find(";)", pos + 2);
+        if (end == std::string_view::npos)
+          fail("unterminated comment");
+        pos = end + 2;
+      } else {
+        return;
+      }
+    }
+  }
+
+  void advance() {
+    skipSpace();
+    if (pos >= s.size()) {
+      token = {Token::END, {}};
+      return;
+    }
+    char c = s[pos];
+    if (c == '(' || c == ')') {
+      token = {c == '(' ? Token::OPEN : Token::CLOSE, s.substr(pos, 1)};
+      pos++;
+      return;
+    }
+    if (c == '"') {
+      size_t start = ++pos;
+      while (pos < s.size() && s[pos] != '"')
+        pos += s[pos] == '\\' ? 2 : 1;
+      if (pos >= s.size())
+        fail("unterminated string");
+      token = {Token::STRING, s.substr(start, pos - start)};
+      pos++;
+      return;
+    }
+    size_t start = pos;
+    while (pos < s.size() && s[pos] != ' ' && s[pos] != '\t' &&
+           s[pos] != '\n' && s[pos] != '\r' && s[pos] != '(' &&
+           s[pos] != ')' && s[pos] != ';' && s[pos] != '"')
+      pos++;
+    token = {Token::ATOM, s.substr(start, pos - start)};
+  }
+
+  bool isAtom(std::string_view text) const {
+    return token.kind == Token::ATOM && token.text == text;
+  }
+  bool isId() const {
+    return token.kind == Token::ATOM && !token.text.empty() &&
+           token.text[0] == '$';
+  }
+
+  void expect(Token::Kind kind, const char *what) {
+    if (token.kind != kind)
+      fail(std::string("expected ") + what);
+    advance();
+  }
+  void open() { expect(Token::OPEN, "'('"); }
+  void close() { expect(Token::CLOSE, "')'"); }
+
+  std::string_view atom() {
+    if (token.kind != Token::ATOM)
+      fail("expected a keyword or number");
+    std::string_view a = token.text;
+    advance();
+    return a;
+  }
+
+  // the name of an optional $id, empty if there is none
+  std::string_view id() {
+    if (!isId())
+      return {};
+    std::string_view name = token.text.substr(1);
+    advance();
+    return name;
+  }
+
+  std::string string() {
+    if (token.kind != Token::STRING)
+      fail("expected a string");
+    std::string_view t = token.text;
+    std::string out;
+    for (size_t i = 0; i < t.size(); i++) {
+      if (t[i] != '\\') {
+        out += t[i];
+        continue;
+      }
+      char c = t[++i];
+      if (c == 'n')
+        out += '\n';
+      else if (c == 't')
+        out += '\t';
+      else if (c == 'r')
+        out += '\r';
+      else if (c == '"' || c == '\'' || c == '\\')
+        out += c;
+      else
+        out += (char)std::strtol(std::string(t.substr(i++, 2)).c_str(),
+                                 nullptr, 16);
+    }
+    advance();
+    return out;
+  }
+
+  int64_t integer() {
+    std::string text;
+    for (char c : atom())
+      if (c != '_')
+        text += c;
+    char *end;
+    int64_t v = std::strtoll(text.c_str(), &end, 0);
+    if (text.empty() || *end)
+      fail("expected an integer, not " + text);
+    return v;
+  }
+
+  double real() {
+    std::string text;
+    for (char c : atom())
+      if (c != '_')
+        text += c;
+    char *end;
+    double v = std::strtod(text.c_str(), &end);
+    if (text.empty() || *end)
+      fail("expected a number, not " + text);
+    return v;
+  }
+
+  uint32_t index() { return (uint32_t)integer(); }
+
+  ValType valType() {
+    std::string_view t = atom();
+    if (t == "i32")
+      return ValType::I32;
+    if (t == "i64")
+      return ValType::I64;
+    if (t == "f32")
+      return ValType::F32;
+    if (t == "f64")
+      return ValType::F64;
+    if (t == "v128")
+      return ValType::V128;
+    fail("unknown value type " + std::string(t));
+  }
+
+  // (field $name? type*)* for params and locals, results are never named
+  // names, if given, are indexed from first, where locals follow the
+  // parameters
+  void declarations(const char *field, std::vector<ValType> &types,
+                    std::vector<std::string> *names, size_t first = 0) {
+    while (token.kind == Token::OPEN) {
+      size_t save = pos;
+      Token t = token;
+      advance();
+      if (!isAtom(field)) {
+        pos = save;
+        token = t;
+        return;
+      }
+      advance();
+      std::string_view name = id();
+      if (!name.empty()) {
+        if (names)
+          names->resize(first + types.size());
+        types.push_back(valType());
+        if (names)
+          names->push_back(std::string(name));
+      } else {
+        while (token.kind == Token::ATOM)
+          types.push_back(valType());
+      }
+      close();
+    }
+  }
+
+  // an optional (export "name")
+  std::string exportName() {
+    if (token.kind != Token::OPEN)
+      return {};
+    size_t save = pos;
+    Token t = token;
+    advance();
+    if (!isAtom("export")) {
+      pos = save;
+      token = t;
+      return {};
+    }
+    advance();
+    std::string name = string();
+    close();
+    return name;
+  }
+
+  Limits limits() {
+    Limits l;
+    l.min = index();
+    if (token.kind == Token::ATOM) {
+      l.max = index();
+      l.hasMax = true;
+    }
+    return l;
+  }
+
+  uint32_t label() {
+    if (!isId())
+      return index();
+    std::string_view name = id();
+    for (size_t d = 0; d < labels.size(); d++)
+      if (labels[labels.size() - 1 - d] == name)
+        return d;
+    fail("unknown label $" + std::string(name));
+  }
+
+  Op opcode(std::string_view text) {
+    static const std::unordered_map<std::string_view, Op> ops = [] {
+      std::unordered_map<std::string_view, Op> map;
+      for (int o = 0; o <= (int)Op::MEMORY_FILL; o++)
+        map[opName(Op(o))] = Op(o);
+      return map;
+    }();
+    auto it = ops.find(text);
+    if (it == ops.end())
+      fail("unknown instruction " + std::string(text));
+    return it->second;
+  }
+
+  Instr instr(Function &f) {
+    Instr i{opcode(atom())};
+    switch (immediate(i.op)) {
+    case Imm::NONE:
+      if (i.op == Op::END || i.op == Op::ELSE) {
+        if (labels.empty())
+          fail(std::string(opName(i.op)) + " outside of a block");
+        id();
+        if (i.op == Op::END)
+          labels.pop_back();
+      }
+      break;
+    case Imm::BLOCK: {
+      labels.push_back(id());
+      i.a = VOID_BLOCK;
+      std::vector<ValType> results;
+      declarations("result", results, nullptr);
+      if (results.size() > 1)
+        fail("blocks with several results are not supported");
+      if (!results.empty())
+        i.a = (uint32_t)results[0];
+      break;
+    }
+    case Imm::LABEL:
+      i.a = label();
+      break;
+    case Imm::FUNC:
+    case Imm::GLOBAL:
+      if (isId()) {
+        std::string_view name = token.text.substr(1);
+        i.a = i.op == Op::CALL ? m.function(name) : m.global(name);
+        // functions may be called before they are defined
+        if (i.a == NOT_FOUND && i.op == Op::CALL && !m.functions.empty() &&
+            &f == &m.functions.back())
+          fixups.push_back({(uint32_t)(m.functions.size() - 1),
+                            (uint32_t)f.body.size(), name});
+        else if (i.a == NOT_FOUND)
+          fail("unknown " + std::string(token.text));
+        advance();
+      } else {
+        i.a = index();
+      }
+      break;
+    case Imm::LOCAL:
+      if (isId()) {
+        std::string_view name = id();
+        i.a = NOT_FOUND;
+        for (uint32_t l = 0; l < f.localNames.size(); l++)
+          if (f.localNames[l] == name)
+            i.a = l;
+        if (i.a == NOT_FOUND)
+          fail("unknown local $" + std::string(name));
+      } else {
+        i.a = index();
+      }
+      break;
+    case Imm::I32:
+    case Imm::I64:
+      i.i = integer();
+      break;
+    case Imm::F64:
+      i.f = real();
+      break;
+    case Imm::MEM:
+      i = memory(i.op);
+      while (token.kind == Token::ATOM && (token.text.substr(0, 7) == "offset=" ||
+                                           token.text.substr(0, 6) == "align=")) {
+        std::string_view t = atom();
+        size_t eq = t.find('=');
+        uint32_t v = std::strtoul(std::string(t.substr(eq + 1)).c_str(),
+                                  nullptr, 0);
+        if (t[0] == 'o') {
+          i.b = v;
+        } else {
+          i.a = 0;
+          while ((1u << i.a) < v)
+            i.a++;
+        }
+      }
+      break;
+    case Imm::ZERO:
+    case Imm::ZERO2:
+      break;
+    case Imm::LANE:
+      i.a = index();
+      break;
+    }
+    return i;
+  }
+
+  void func() {
+    m.functions.emplace_back();
+    Function &f = m.functions.back();
+    f.name = std::string(id());
+    f.exportName = exportName();
+    FuncType t;
+    declarations("param", t.params, &f.localNames);
+    declarations("result", t.results, nullptr);
+    f.type = m.type(t);
+    f.localNames.resize(t.params.size());
+    declarations("local", f.locals, &f.localNames, t.params.size());
+    labels.clear();
+    // a function body is a block of its own for branches
+    labels.push_back({});
+    while (token.kind == Token::ATOM)
+      f.body.push_back(instr(f));
+    if (token.kind == Token::OPEN)
+      fail("folded instructions are not supported");
+    if (labels.size() != 1)
+      fail("missing end in $" + f.name);
+    close();
+  }
+
+  void import() {
+    Import i;
+    i.module = string();
+    i.field = string();
+    open();
+    std::string_view kind = atom();
+    if (kind == "func") {
+      i.kind = Extern::FUNC;
+      i.name = std::string(id());
+      FuncType t;
+      declarations("param", t.params, nullptr);
+      declarations("result", t.results, nullptr);
+      i.type = m.type(t);
+    } else if (kind == "memory") {
+      i.kind = Extern::MEMORY;
+      id();
+      i.limits = limits();
+    } else {
+      fail("cannot import a " + std::string(kind));
+    }
+    close();
+    close();
+    m.imports.push_back(i);
+  }
+
+  void global() {
+    Global g;
+    g.name = std::string(id());
+    if (token.kind == Token::OPEN) {
+      open();
+      if (!isAtom("mut"))
+        fail("expected mut");
+      advance();
+      g.mut = true;
+      g.type = valType();
+      close();
+    } else {
+      g.type = valType();
+    }
+    open();
+    Function none;
+    g.init = instr(none);
+    close();
+    close();
+    m.globals.push_back(g);
+  }
+
+  void data() {
+    Data d;
+    open();
+    if (!isAtom("i32.const"))
+      fail("expected an i32.const offset");
+    advance();
+    d.offset = (uint32_t)integer();
+    close();
+    while (token.kind == Token::STRING)
+      d.bytes += string();
+    close();
+    m.data.push_back(d);
+  }
+
+  void field() {
+    open();
+    std::string_view kind = atom();
+    if (kind == "import") {
+      import();
+    } else if (kind == "func") {
+      func();
+    } else if (kind == "global") {
+      global();
+    } else if (kind == "data") {
+      data();
+    } else if (kind == "memory") {
+      id();
+      m.hasMemory = true;
+      m.memoryExport = exportName();
+      m.memory = limits();
+      close();
+    } else {
+      fail("unsupported module field " + std::string(kind));
+    }
+  }
+
+  void module() {
+    if (token.kind == Token::OPEN) {
+      size_t save = pos;
+      Token t = token;
+      advance();
+      if (isAtom("module")) {
+        advance();
+        id();
+        while (token.kind == Token::OPEN)
+          field();
+        close();
+      } else {
+        pos = save;
+        token = t;
+      }
+    }
+    while (token.kind == Token::OPEN)
+      field();
+    if (token.kind != Token::END)
+      fail("expected a module field");
+    for (const Fixup &fix : fixups) {
+      Instr &i = m.functions[fix.function].body[fix.instr];
+      i.a = m.function(fix.name);
+      if (i.a == NOT_FOUND)
+        fail("unknown function $" + std::string(fix.name));
+    }
+  }
+};
+
+} // namespace
+
+bool parse(std::string_view text, Module &m, std::string &error) {
+  try {
+    TextParser p(text, m);
+    p.module();
+    return true;
+  } catch (const SyntaxError &e) {
+    error = e.message;
+    return false;
+  }
+}
+
+} // namespace Wasm
@@ -0,0 +1,51 @@
+// Runs a compiled module under node with the imports of wasmlib.js, reading
+// input from stdin, and prints how long main took and the memory it ended
+// with to stderr.
+// Usage: node test/run.js out.wasm < input
+
+const fs = require('fs');
+
+const input = fs.readFileSync(0, 'utf8').split(/\s+/).filter(w => w);
+let next = 0;
+const memory = new WebAssembly.Memory({initial: 1});
+
+function readString(offset, length) {
+  return Buffer.from(memory.buffer, offset, length).toString();
+}
+
+let line = "";
+const imports = {
+  io: {
+    write_int: x => { line += x; },
+    write_real: x => { line += x; },
+    write_bool: x => { line += x ? "true" : "false"; },
+    write_string: (offset, length) => { line += readString(offset, length); },
+    writeln: () => { console.log(line); line = ""; },
+    read_int: () => parseInt(input[next++]) | 0,
+    read_real: () => parseFloat(input[next++]),
+    read_string: (offset, capacity) => {
+      const bytes = Buffer.from(input[next++] || "").subarray(0, capacity);
+      new Uint8Array(memory.buffer, offset, capacity).set(bytes);
+      return bytes.length;
+    },
+    assert_failed: () => { throw new Error("Assertion failed"); },
+  },
+  js: { memory },
+  math: {
+    add: (a, b) => a + b, sub: (a, b) => a - b, mul: (a, b) => a * b,
+    div: (a, b) => a / b, mod: (a, b) => a % b,
+    eq: (a, b) => a == b, neq: (a, b) => a != b,
+    lt: (a, b) => a < b, gt: (a, b) => a > b,
+    lte: (a, b) => a <= b, gte: (a, b) => a >= b,
+    not: a => !a, and: (a, b) => a && b, or: (a, b) => a || b,
+  },
+};
+
+WebAssembly.instantiate(fs.readFileSync(process.argv[2]), imports)
+  .then(({instance}) => {
+    const start = process.hrtime.bigint();
+    instance.exports.main();
+    const ms = Number(process.hrtime.bigint() - start) / 1e6;
+    const pages = memory.buffer.byteLength / 65536;
+    console.error("main: " + ms.toFixed(1) + " ms, " + pages + " pages");
+  });
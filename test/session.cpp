@@ -0,0 +1,66 @@
+// Compiles programs in-process through Compiler::Session and checks the
+// outcome. Run with ctest; exits non-zero if a check fails.
+#include "compiler.h"
+#include <cstdio>
+#include <string>
+
+static int failed = 0;
+
+static void check(bool ok, const char *what) {
+  if (!ok) {
+    std::printf("FAIL %s\n", what);
+    failed++;
+  }
+}
+
+// a var parameter shares its variable with no other one, whether the call
+// is inlined or not
+static void aliasedVarArguments() {
+  const char *swap = "program p;\n"
+                     "procedure swap(var a : integer, var b : integer);\n"
+                     "begin\n"
+                     "  var t : integer;\n"
+                     "  t := a;\n"
+                     "  a := b;\n"
+                     "  b := t;\n"
+                     "end;\n"
+                     "begin\n"
+                     "  var x, y : integer;\n"
+                     "  swap(x, %s);\n"
+                     "end.\n";
+  for (int level : {0, 2}) {
+    Compiler::Options options;
+    options.optimize = level;
+    Compiler::Session s(options);
+    char source[512];
+    std::snprintf(source, sizeof source, swap, "y");
+    check(s.compile(Source::Buffer(source)), "swap(x, y) compiles");
+    std::snprintf(source, sizeof source, swap, "x");
+    check(!s.compile(Source::Buffer(source)), "swap(x, x) is rejected");
+    check(s.diagnostics().find("x is already passed to a var parameter") !=
+              std::string::npos,
+          "swap(x, x) says why");
+  }
+}
+
+// the scanner reads ahead of the text, which Source::Buffer pads: a slice
+// of a larger string is compiled without the text around it, and a string
+// ending in spaces without reading past its end
+static void unpaddedSlice() {
+  std::string text = "@@ program p; begin writeln(1); end.  \n\t  @@ {*";
+  size_t from = text.find("program"), to = text.rfind("@@");
+  std::string_view slice = std::string_view(text).substr(from, to - from);
+  Compiler::Session s;
+  check(s.compile(Source::Buffer(slice)), "a slice compiles");
+  check(s.diagnostics().empty(), "a slice has no errors");
+  check(s.output().size() > 0, "a slice has a module");
+  std::string alone(slice);
+  alone.shrink_to_fit();
+  check(s.compile(Source::Buffer(alone)), "a string ending in spaces compiles");
+}
+
+int main() {
+  aliasedVarArguments();
+  unpaddedSlice();
+  return failed ? 1 : 0;
+}